@@ -0,0 +1,26 @@
+#pragma once
+#include "opengl_includes.h"
+#include <cstdint>
+
+// Shadow copy of the OpenGL bindings that change most often, so that binding what is already bound never reaches the driver.
+// Only bindings made through these functions are tracked: call invalidate() after anything else may have changed them
+// (e.g. the UI renderer), or after deleting objects whose names may be handed out again
+namespace gl_state {
+
+struct CallCounts {
+    uint32_t issued; // Binds that were passed on to OpenGL
+    uint32_t skipped; // Binds that matched the current state
+};
+
+void useProgram(GLuint program);
+void bindFramebuffer(GLuint framebuffer); // Binds to GL_FRAMEBUFFER, i.e. for both drawing and reading
+void bindTextureUnit(GLuint unit, GLuint texture);
+void bindVertexArray(GLuint vertexArray);
+void bindUniformBuffer(GLuint index, GLuint buffer);
+
+void invalidate();
+
+// Binds made since the last call
+CallCounts takeCallCounts();
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+
+struct FileMappingException : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Read-only memory mapping of an entire file. Pages are only read from disk once they are touched
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& filePath);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    std::span<const std::byte> bytes() const { return { m_data, m_size }; }
+    size_t size() const                      { return m_size; }
+
+private:
+    void unmap();
+
+    const std::byte* m_data { nullptr };
+    size_t m_size           { 0ULL };
+#ifdef _WIN32
+    void* m_fileHandle      { nullptr };
+    void* m_mappingHandle   { nullptr };
+#endif
+};
@@ -10,6 +10,7 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/vec3.hpp>
 DISABLE_WARNINGS_POP()
 
+#include "aligned_allocator.h"
 #include "image.h"
 
 #include <filesystem>
@@ -59,8 +60,46 @@ struct Mesh {
 	void serialize(Archive& ar) { ar(CEREAL_NVP(vertices), CEREAL_NVP(triangles), material); }
 };
 
-[[nodiscard]] std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool normalize = false);
+// Structure-of-arrays counterpart of Mesh. Loops that only need some of the vertex attributes read just those, from
+// cache line aligned arrays, rather than whole 36-byte vertices.
+struct MeshSoA {
+	AlignedVector<glm::vec3> positions;
+	AlignedVector<glm::vec3> normals;
+	AlignedVector<glm::vec2> texCoords;
+	AlignedVector<float> distancesInner;
+	std::vector<glm::uvec3> triangles;
+
+	Material material;
+
+	size_t numVertices() const { return positions.size(); }
+};
+
+// Load an OBJ, PLY or glTF file depending on its extension. OBJ files are read with the parallel parser (see obj_parser.h)
+// unless parallelParse is false or the file needs tinyobjloader.
+[[nodiscard]] std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool normalize = false, bool parallelParse = true);
+// Load an ASCII or binary (little or big endian) PLY file with a vertex and a face element straight from a memory mapping.
+[[nodiscard]] std::vector<Mesh> loadPLY(const std::filesystem::path& file);
+// Load the triangle primitives of a glTF 2.0 file (.gltf with external or embedded buffers, or .glb), one mesh per primitive.
+// Node transforms of the default scene are applied.
+[[nodiscard]] std::vector<Mesh> loadGLTF(const std::filesystem::path& file);
 [[nodiscard]] Mesh mergeMeshes(std::span<const Mesh> meshes);
 void meshFlipX(Mesh& mesh);
 void meshFlipY(Mesh& mesh);
-void meshFlipZ(Mesh& mesh);
\ No newline at end of file
+void meshFlipZ(Mesh& mesh);
+// Conversions between the two layouts. The rvalue overloads move the triangles and material instead of copying them.
+[[nodiscard]] MeshSoA meshToSoA(const Mesh& mesh);
+[[nodiscard]] MeshSoA meshToSoA(Mesh&& mesh);
+[[nodiscard]] Mesh meshFromSoA(const MeshSoA& mesh);
+[[nodiscard]] Mesh meshFromSoA(MeshSoA&& mesh);
+void meshFlipX(MeshSoA& mesh);
+void meshFlipY(MeshSoA& mesh);
+void meshFlipZ(MeshSoA& mesh);
+// Translate and uniformly scale the meshes together so that they fit the unit sphere around their mean vertex position.
+// loadMesh() does the same for the meshes it loads when asked to normalize them.
+void meshCenterAndScaleToUnit(std::span<Mesh> meshes);
+void meshCenterAndScaleToUnit(std::span<MeshSoA> meshes);
+// Merge vertices within epsilon of each other using a spatial hash grid and remove the triangles this collapses. Returns the number of vertices removed.
+// Epsilon is raised to at least 2^-20 of the largest extent of the mesh bounds so that grid cells always fit in an int.
+size_t meshWeldVertices(Mesh& mesh, float epsilon);
+// Replace vertex normals with the area-weighted average of the normals of adjacent triangles.
+void meshComputeSmoothNormals(Mesh& mesh);
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <tinyobjloader/tiny_obj_loader.h>
+DISABLE_WARNINGS_POP()
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+// Geometry and materials of an OBJ file in the layout produced by tinyobj::LoadObj.
+struct ObjData {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+};
+
+// Parses an OBJ file on all available cores. The file is memory-mapped, split into line-aligned
+// chunks whose v/vn/vt/f records are parsed concurrently, and the per-chunk results are merged
+// using prefix sums. Positions, normals, texture coordinates, triangle indices and material IDs
+// match those of tinyobj::LoadObj exactly; colors, smoothing groups and shape names are not filled in.
+//
+// Returns std::nullopt if the file uses anything this parser does not reproduce (polygons with more
+// than four corners, line or point elements, zero indices), in which case tinyobjloader should be used.
+[[nodiscard]] std::optional<ObjData> parseObjParallel(const std::filesystem::path& file, const std::filesystem::path& materialBaseDir);
@@ -10,6 +10,8 @@ DISABLE_WARNINGS_PUSH()
 DISABLE_WARNINGS_POP()
 #include <exception>
 #include <filesystem>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 struct ShaderLoadingException : public std::runtime_error {
@@ -37,6 +39,9 @@ private:
 
 private:
     GLuint m_program;
+    // Binding location of every block looked up so far, or GL_INVALID_INDEX if the program has no such block.
+    // Block bindings are program state, so they only have to be set once
+    mutable std::unordered_map<std::string, GLuint> m_uniformBlockBindings;
 };
 
 class ShaderBuilder {
@@ -46,6 +51,7 @@ public:
     ShaderBuilder(ShaderBuilder&&) = default;
     ~ShaderBuilder();
 
+    // Lines of the form #include "file" in the shader are replaced by that file, relative to the including one
     ShaderBuilder& addStage(GLuint shaderStage, std::filesystem::path shaderFile);
     Shader build();
 
@@ -27,6 +27,7 @@ public:
 	[[nodiscard]] bool shouldClose(); // Whether window should close (close() was called or user clicked the close button).
 
 	void updateInput();
+	void waitForInput(); // Block until an input event arrives, which the next updateInput() then handles
 	void swapBuffers(); // Swap the front/back buffer
 
 
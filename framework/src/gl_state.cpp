@@ -0,0 +1,89 @@
+#include "gl_state.h"
+#include <array>
+#include <cstddef>
+#include <limits>
+
+static constexpr GLuint UNKNOWN = std::numeric_limits<GLuint>::max();
+static constexpr std::size_t NUM_TRACKED_UNITS = 32; // Units beyond this are bound without tracking
+static constexpr std::size_t NUM_TRACKED_UNIFORM_BUFFERS = 16;
+
+namespace {
+struct State {
+    GLuint program { UNKNOWN };
+    GLuint framebuffer { UNKNOWN };
+    GLuint vertexArray { UNKNOWN };
+    std::array<GLuint, NUM_TRACKED_UNITS> textures;
+    std::array<GLuint, NUM_TRACKED_UNIFORM_BUFFERS> uniformBuffers;
+    gl_state::CallCounts counts {};
+
+    State()
+    {
+        textures.fill(UNKNOWN);
+        uniformBuffers.fill(UNKNOWN);
+    }
+};
+}
+
+static State state;
+
+// Whether the tracked value has to be set, which it then is
+static bool update(GLuint& tracked, GLuint value)
+{
+    if (tracked == value) {
+        state.counts.skipped++;
+        return false;
+    }
+    tracked = value;
+    state.counts.issued++;
+    return true;
+}
+
+namespace gl_state {
+
+void useProgram(GLuint program)
+{
+    if (update(state.program, program))
+        glUseProgram(program);
+}
+
+void bindFramebuffer(GLuint framebuffer)
+{
+    if (update(state.framebuffer, framebuffer))
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void bindTextureUnit(GLuint unit, GLuint texture)
+{
+    GLuint untracked = UNKNOWN;
+    if (update(unit < NUM_TRACKED_UNITS ? state.textures[unit] : untracked, texture))
+        glBindTextureUnit(unit, texture);
+}
+
+void bindVertexArray(GLuint vertexArray)
+{
+    if (update(state.vertexArray, vertexArray))
+        glBindVertexArray(vertexArray);
+}
+
+void bindUniformBuffer(GLuint index, GLuint buffer)
+{
+    GLuint untracked = UNKNOWN;
+    if (update(index < NUM_TRACKED_UNIFORM_BUFFERS ? state.uniformBuffers[index] : untracked, buffer))
+        glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+}
+
+void invalidate()
+{
+    const CallCounts counts = state.counts;
+    state = State();
+    state.counts = counts;
+}
+
+CallCounts takeCallCounts()
+{
+    const CallCounts counts = state.counts;
+    state.counts = {};
+    return counts;
+}
+
+}
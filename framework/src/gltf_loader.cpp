@@ -0,0 +1,479 @@
+#include "mesh.h"
+#include "mapped_file.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+// rapidjson stringifies "GCC diagnostic ..." for its own pragmas, which the GCC macro of disable_all_warnings.h turns into "1 diagnostic"
+#pragma push_macro("GCC")
+#undef GCC
+DISABLE_WARNINGS_PUSH()
+#include <cereal/external/base64.hpp>
+#include <cereal/external/rapidjson/document.h>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <omp.h>
+DISABLE_WARNINGS_POP()
+#pragma pop_macro("GCC")
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+namespace json = CEREAL_RAPIDJSON_NAMESPACE;
+
+constexpr uint32_t GLB_MAGIC        = 0x46546C67U; // "glTF"
+constexpr uint32_t GLB_CHUNK_JSON   = 0x4E4F534AU; // "JSON"
+constexpr uint32_t GLB_CHUNK_BIN    = 0x004E4942U; // "BIN\0"
+constexpr uint64_t GLTF_MODE_TRIANGLES = 4ULL;
+
+enum GltfComponentType : int {
+    Byte            = 5120,
+    UnsignedByte    = 5121,
+    Short           = 5122,
+    UnsignedShort   = 5123,
+    UnsignedInt     = 5125,
+    Float           = 5126
+};
+
+[[noreturn]] void fail(const std::filesystem::path& file, std::string_view message)
+{
+    std::cerr << "Failed to load glTF file " << file << ": " << message << std::endl;
+    throw std::exception();
+}
+
+// Binary buffers referenced by the JSON. External files and GLB payloads are read straight from memory mappings,
+// only base64 data URIs need decoding into memory.
+struct GltfBuffers {
+    std::vector<MappedFile> mappings;
+    std::vector<std::string> decoded;
+    std::vector<std::span<const std::byte>> buffers;
+};
+
+// Strided view of the elements of an accessor
+struct GltfAccessor {
+    const std::byte* data;
+    size_t count;
+    size_t stride;
+    int componentType;
+    bool normalized;
+};
+
+bool isComponentType(int componentType)
+{
+    switch (componentType) {
+    case Byte:
+    case UnsignedByte:
+    case Short:
+    case UnsignedShort:
+    case UnsignedInt:
+    case Float:
+        return true;
+    default:
+        return false;
+    }
+}
+
+size_t componentSize(int componentType)
+{
+    switch (componentType) {
+    case Byte:
+    case UnsignedByte:
+        return 1;
+    case Short:
+    case UnsignedShort:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+size_t numComponents(std::string_view type)
+{
+    if (type == "SCALAR")   return 1;
+    if (type == "VEC2")     return 2;
+    if (type == "VEC3")     return 3;
+    if (type == "VEC4")     return 4;
+    return 0;
+}
+
+// Checked access to the JSON document. rapidjson's getters do not validate their input, so every member is checked
+// for presence and type here and malformed files fail() instead.
+bool hasMember(const json::Value& object, const char* name)
+{
+    return object.IsObject() && object.HasMember(name);
+}
+
+const json::Value& getMember(const json::Value& object, const char* name, const std::filesystem::path& file)
+{
+    if (!hasMember(object, name))
+        fail(file, std::string("missing \"") + name + "\"");
+    return object[name];
+}
+
+const json::Value& getArray(const json::Value& object, const char* name, const std::filesystem::path& file)
+{
+    const json::Value& member = getMember(object, name, file);
+    if (!member.IsArray())
+        fail(file, std::string("\"") + name + "\" is not an array");
+    return member;
+}
+
+const json::Value& getObject(const json::Value& object, const char* name, const std::filesystem::path& file)
+{
+    const json::Value& member = getMember(object, name, file);
+    if (!member.IsObject())
+        fail(file, std::string("\"") + name + "\" is not an object");
+    return member;
+}
+
+std::string_view getString(const json::Value& object, const char* name, const std::filesystem::path& file)
+{
+    const json::Value& member = getMember(object, name, file);
+    if (!member.IsString())
+        fail(file, std::string("\"") + name + "\" is not a string");
+    return { member.GetString(), member.GetStringLength() };
+}
+
+uint64_t getIndex(const json::Value& value, const std::filesystem::path& file)
+{
+    if (!value.IsUint64())
+        fail(file, "index is not an unsigned integer");
+    return value.GetUint64();
+}
+
+uint64_t getUint(const json::Value& object, const char* name, uint64_t defaultValue, const std::filesystem::path& file)
+{
+    return hasMember(object, name) ? getIndex(object[name], file) : defaultValue;
+}
+
+// Element of an array member that has to be an object, e.g. the accessor an index refers to
+const json::Value& getElement(const json::Value& object, const char* name, uint64_t index, const std::filesystem::path& file)
+{
+    const json::Value& array = getArray(object, name, file);
+    if (index >= array.Size() || !array[static_cast<json::SizeType>(index)].IsObject())
+        fail(file, std::string("invalid reference into \"") + name + "\"");
+    return array[static_cast<json::SizeType>(index)];
+}
+
+template <size_t N>
+std::array<float, N> getFloats(const json::Value& object, const char* name, const std::filesystem::path& file)
+{
+    const json::Value& array = getArray(object, name, file);
+    if (array.Size() != N)
+        fail(file, std::string("\"") + name + "\" has the wrong number of elements");
+    std::array<float, N> out;
+    for (json::SizeType i = 0; i < N; i++) {
+        if (!array[i].IsNumber())
+            fail(file, std::string("\"") + name + "\" contains a non-number");
+        out[i] = array[i].GetFloat();
+    }
+    return out;
+}
+
+template <typename T>
+T read(const std::byte* data)
+{
+    // glTF data is little-endian, like every platform we target
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+float readFloat(const std::byte* data, int componentType, bool normalized)
+{
+    switch (componentType) {
+    case Byte:          return normalized ? std::max(read<int8_t>(data) / 127.0f, -1.0f) : read<int8_t>(data);
+    case UnsignedByte:  return normalized ? read<uint8_t>(data) / 255.0f : read<uint8_t>(data);
+    case Short:         return normalized ? std::max(read<int16_t>(data) / 32767.0f, -1.0f) : read<int16_t>(data);
+    case UnsignedShort: return normalized ? read<uint16_t>(data) / 65535.0f : read<uint16_t>(data);
+    case UnsignedInt:   return static_cast<float>(read<uint32_t>(data));
+    default:            return read<float>(data);
+    }
+}
+
+uint32_t readIndex(const std::byte* data, int componentType)
+{
+    switch (componentType) {
+    case UnsignedByte:  return read<uint8_t>(data);
+    case UnsignedShort: return read<uint16_t>(data);
+    default:            return read<uint32_t>(data);
+    }
+}
+
+GltfBuffers loadBuffers(const json::Document& document, const std::filesystem::path& file, std::span<const std::byte> binaryChunk)
+{
+    GltfBuffers out;
+    if (!document.HasMember("buffers"))
+        return out;
+    const json::Value& buffers = getArray(document, "buffers", file);
+    out.mappings.reserve(buffers.Size());
+    out.decoded.reserve(buffers.Size());
+    for (const json::Value& buffer : buffers.GetArray()) {
+        if (!buffer.IsObject())
+            fail(file, "buffer is not an object");
+        std::span<const std::byte> bytes;
+        if (!buffer.HasMember("uri")) {
+            // The first buffer of a GLB file refers to its binary chunk
+            bytes = binaryChunk;
+        } else {
+            const std::string_view uri = getString(buffer, "uri", file);
+            if (uri.starts_with("data:")) {
+                const size_t dataStart = uri.find(',');
+                if (dataStart == std::string_view::npos || uri.substr(0, dataStart).find(";base64") == std::string_view::npos)
+                    fail(file, "unsupported data URI");
+                const std::string& decoded = out.decoded.emplace_back(cereal::base64::decode(std::string(uri.substr(dataStart + 1))));
+                bytes = { reinterpret_cast<const std::byte*>(decoded.data()), decoded.size() };
+            } else {
+                bytes = out.mappings.emplace_back(file.parent_path() / std::string(uri)).bytes();
+            }
+        }
+        if (bytes.size() < getUint(buffer, "byteLength", 0, file))
+            fail(file, "buffer is smaller than declared");
+        out.buffers.push_back(bytes);
+    }
+    return out;
+}
+
+GltfAccessor getAccessor(const json::Document& document, const GltfBuffers& buffers, uint64_t accessorIdx, size_t expectedComponents, const std::filesystem::path& file)
+{
+    const json::Value& accessor = getElement(document, "accessors", accessorIdx, file);
+    if (accessor.HasMember("sparse") || !accessor.HasMember("bufferView"))
+        fail(file, "sparse accessors are not supported");
+    if (numComponents(getString(accessor, "type", file)) != expectedComponents)
+        fail(file, "accessor has an unexpected type");
+
+    const json::Value& view = getElement(document, "bufferViews", getIndex(accessor["bufferView"], file), file);
+    const uint64_t bufferIdx = getIndex(getMember(view, "buffer", file), file);
+    if (bufferIdx >= buffers.buffers.size())
+        fail(file, "missing buffer");
+
+    const json::Value& componentType = getMember(accessor, "componentType", file);
+    if (!componentType.IsInt() || !isComponentType(componentType.GetInt()))
+        fail(file, "accessor has an invalid component type");
+    if (accessor.HasMember("normalized") && !accessor["normalized"].IsBool())
+        fail(file, "\"normalized\" is not a boolean");
+
+    GltfAccessor out;
+    out.count           = getIndex(getMember(accessor, "count", file), file);
+    out.componentType   = componentType.GetInt();
+    out.normalized      = accessor.HasMember("normalized") && accessor["normalized"].GetBool();
+    const size_t elementSize = componentSize(out.componentType) * expectedComponents;
+    out.stride          = getUint(view, "byteStride", elementSize, file);
+    if (out.count > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+        fail(file, "accessor has too many elements");
+
+    // Ensure the last element still lies within both the view and the buffer, without letting the sums wrap around
+    const std::span<const std::byte> buffer = buffers.buffers[bufferIdx];
+    const uint64_t viewOffset = getUint(view, "byteOffset", 0, file), viewLength = getIndex(getMember(view, "byteLength", file), file);
+    const uint64_t accessorOffset = getUint(accessor, "byteOffset", 0, file);
+    if (viewOffset > buffer.size() || viewLength > buffer.size() - viewOffset)
+        fail(file, "buffer view exceeds its buffer");
+    if (out.count > 0 && (accessorOffset > viewLength || elementSize > viewLength - accessorOffset
+            || (out.stride != 0 && out.count - 1 > (viewLength - accessorOffset - elementSize) / out.stride)))
+        fail(file, "accessor exceeds its buffer view");
+    out.data = buffer.data() + viewOffset + accessorOffset;
+    return out;
+}
+
+glm::mat4 nodeTransform(const json::Value& node, const std::filesystem::path& file)
+{
+    if (node.HasMember("matrix"))
+        return glm::make_mat4(getFloats<16>(node, "matrix", file).data()); // Column-major, like glm
+
+    glm::mat4 transform(1.0f);
+    if (node.HasMember("translation")) {
+        const auto t = getFloats<3>(node, "translation", file);
+        transform = glm::translate(transform, glm::vec3(t[0], t[1], t[2]));
+    }
+    if (node.HasMember("rotation")) {
+        const auto r = getFloats<4>(node, "rotation", file);
+        transform *= glm::mat4_cast(glm::quat(r[3], r[0], r[1], r[2]));
+    }
+    if (node.HasMember("scale")) {
+        const auto s = getFloats<3>(node, "scale", file);
+        transform = glm::scale(transform, glm::vec3(s[0], s[1], s[2]));
+    }
+    return transform;
+}
+
+Mesh loadPrimitive(const json::Document& document, const GltfBuffers& buffers, const json::Value& primitive, const glm::mat4& transform, const std::filesystem::path& file)
+{
+    const json::Value& attributes = getObject(primitive, "attributes", file);
+    if (!attributes.HasMember("POSITION"))
+        fail(file, "primitive without positions");
+    const GltfAccessor positions = getAccessor(document, buffers, getIndex(attributes["POSITION"], file), 3, file);
+    const bool hasNormals = attributes.HasMember("NORMAL");
+    const bool hasTexCoords = attributes.HasMember("TEXCOORD_0");
+    const GltfAccessor normals = hasNormals ? getAccessor(document, buffers, getIndex(attributes["NORMAL"], file), 3, file) : positions;
+    const GltfAccessor texCoords = hasTexCoords ? getAccessor(document, buffers, getIndex(attributes["TEXCOORD_0"], file), 2, file) : positions;
+    if ((hasNormals && normals.count != positions.count) || (hasTexCoords && texCoords.count != positions.count))
+        fail(file, "attributes have differing lengths");
+
+    // Vertices are decoded straight from the buffers, in parallel
+    Mesh mesh;
+    mesh.vertices.resize(positions.count);
+    const glm::mat3 normalTransform = glm::inverseTranspose(glm::mat3(transform));
+    #pragma omp parallel for
+    for (int vertexIdx = 0; vertexIdx < static_cast<int>(positions.count); vertexIdx++) {
+        Vertex& vertex = mesh.vertices[vertexIdx];
+        const size_t componentBytes = componentSize(positions.componentType);
+        const std::byte* position = positions.data + static_cast<size_t>(vertexIdx) * positions.stride;
+        for (int axis = 0; axis < 3; axis++)
+            vertex.position[axis] = readFloat(position + axis * componentBytes, positions.componentType, positions.normalized);
+        vertex.position = glm::vec3(transform * glm::vec4(vertex.position, 1.0f));
+
+        vertex.normal = glm::vec3(0.0f);
+        if (hasNormals) {
+            const std::byte* normal = normals.data + static_cast<size_t>(vertexIdx) * normals.stride;
+            for (int axis = 0; axis < 3; axis++)
+                vertex.normal[axis] = readFloat(normal + axis * componentSize(normals.componentType), normals.componentType, normals.normalized);
+            vertex.normal = glm::normalize(normalTransform * vertex.normal);
+        }
+
+        vertex.texCoord = glm::vec2(0.0f);
+        if (hasTexCoords) {
+            const std::byte* texCoord = texCoords.data + static_cast<size_t>(vertexIdx) * texCoords.stride;
+            for (int axis = 0; axis < 2; axis++)
+                vertex.texCoord[axis] = readFloat(texCoord + axis * componentSize(texCoords.componentType), texCoords.componentType, texCoords.normalized);
+        }
+    }
+
+    // Non-indexed primitives list their vertices in order. Mirroring transforms flip the winding, which is undone here.
+    const bool flipWinding = glm::determinant(glm::mat3(transform)) < 0.0f;
+    if (primitive.HasMember("indices")) {
+        const GltfAccessor indices = getAccessor(document, buffers, getIndex(primitive["indices"], file), 1, file);
+        if (indices.componentType != UnsignedByte && indices.componentType != UnsignedShort && indices.componentType != UnsignedInt)
+            fail(file, "indices are not unsigned integers");
+        if (indices.count % 3 != 0)
+            fail(file, "index count is not a multiple of three");
+        mesh.triangles.resize(indices.count / 3);
+        bool validIndices = true;
+        #pragma omp parallel for reduction(&& : validIndices)
+        for (int triangleIdx = 0; triangleIdx < static_cast<int>(mesh.triangles.size()); triangleIdx++) {
+            glm::uvec3& triangle = mesh.triangles[triangleIdx];
+            for (int corner = 0; corner < 3; corner++)
+                triangle[corner] = readIndex(indices.data + (3 * static_cast<size_t>(triangleIdx) + corner) * indices.stride, indices.componentType);
+            validIndices = validIndices && glm::all(glm::lessThan(triangle, glm::uvec3(static_cast<uint32_t>(positions.count))));
+            if (flipWinding)
+                std::swap(triangle.y, triangle.z);
+        }
+        if (!validIndices)
+            fail(file, "index references a missing vertex");
+    } else {
+        mesh.triangles.resize(positions.count / 3);
+        for (uint32_t triangleIdx = 0; triangleIdx < mesh.triangles.size(); triangleIdx++)
+            mesh.triangles[triangleIdx] = flipWinding ? glm::uvec3(3 * triangleIdx, 3 * triangleIdx + 2, 3 * triangleIdx + 1) : glm::uvec3(3 * triangleIdx, 3 * triangleIdx + 1, 3 * triangleIdx + 2);
+    }
+
+    if (!hasNormals)
+        meshComputeSmoothNormals(mesh);
+
+    // Only the base color factor maps onto our material model
+    if (primitive.HasMember("material")) {
+        const json::Value& material = getElement(document, "materials", getIndex(primitive["material"], file), file);
+        if (material.HasMember("pbrMetallicRoughness")) {
+            const json::Value& pbr = getObject(material, "pbrMetallicRoughness", file);
+            if (pbr.HasMember("baseColorFactor")) {
+                const auto baseColor = getFloats<4>(pbr, "baseColorFactor", file);
+                mesh.material.kd = glm::vec3(baseColor[0], baseColor[1], baseColor[2]);
+                mesh.material.transparency = baseColor[3];
+            }
+        }
+    }
+    return mesh;
+}
+
+}
+
+std::vector<Mesh> loadGLTF(const std::filesystem::path& file)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const MappedFile mapping(file);
+    std::span<const std::byte> jsonChunk = mapping.bytes(), binaryChunk;
+
+    // GLB files wrap the JSON and an optional binary buffer in chunks
+    if (mapping.size() >= 12 && read<uint32_t>(mapping.bytes().data()) == GLB_MAGIC) {
+        jsonChunk = {};
+        size_t offset = 12;
+        while (offset + 8 <= mapping.size()) {
+            const uint32_t chunkLength  = read<uint32_t>(mapping.bytes().data() + offset);
+            const uint32_t chunkType    = read<uint32_t>(mapping.bytes().data() + offset + 4);
+            if (offset + 8 + chunkLength > mapping.size())
+                fail(file, "truncated chunk");
+            const std::span<const std::byte> chunk = mapping.bytes().subspan(offset + 8, chunkLength);
+            if (chunkType == GLB_CHUNK_JSON && jsonChunk.empty())
+                jsonChunk = chunk;
+            else if (chunkType == GLB_CHUNK_BIN && binaryChunk.empty())
+                binaryChunk = chunk;
+            offset += 8 + chunkLength;
+        }
+    }
+
+    json::Document document;
+    document.Parse(reinterpret_cast<const char*>(jsonChunk.data()), jsonChunk.size());
+    if (document.HasParseError() || !document.IsObject())
+        fail(file, "invalid JSON");
+    const GltfBuffers buffers = loadBuffers(document, file, binaryChunk);
+
+    // Instantiate meshes through the node hierarchy of the default scene, or as they are if there is none
+    std::vector<Mesh> out;
+    const auto addMesh = [&](uint64_t meshIdx, const glm::mat4& transform) {
+        const json::Value& mesh = getElement(document, "meshes", meshIdx, file);
+        for (const json::Value& primitive : getArray(mesh, "primitives", file).GetArray()) {
+            if (!primitive.IsObject())
+                fail(file, "primitive is not an object");
+            if (getUint(primitive, "mode", GLTF_MODE_TRIANGLES, file) != GLTF_MODE_TRIANGLES) {
+                std::cerr << "Skipping non-triangle primitive in " << file << std::endl;
+                continue;
+            }
+            out.push_back(loadPrimitive(document, buffers, primitive, transform, file));
+        }
+    };
+    if (document.HasMember("scenes") && getArray(document, "scenes", file).Size() > 0) {
+        const json::Value& scene = getElement(document, "scenes", getUint(document, "scene", 0, file), file);
+        const std::function<void(uint64_t, const glm::mat4&, size_t)> visitNode = [&](uint64_t nodeIdx, const glm::mat4& parentTransform, size_t depth) {
+            const json::Value& node = getElement(document, "nodes", nodeIdx, file);
+            if (depth > document["nodes"].Size())
+                fail(file, "invalid node hierarchy");
+            const glm::mat4 transform = parentTransform * nodeTransform(node, file);
+            if (node.HasMember("mesh"))
+                addMesh(getIndex(node["mesh"], file), transform);
+            if (node.HasMember("children")) {
+                for (const json::Value& child : getArray(node, "children", file).GetArray())
+                    visitNode(getIndex(child, file), transform, depth + 1);
+            }
+        };
+        if (scene.HasMember("nodes")) {
+            for (const json::Value& node : getArray(scene, "nodes", file).GetArray())
+                visitNode(getIndex(node, file), glm::mat4(1.0f), 0);
+        }
+    } else if (document.HasMember("meshes")) {
+        for (json::SizeType meshIdx = 0; meshIdx < getArray(document, "meshes", file).Size(); meshIdx++)
+            addMesh(meshIdx, glm::mat4(1.0f));
+    }
+    if (out.empty())
+        fail(file, "no triangle meshes");
+
+    size_t numVertices = 0, numTriangles = 0;
+    for (const Mesh& mesh : out) {
+        numVertices += mesh.vertices.size();
+        numTriangles += mesh.triangles.size();
+    }
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Loaded " << file.filename() << " (" << numVertices << " vertices, " << numTriangles << " triangles) in " << milliseconds << " ms" << std::endl;
+    return out;
+}
@@ -0,0 +1,106 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <format>
+#include <utility>
+
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path& filePath) {
+    m_fileHandle = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_fileHandle == INVALID_HANDLE_VALUE) {
+        m_fileHandle = nullptr;
+        throw FileMappingException(std::format("Could not open {} for mapping", filePath.string()));
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(m_fileHandle, &fileSize);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    if (m_size == 0ULL) { return; } // Zero-length mappings are not allowed; an empty span describes the file just fine
+
+    m_mappingHandle = CreateFileMappingW(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mappingHandle == nullptr) {
+        unmap();
+        throw FileMappingException(std::format("Could not create mapping for {}", filePath.string()));
+    }
+    m_data = static_cast<const std::byte*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) {
+        unmap();
+        throw FileMappingException(std::format("Could not map view of {}", filePath.string()));
+    }
+}
+
+void MappedFile::unmap() {
+    if (m_data)             { UnmapViewOfFile(m_data); }
+    if (m_mappingHandle)    { CloseHandle(m_mappingHandle); }
+    if (m_fileHandle)       { CloseHandle(m_fileHandle); }
+    m_data          = nullptr;
+    m_size          = 0ULL;
+    m_mappingHandle = nullptr;
+    m_fileHandle    = nullptr;
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path& filePath) {
+    int fileDescriptor = open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) { throw FileMappingException(std::format("Could not open {} for mapping", filePath.string())); }
+
+    struct stat fileStats;
+    if (fstat(fileDescriptor, &fileStats) != 0) {
+        close(fileDescriptor);
+        throw FileMappingException(std::format("Could not query size of {}", filePath.string()));
+    }
+    m_size = static_cast<size_t>(fileStats.st_size);
+    if (m_size == 0ULL) { // Zero-length mappings are not allowed; an empty span describes the file just fine
+        close(fileDescriptor);
+        return;
+    }
+
+    // The mapping keeps its own reference to the file, so the descriptor is not needed afterwards
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (mapping == MAP_FAILED) {
+        m_size = 0ULL;
+        throw FileMappingException(std::format("Could not map {}", filePath.string()));
+    }
+    madvise(mapping, m_size, MADV_SEQUENTIAL);
+    madvise(mapping, m_size, MADV_WILLNEED);
+    m_data = static_cast<const std::byte*>(mapping);
+}
+
+void MappedFile::unmap() {
+    if (m_data) { munmap(const_cast<std::byte*>(m_data), m_size); }
+    m_data = nullptr;
+    m_size = 0ULL;
+}
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        m_data          = std::exchange(other.m_data, nullptr);
+        m_size          = std::exchange(other.m_size, 0ULL);
+#ifdef _WIN32
+        m_fileHandle    = std::exchange(other.m_fileHandle, nullptr);
+        m_mappingHandle = std::exchange(other.m_mappingHandle, nullptr);
+#endif
+    }
+    return *this;
+}
@@ -1,73 +1,98 @@
 #include "mesh.h"
+#include "obj_parser.h"
 // Suppress warnings in third-party code.
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
+#include <omp.h>
 #include <tinyobjloader/tiny_obj_loader.h>
 DISABLE_WARNINGS_POP()
 #include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cmath>
 #include <exception>
 #include <iostream>
+#include <limits>
 #include <numeric>
+#include <optional>
 #include <span>
 #include <stack>
 #include <string>
 #include <tuple>
-#include <unordered_map>
+#include <utility>
 
-static void centerAndScaleToUnitMesh(std::span<Mesh> meshes);
+static std::vector<Mesh> loadOBJ(const std::filesystem::path& file, bool parallelParse);
 
 static glm::vec3 construct_vec3(const float* pFloats)
 {
     return glm::vec3(pFloats[0], pFloats[1], pFloats[2]);
 }
 
-// https://stackoverflow.com/questions/2590677/how-do-i-combine-hash-values-in-c0x
-template <class T>
-static void hash_combine(std::size_t& seed, const T& v)
-{
-    std::hash<T> hasher;
-    seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-}
-
-struct VertexHash {
-    size_t operator()(const Vertex& v) const
-    {
-        size_t seed = 0;
-        hash_combine(seed, v.position.x);
-        hash_combine(seed, v.position.y);
-        hash_combine(seed, v.position.z);
-        hash_combine(seed, v.normal.x);
-        hash_combine(seed, v.normal.y);
-        hash_combine(seed, v.normal.z);
-        hash_combine(seed, v.texCoord.s);
-        hash_combine(seed, v.texCoord.t);
-        return seed;
-    }
-};
-
-std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNormalize)
+std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNormalize, bool parallelParse)
 {
     if (!std::filesystem::exists(file)) {
         std::cerr << "File " << file << " does not exist." << std::endl;
         throw std::exception();
     }
 
-    const auto baseDir = file.parent_path();
+    std::string extension = file.extension().string();
+    std::transform(std::begin(extension), std::end(extension), std::begin(extension), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    std::vector<Mesh> out;
+    if (extension == ".ply")
+        out = loadPLY(file);
+    else if (extension == ".gltf" || extension == ".glb")
+        out = loadGLTF(file);
+    else
+        out = loadOBJ(file, parallelParse);
 
-    tinyobj::attrib_t inAttrib;
-    std::vector<tinyobj::shape_t> inShapes;
-    std::vector<tinyobj::material_t> inMaterials;
+    if (centerAndNormalize)
+        meshCenterAndScaleToUnit(out);
 
-    std::string warn, error;
-    bool ret = tinyobj::LoadObj(&inAttrib, &inShapes, &inMaterials, &warn, &error, file.string().c_str(), baseDir.string().c_str());
-    if (!ret) {
-        std::cerr << "Failed to load mesh " << file << std::endl;
-        throw std::exception();
+    return out;
+}
+
+static std::vector<Mesh> loadOBJ(const std::filesystem::path& file, bool parallelParse)
+{
+    const auto baseDir = file.parent_path();
+
+    // Use the parallel parser where possible, tinyobjloader handles everything else
+    const auto parseStart = std::chrono::steady_clock::now();
+    std::optional<ObjData> obj;
+    if (parallelParse)
+        obj = parseObjParallel(file, baseDir);
+    const bool parsedInParallel = obj.has_value();
+    if (!parsedInParallel) {
+        obj.emplace();
+        std::string warn, error;
+        bool ret = tinyobj::LoadObj(&obj->attrib, &obj->shapes, &obj->materials, &warn, &error, file.string().c_str(), baseDir.string().c_str());
+        if (!ret) {
+            std::cerr << "Failed to load mesh " << file << std::endl;
+            throw std::exception();
+        }
     }
+    const double parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parseStart).count();
+    std::cout << "Parsed " << file.filename() << " in " << parseSeconds * 1000.0 << " ms using " << (parsedInParallel ? "the parallel parser" : "tinyobjloader") << std::endl;
+    const tinyobj::attrib_t& inAttrib = obj->attrib;
+    const std::vector<tinyobj::shape_t>& inShapes = obj->shapes;
+    const std::vector<tinyobj::material_t>& inMaterials = obj->materials;
+
+    // Scratch space for vertex deduplication, allocated once and shared by all sub meshes.
+    // Vertices are identified by their full (position, normal, texture coordinate) index triple. Candidates are found through a
+    // flat table indexed by position index that points to the first vertex created for it; further vertices sharing that position
+    // are chained through nextWithPosition. Only table entries touched by a sub mesh are reset afterwards.
+    constexpr uint32_t noVertex = std::numeric_limits<uint32_t>::max();
+    size_t maxCorners = 0;
+    for (const auto& shape : inShapes)
+        maxCorners = std::max(maxCorners, shape.mesh.indices.size());
+    std::vector<uint32_t> firstWithPosition(inAttrib.vertices.size() / 3, noVertex);
+    std::vector<uint32_t> nextWithPosition(maxCorners);
+    std::vector<uint32_t> firstCorner(maxCorners); // Corner (index into shape.mesh.indices) that created each vertex
+    std::vector<uint32_t> cornerToVertex(maxCorners);
 
     std::vector<Mesh> out;
     for (const auto& shape : inShapes) {
@@ -84,41 +109,57 @@ std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNorm
             else
                 prevMaterialID = shape.mesh.material_ids[endTriangle];
 
+            // Map every corner to a unique vertex before creating any, so that the sub mesh can be allocated exactly
+            const size_t firstCornerIdx = startTriangle * 3, numCorners = (endTriangle - startTriangle) * 3;
+            uint32_t numVertices = 0;
+            for (size_t i = 0; i < numCorners; i++) {
+                const auto& tinyObjIndex = shape.mesh.indices[firstCornerIdx + i];
+                uint32_t& first = firstWithPosition[tinyObjIndex.vertex_index];
+                uint32_t vertexIdx = first;
+                while (vertexIdx != noVertex) {
+                    const auto& candidate = shape.mesh.indices[firstCornerIdx + firstCorner[vertexIdx]];
+                    if (candidate.normal_index == tinyObjIndex.normal_index && candidate.texcoord_index == tinyObjIndex.texcoord_index)
+                        break;
+                    vertexIdx = nextWithPosition[vertexIdx];
+                }
+                if (vertexIdx == noVertex) {
+                    // New vertex? Prepend it to the chain of its position.
+                    vertexIdx = numVertices++;
+                    firstCorner[vertexIdx] = static_cast<uint32_t>(i);
+                    nextWithPosition[vertexIdx] = first;
+                    first = vertexIdx;
+                }
+                cornerToVertex[i] = vertexIdx;
+            }
+
             Mesh mesh;
-            std::unordered_map<uint32_t, uint32_t> vertexCache; // Map the index of a vertex as loaded by tinyobjloader to its index in the generated mesh
-            for (size_t i = startTriangle * 3; i != endTriangle * 3; i += 3) {
-                const glm::vec3 v0 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 0].vertex_index]);
-                const glm::vec3 v1 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 1].vertex_index]);
-                const glm::vec3 v2 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 2].vertex_index]);
-                const auto geometricNormal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
-
-                // Load the triangle indices and lazily create the vertices.
-                glm::uvec3 triangle;
-                for (unsigned j = 0; j < 3; j++) {
-                    const auto& tinyObjIndex = shape.mesh.indices[i + j];
-                    Vertex vertex {
-                        .position = construct_vec3(&inAttrib.vertices[3 * tinyObjIndex.vertex_index]),
-                        .normal = glm::vec3(0),
-                        .texCoord = glm::vec2(0)
-                    };
-                    if (tinyObjIndex.normal_index != -1 && !inAttrib.normals.empty())
-                        vertex.normal = glm::vec3(inAttrib.normals[3 * tinyObjIndex.normal_index + 0], inAttrib.normals[3 * tinyObjIndex.normal_index + 1], inAttrib.normals[3 * tinyObjIndex.normal_index + 2]);
-                    else
-                        vertex.normal = geometricNormal;
-                    if (tinyObjIndex.texcoord_index != -1 && !inAttrib.texcoords.empty())
-                        vertex.texCoord = glm::vec2(inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 0], inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 1]);
-
-                    if (auto iter = vertexCache.find(tinyObjIndex.vertex_index); iter != std::end(vertexCache)) {
-                        // Already visited this vertex? Reuse it!
-                        triangle[j] = iter->second;
-                    } else {                      
-                        // New vertex? Create it and store it in the vertex cache.
-                        vertexCache[tinyObjIndex.vertex_index] = triangle[j] = mesh.vertices.size();
-                        mesh.vertices.push_back(vertex);
-                    }
+            mesh.vertices.resize(numVertices);
+            mesh.triangles.resize(numCorners / 3);
+            for (uint32_t vertexIdx = 0; vertexIdx < numVertices; vertexIdx++) {
+                // Vertices without a normal take the geometric normal of the triangle that first referenced them
+                const uint32_t corner = firstCorner[vertexIdx];
+                const auto& tinyObjIndex = shape.mesh.indices[firstCornerIdx + corner];
+                const size_t triangleCorner = firstCornerIdx + corner - corner % 3;
+                Vertex& vertex = mesh.vertices[vertexIdx];
+                vertex.position = construct_vec3(&inAttrib.vertices[3 * tinyObjIndex.vertex_index]);
+                if (tinyObjIndex.normal_index != -1 && !inAttrib.normals.empty()) {
+                    vertex.normal = construct_vec3(&inAttrib.normals[3 * tinyObjIndex.normal_index]);
+                } else {
+                    const glm::vec3 v0 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[triangleCorner + 0].vertex_index]);
+                    const glm::vec3 v1 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[triangleCorner + 1].vertex_index]);
+                    const glm::vec3 v2 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[triangleCorner + 2].vertex_index]);
+                    vertex.normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
                 }
-                mesh.triangles.push_back(triangle);
+                if (tinyObjIndex.texcoord_index != -1 && !inAttrib.texcoords.empty())
+                    vertex.texCoord = glm::vec2(inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 0], inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 1]);
+                else
+                    vertex.texCoord = glm::vec2(0);
+
+                // Reset the table for the next sub mesh
+                firstWithPosition[tinyObjIndex.vertex_index] = noVertex;
             }
+            for (size_t i = 0; i < numCorners; i += 3)
+                mesh.triangles[i / 3] = glm::uvec3(cornerToVertex[i + 0], cornerToVertex[i + 1], cornerToVertex[i + 2]);
 
             const auto materialID = shape.mesh.material_ids[startTriangle];
             if (materialID == -1) {
@@ -142,37 +183,71 @@ std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNorm
         }
     }
 
-    if (centerAndNormalize)
-        centerAndScaleToUnitMesh(out);
-
     return out;
 }
 
-static void centerAndScaleToUnitMesh(std::span<Mesh> meshes)
+// Vertex positions of either layout, so that both share a single implementation of the loops below
+static size_t numVertices(const Mesh& mesh) { return mesh.vertices.size(); }
+static size_t numVertices(const MeshSoA& mesh) { return mesh.positions.size(); }
+static glm::vec3& vertexPosition(Mesh& mesh, int vertexIdx) { return mesh.vertices[vertexIdx].position; }
+static glm::vec3& vertexPosition(MeshSoA& mesh, int vertexIdx) { return mesh.positions[vertexIdx]; }
+
+template <typename MeshType>
+static void centerAndScaleToUnit(std::span<MeshType> meshes)
 {
-    std::vector<glm::vec3> positions;
-    for (const auto& mesh : meshes)
-        std::transform(std::begin(mesh.vertices), std::end(mesh.vertices),
-            std::back_inserter(positions),
-            [](const Vertex& v) { return v.position; });
-    const glm::vec3 center = std::accumulate(std::begin(positions), std::end(positions), glm::vec3(0.0f)) / static_cast<float>(positions.size());
-    float maxD = 0.0f;
-    for (const glm::vec3& p : positions)
-        maxD = std::max(glm::length(p - center), maxD);
-    /*// REQUIRES A MODERN COMPILER
-      const float maxD = std::transform_reduce(
-              std::begin(vertices), std::end(vertices),
-              0.0f,
-              [](float lhs, float rhs) { return std::max(lhs, rhs); },
-              [=](const Vertex& v) { return glm::length(v.pos - center); });*/
+    // Mean position. Sums are kept in double precision, as float sums over millions of vertices lose most of every addend
+    size_t totalVertices = 0;
+    double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+    for (MeshType& mesh : meshes) {
+        totalVertices += numVertices(mesh);
+        #pragma omp parallel for reduction(+ : sumX, sumY, sumZ)
+        for (int vertexIdx = 0; vertexIdx < static_cast<int>(numVertices(mesh)); vertexIdx++) {
+            const glm::vec3& position = vertexPosition(mesh, vertexIdx);
+            sumX += position.x;
+            sumY += position.y;
+            sumZ += position.z;
+        }
+    }
+    if (totalVertices == 0)
+        return;
+    const glm::dvec3 center = glm::dvec3(sumX, sumY, sumZ) / static_cast<double>(totalVertices);
 
-    for (auto& mesh : meshes) {
-        std::transform(std::begin(mesh.vertices), std::end(mesh.vertices),
-            std::begin(mesh.vertices), [=](Vertex v) {
-                v.position = (v.position - center) / maxD;
-                return v;
-            });
+    // Largest squared distance to the mean. Max reductions need OpenMP 3.1, which MSVC does not support, so every thread
+    // keeps its own maximum and merges it at the end
+    double maxSquaredDistance = 0.0;
+    for (MeshType& mesh : meshes) {
+        #pragma omp parallel
+        {
+            double threadMaxSquaredDistance = 0.0;
+            #pragma omp for nowait
+            for (int vertexIdx = 0; vertexIdx < static_cast<int>(numVertices(mesh)); vertexIdx++) {
+                const glm::dvec3 offset = glm::dvec3(vertexPosition(mesh, vertexIdx)) - center;
+                threadMaxSquaredDistance = std::max(threadMaxSquaredDistance, glm::dot(offset, offset));
+            }
+            #pragma omp critical
+            maxSquaredDistance = std::max(maxSquaredDistance, threadMaxSquaredDistance);
+        }
     }
+    const double scale = maxSquaredDistance > 0.0 ? 1.0 / std::sqrt(maxSquaredDistance) : 1.0;
+
+    // Translate and scale in place, in double precision so that models far from the origin keep their detail
+    for (MeshType& mesh : meshes) {
+        #pragma omp parallel for
+        for (int vertexIdx = 0; vertexIdx < static_cast<int>(numVertices(mesh)); vertexIdx++) {
+            glm::vec3& position = vertexPosition(mesh, vertexIdx);
+            position = glm::vec3((glm::dvec3(position) - center) * scale);
+        }
+    }
+}
+
+void meshCenterAndScaleToUnit(std::span<Mesh> meshes)
+{
+    centerAndScaleToUnit(meshes);
+}
+
+void meshCenterAndScaleToUnit(std::span<MeshSoA> meshes)
+{
+    centerAndScaleToUnit(meshes);
 }
 
 Mesh mergeMeshes(std::span<const Mesh> meshes)
@@ -213,4 +288,241 @@ void meshFlipZ(Mesh& mesh)
         v.position.z = -v.position.z;
         v.normal.z = -v.normal.z;
     }
-}
\ No newline at end of file
+}
+
+MeshSoA meshToSoA(const Mesh& mesh)
+{
+    MeshSoA out;
+    out.positions.resize(mesh.vertices.size());
+    out.normals.resize(mesh.vertices.size());
+    out.texCoords.resize(mesh.vertices.size());
+    out.distancesInner.resize(mesh.vertices.size());
+    #pragma omp parallel for
+    for (int vertexIdx = 0; vertexIdx < static_cast<int>(mesh.vertices.size()); vertexIdx++) {
+        const Vertex& vertex = mesh.vertices[vertexIdx];
+        out.positions[vertexIdx] = vertex.position;
+        out.normals[vertexIdx] = vertex.normal;
+        out.texCoords[vertexIdx] = vertex.texCoord;
+        out.distancesInner[vertexIdx] = vertex.distanceInner;
+    }
+    out.triangles = mesh.triangles;
+    out.material = mesh.material;
+    return out;
+}
+
+MeshSoA meshToSoA(Mesh&& mesh)
+{
+    std::vector<glm::uvec3> triangles = std::move(mesh.triangles);
+    Material material = std::move(mesh.material);
+    MeshSoA out = meshToSoA(mesh);
+    out.triangles = std::move(triangles);
+    out.material = std::move(material);
+    mesh.vertices = {};
+    return out;
+}
+
+Mesh meshFromSoA(const MeshSoA& mesh)
+{
+    Mesh out;
+    out.vertices.resize(mesh.numVertices());
+    #pragma omp parallel for
+    for (int vertexIdx = 0; vertexIdx < static_cast<int>(mesh.numVertices()); vertexIdx++) {
+        out.vertices[vertexIdx] = { .position = mesh.positions[vertexIdx],
+                                    .normal = mesh.normals[vertexIdx],
+                                    .texCoord = mesh.texCoords[vertexIdx],
+                                    .distanceInner = mesh.distancesInner[vertexIdx] };
+    }
+    out.triangles = mesh.triangles;
+    out.material = mesh.material;
+    return out;
+}
+
+Mesh meshFromSoA(MeshSoA&& mesh)
+{
+    std::vector<glm::uvec3> triangles = std::move(mesh.triangles);
+    Material material = std::move(mesh.material);
+    Mesh out = meshFromSoA(mesh);
+    out.triangles = std::move(triangles);
+    out.material = std::move(material);
+    mesh = {};
+    return out;
+}
+
+// Negating one component of every element; on separate arrays this touches only the bytes that change
+static void flipComponent(std::span<glm::vec3> values, int component)
+{
+    float* data = glm::value_ptr(values.front());
+    const int numFloats = static_cast<int>(3 * values.size());
+    #pragma omp simd
+    for (int floatIdx = component; floatIdx < numFloats; floatIdx += 3)
+        data[floatIdx] = -data[floatIdx];
+}
+
+void meshFlipX(MeshSoA& mesh)
+{
+    if (mesh.numVertices() == 0)
+        return;
+    flipComponent(mesh.positions, 0);
+    flipComponent(mesh.normals, 0);
+}
+
+void meshFlipY(MeshSoA& mesh)
+{
+    if (mesh.numVertices() == 0)
+        return;
+    flipComponent(mesh.positions, 1);
+    flipComponent(mesh.normals, 1);
+}
+
+void meshFlipZ(MeshSoA& mesh)
+{
+    if (mesh.numVertices() == 0)
+        return;
+    flipComponent(mesh.positions, 2);
+    flipComponent(mesh.normals, 2);
+}
+
+// Cell of the welding grid, counted from the minimum corner of the mesh bounds. Cells are as wide as the welding distance, so vertices
+// to be welded always lie in neighbouring cells. Cell coordinates are clamped to [0, maxWeldCells] before the conversion to int,
+// which would otherwise overflow for tiny distances or non-finite positions.
+static constexpr float maxWeldCells = float(1 << 20);
+static glm::ivec3 weldCell(const glm::vec3& position, const glm::vec3& origin, float epsilon)
+{
+    const glm::vec3 cell = glm::floor((position - origin) / epsilon);
+    glm::ivec3 out;
+    for (int axis = 0; axis < 3; axis++)
+        out[axis] = cell[axis] >= 0.0f ? static_cast<int>(std::min(cell[axis], maxWeldCells)) : 0; // Also maps NaN to zero
+    return out;
+}
+
+static size_t weldCellHash(const glm::ivec3& cell, size_t tableMask)
+{
+    // Large primes from "Optimized Spatial Hashing for Collision Detection of Deformable Objects" (Teschner et al.)
+    return ((static_cast<size_t>(cell.x) * 73856093ULL) ^ (static_cast<size_t>(cell.y) * 19349663ULL) ^ (static_cast<size_t>(cell.z) * 83492791ULL)) & tableMask;
+}
+
+size_t meshWeldVertices(Mesh& mesh, float epsilon)
+{
+    const size_t numVertices = mesh.vertices.size();
+    if (numVertices == 0 || epsilon <= 0.0f)
+        return 0;
+
+    // Never use more cells along an axis than the grid allows; vertices closer than the resulting distance are welded regardless
+    glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(std::numeric_limits<float>::lowest());
+    for (const Vertex& vertex : mesh.vertices) {
+        if (std::isfinite(vertex.position.x) && std::isfinite(vertex.position.y) && std::isfinite(vertex.position.z)) {
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
+        }
+    }
+    if (boundsMin.x > boundsMax.x)
+        return 0; // No finite positions
+    const glm::vec3 extent = boundsMax - boundsMin;
+    epsilon = std::max(epsilon, std::max({ extent.x, extent.y, extent.z }) / maxWeldCells);
+
+    // Bucket vertices by the hash of their grid cell (counting sort into a flat table)
+    size_t tableSize = 1;
+    while (tableSize < numVertices)
+        tableSize <<= 1;
+    const size_t tableMask = tableSize - 1;
+    std::vector<uint32_t> bucketOffsets(tableSize + 1, 0);
+    std::vector<uint32_t> vertexBuckets(numVertices);
+    #pragma omp parallel for
+    for (int vertexIdx = 0; vertexIdx < static_cast<int>(numVertices); vertexIdx++)
+        vertexBuckets[vertexIdx] = static_cast<uint32_t>(weldCellHash(weldCell(mesh.vertices[vertexIdx].position, boundsMin, epsilon), tableMask));
+    for (uint32_t bucket : vertexBuckets)
+        bucketOffsets[bucket + 1]++;
+    std::partial_sum(std::begin(bucketOffsets), std::end(bucketOffsets), std::begin(bucketOffsets));
+    std::vector<uint32_t> bucketVertices(numVertices);
+    {
+        std::vector<uint32_t> bucketFill(std::begin(bucketOffsets), std::end(bucketOffsets) - 1);
+        for (uint32_t vertexIdx = 0; vertexIdx < numVertices; vertexIdx++)
+            bucketVertices[bucketFill[vertexBuckets[vertexIdx]]++] = vertexIdx;
+    }
+
+    // Every vertex joins the lowest-indexed vertex within epsilon of it, searching the 27 surrounding cells.
+    // Buckets hold vertices in ascending order, so the search for the lowest index stops early.
+    std::vector<uint32_t> weldTarget(numVertices);
+    const float inverseEpsilon = 1.0f / epsilon; // Distances are compared in units of epsilon, whose square may not be representable
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int vertexIdx = 0; vertexIdx < static_cast<int>(numVertices); vertexIdx++) {
+        const glm::vec3 position = mesh.vertices[vertexIdx].position;
+        const glm::ivec3 cell = weldCell(position, boundsMin, epsilon);
+        uint32_t target = static_cast<uint32_t>(vertexIdx);
+        for (int dz = -1; dz <= 1; dz++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    const size_t bucket = weldCellHash(cell + glm::ivec3(dx, dy, dz), tableMask);
+                    for (uint32_t i = bucketOffsets[bucket]; i < bucketOffsets[bucket + 1] && bucketVertices[i] < target; i++) {
+                        const glm::vec3 offset = (mesh.vertices[bucketVertices[i]].position - position) * inverseEpsilon;
+                        if (glm::dot(offset, offset) <= 1.0f)
+                            target = bucketVertices[i];
+                    }
+                }
+            }
+        }
+        weldTarget[vertexIdx] = target;
+    }
+
+    // Targets always have a lower index, so resolving in ascending order makes chains point at their first vertex
+    std::vector<uint32_t> remap(numVertices);
+    std::vector<Vertex> weldedVertices;
+    weldedVertices.reserve(numVertices);
+    for (uint32_t vertexIdx = 0; vertexIdx < numVertices; vertexIdx++) {
+        if (weldTarget[vertexIdx] == vertexIdx) {
+            remap[vertexIdx] = static_cast<uint32_t>(weldedVertices.size());
+            weldedVertices.push_back(mesh.vertices[vertexIdx]);
+        } else {
+            remap[vertexIdx] = remap[weldTarget[vertexIdx]];
+        }
+    }
+
+    // Drop triangles that collapsed onto a line or point
+    std::vector<glm::uvec3> weldedTriangles;
+    weldedTriangles.reserve(mesh.triangles.size());
+    for (const glm::uvec3& triangle : mesh.triangles) {
+        const glm::uvec3 welded(remap[triangle.x], remap[triangle.y], remap[triangle.z]);
+        if (welded.x != welded.y && welded.y != welded.z && welded.x != welded.z)
+            weldedTriangles.push_back(welded);
+    }
+
+    const size_t numRemoved = numVertices - weldedVertices.size();
+    mesh.vertices = std::move(weldedVertices);
+    mesh.triangles = std::move(weldedTriangles);
+    return numRemoved;
+}
+
+void meshComputeSmoothNormals(Mesh& mesh)
+{
+    // Vertex to triangle adjacency, so every vertex can gather its normal without synchronisation
+    std::vector<uint32_t> adjacencyOffsets(mesh.vertices.size() + 1, 0);
+    for (const glm::uvec3& triangle : mesh.triangles) {
+        for (int corner = 0; corner < 3; corner++)
+            adjacencyOffsets[triangle[corner] + 1]++;
+    }
+    std::partial_sum(std::begin(adjacencyOffsets), std::end(adjacencyOffsets), std::begin(adjacencyOffsets));
+    std::vector<uint32_t> adjacentTriangles(adjacencyOffsets.back());
+    {
+        std::vector<uint32_t> adjacencyFill(std::begin(adjacencyOffsets), std::end(adjacencyOffsets) - 1);
+        for (uint32_t triangleIdx = 0; triangleIdx < mesh.triangles.size(); triangleIdx++) {
+            for (int corner = 0; corner < 3; corner++)
+                adjacentTriangles[adjacencyFill[mesh.triangles[triangleIdx][corner]]++] = triangleIdx;
+        }
+    }
+
+    // The unnormalised cross product has a length of twice the triangle area, which gives the area weighting for free
+    #pragma omp parallel for
+    for (int vertexIdx = 0; vertexIdx < static_cast<int>(mesh.vertices.size()); vertexIdx++) {
+        glm::vec3 normal(0.0f);
+        for (uint32_t i = adjacencyOffsets[vertexIdx]; i < adjacencyOffsets[vertexIdx + 1]; i++) {
+            const glm::uvec3& triangle = mesh.triangles[adjacentTriangles[i]];
+            const glm::vec3& v0 = mesh.vertices[triangle.x].position;
+            const glm::vec3& v1 = mesh.vertices[triangle.y].position;
+            const glm::vec3& v2 = mesh.vertices[triangle.z].position;
+            normal += glm::cross(v1 - v0, v2 - v0);
+        }
+        // Keep the existing normal for vertices without (non-degenerate) triangles
+        if (glm::dot(normal, normal) > 0.0f)
+            mesh.vertices[vertexIdx].normal = glm::normalize(normal);
+    }
+}
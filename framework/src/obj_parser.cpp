@@ -0,0 +1,534 @@
+#include "obj_parser.h"
+#include "mapped_file.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <omp.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+constexpr size_t MIN_CHUNK_BYTES = 1ULL << 20; // Smaller chunks cost more to schedule than they save
+constexpr size_t CHUNKS_PER_THREAD = 4ULL;     // Oversubscribe so that chunks with many faces do not stall the rest
+
+// Indices of one face corner. Zero-based and -1 when absent, as in tinyobj::index_t
+struct Corner {
+    int v, vt, vn;
+};
+
+enum class StatementType {
+    UseMaterial,
+    MaterialLibrary,
+    Group
+};
+
+// Statement that affects how faces are grouped into shapes. These are rare, so they are replayed sequentially after the parallel parse
+struct Statement {
+    StatementType type;
+    std::string argument;
+    size_t numFacesBefore;          // Faces of the chunk preceding the statement
+    size_t numTrianglesBefore { 0 };// Triangles of the chunk preceding the statement, filled in after triangulation
+    int materialID { -1 };          // Material selected by a UseMaterial statement, filled in during replay
+};
+
+struct Chunk {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texCoords;
+    std::vector<Corner> corners;
+    std::vector<uint8_t> faceSizes;
+    std::vector<size_t> relativeComponents; // Negative indices, resolved against the chunk's own attributes; stored as 3 * corner + {0: v, 1: vt, 2: vn}
+    std::vector<Statement> statements;
+    bool supported { true };
+
+    // Offsets of this chunk's data in the merged output
+    size_t positionBase { 0 }, texCoordBase { 0 }, normalBase { 0 };
+    size_t faceBase { 0 }, triangleBase { 0 }, numTriangles { 0 };
+    int initialMaterialID { -1 };
+};
+
+bool isSpace(char c) { return c == ' ' || c == '\t'; }
+bool isDigit(char c) { return static_cast<unsigned int>(c - '0') < 10U; }
+
+const char* skipSpaces(const char* token, const char* end)
+{
+    while (token != end && isSpace(*token))
+        ++token;
+    return token;
+}
+
+// Equivalent of strcspn(token, " \t\r") (plus '/' for face corners) bounded by the end of the line
+const char* findTokenEnd(const char* token, const char* end, bool stopAtSlash = false)
+{
+    while (token != end && !isSpace(*token) && *token != '\r' && !(stopAtSlash && *token == '/'))
+        ++token;
+    return token;
+}
+
+// Port of tinyobjloader's tryParseDouble, so that parsed values are bit-identical to those of tinyobj::LoadObj.
+// Differs only in never reading past sEnd, which is required as the mapped file is not null-terminated.
+bool tryParseDouble(const char* s, const char* sEnd, double& result)
+{
+    if (s >= sEnd)
+        return false;
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    char sign = '+';
+    char exponentSign = '+';
+    const char* current = s;
+    int read = 0;
+    bool leadingDecimalDot = false;
+
+    if (*current == '+' || *current == '-') {
+        sign = *current;
+        current++;
+        leadingDecimalDot = current != sEnd && *current == '.';
+    } else if (*current == '.') {
+        leadingDecimalDot = true;
+    } else if (!isDigit(*current)) {
+        return false;
+    }
+
+    // Integer part
+    if (!leadingDecimalDot) {
+        while (current != sEnd && isDigit(*current)) {
+            mantissa *= 10;
+            mantissa += static_cast<int>(*current - '0');
+            current++;
+            read++;
+        }
+        if (read == 0)
+            return false;
+    }
+
+    if (current != sEnd) {
+        // Decimal part
+        bool parseExponent = true;
+        if (*current == '.') {
+            current++;
+            read = 1;
+            while (current != sEnd && isDigit(*current)) {
+                static const double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+                constexpr int lutEntries = sizeof powLut / sizeof powLut[0];
+                mantissa += static_cast<int>(*current - '0') * (read < lutEntries ? powLut[read] : std::pow(10.0, -read));
+                read++;
+                current++;
+            }
+        } else if (*current != 'e' && *current != 'E') {
+            parseExponent = false;
+        }
+
+        // Exponent part
+        if (parseExponent && current != sEnd && (*current == 'e' || *current == 'E')) {
+            current++;
+            if (current != sEnd && (*current == '+' || *current == '-')) {
+                exponentSign = *current;
+                current++;
+            } else if (current == sEnd || !isDigit(*current)) {
+                return false;
+            }
+
+            read = 0;
+            while (current != sEnd && isDigit(*current)) {
+                if (exponent > 2147483647 / 10)
+                    return false;
+                exponent *= 10;
+                exponent += static_cast<int>(*current - '0');
+                current++;
+                read++;
+            }
+            exponent *= exponentSign == '+' ? 1 : -1;
+            if (read == 0)
+                return false;
+        }
+    }
+
+    result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+    return true;
+}
+
+float parseReal(const char*& token, const char* end)
+{
+    token = skipSpaces(token, end);
+    const char* tokenEnd = findTokenEnd(token, end);
+    double value = 0.0;
+    tryParseDouble(token, tokenEnd, value);
+    token = tokenEnd;
+    return static_cast<float>(value);
+}
+
+// Equivalent of atoi() bounded by the end of the line
+int parseInt(const char* token, const char* end)
+{
+    while (token != end && std::isspace(static_cast<unsigned char>(*token)))
+        ++token;
+    bool negative = false;
+    if (token != end && (*token == '+' || *token == '-'))
+        negative = *token++ == '-';
+    int64_t value = 0;
+    while (token != end && isDigit(*token) && value <= std::numeric_limits<int>::max())
+        value = value * 10 + (*token++ - '0');
+    return static_cast<int>(negative ? -value : value);
+}
+
+// Make an OBJ index zero-based. Negative indices count back from the attributes parsed so far; as those of previous chunks
+// are not known yet, they are resolved against the chunk's own attributes and flagged for fixing up during the merge
+bool fixIndex(int index, size_t numLocalAttributes, int& out, bool& relative)
+{
+    if (index == 0)
+        return false; // Zero is not allowed according to the spec
+    relative = index < 0;
+    out = relative ? static_cast<int>(numLocalAttributes) + index : index - 1;
+    return true;
+}
+
+// Parse a v, v/vt, v//vn or v/vt/vn face corner the same way tinyobjloader does
+bool parseCorner(const char*& token, const char* end, Chunk& chunk)
+{
+    const size_t cornerIndex = chunk.corners.size();
+    Corner corner { -1, -1, -1 };
+    bool relative;
+
+    const auto parseComponent = [&](int& out, size_t numLocalAttributes, size_t component) {
+        if (!fixIndex(parseInt(token, end), numLocalAttributes, out, relative))
+            return false;
+        if (relative)
+            chunk.relativeComponents.push_back(3 * cornerIndex + component);
+        token = findTokenEnd(token, end, true);
+        return true;
+    };
+
+    if (!parseComponent(corner.v, chunk.positions.size() / 3, 0))
+        return false;
+    if (token != end && *token == '/') {
+        token++;
+        if (token != end && *token == '/') {
+            // i//k
+            token++;
+            if (!parseComponent(corner.vn, chunk.normals.size() / 3, 2))
+                return false;
+        } else {
+            // i/j/k or i/j
+            if (!parseComponent(corner.vt, chunk.texCoords.size() / 2, 1))
+                return false;
+            if (token != end && *token == '/') {
+                token++;
+                if (!parseComponent(corner.vn, chunk.normals.size() / 3, 2))
+                    return false;
+            }
+        }
+    }
+
+    chunk.corners.push_back(corner);
+    return true;
+}
+
+void parseLine(const char* token, const char* end, Chunk& chunk)
+{
+    token = skipSpaces(token, end);
+    if (token == end || *token == '#')
+        return;
+
+    const std::string_view line(token, end);
+    const auto spaceAt = [&](size_t position) { return line.size() > position && isSpace(line[position]); };
+
+    if (line[0] == 'v' && spaceAt(1)) {
+        token += 2;
+        for (int i = 0; i < 3; i++)
+            chunk.positions.push_back(parseReal(token, end));
+    } else if (line.starts_with("vn") && spaceAt(2)) {
+        token += 3;
+        for (int i = 0; i < 3; i++)
+            chunk.normals.push_back(parseReal(token, end));
+    } else if (line.starts_with("vt") && spaceAt(2)) {
+        token += 3;
+        for (int i = 0; i < 2; i++)
+            chunk.texCoords.push_back(parseReal(token, end));
+    } else if ((line[0] == 'l' || line[0] == 'p') && spaceAt(1)) {
+        chunk.supported = false;
+    } else if (line[0] == 'f' && spaceAt(1)) {
+        token = skipSpaces(token + 2, end);
+        size_t numCorners = 0;
+        while (token != end) {
+            if (!parseCorner(token, end, chunk)) {
+                chunk.supported = false;
+                return;
+            }
+            numCorners++;
+            while (token != end && (isSpace(*token) || *token == '\r'))
+                ++token;
+        }
+        // Polygons with more corners are ear-clipped by tinyobjloader, which this parser does not replicate
+        if (numCorners > 4)
+            chunk.supported = false;
+        chunk.faceSizes.push_back(static_cast<uint8_t>(std::min(numCorners, size_t(255))));
+    } else if (line.starts_with("usemtl")) {
+        token += 6;
+        token = skipSpaces(token, end);
+        chunk.statements.push_back({ .type = StatementType::UseMaterial, .argument = std::string(token, findTokenEnd(token, end)), .numFacesBefore = chunk.faceSizes.size() });
+    } else if (line.starts_with("mtllib") && spaceAt(6)) {
+        chunk.statements.push_back({ .type = StatementType::MaterialLibrary, .argument = std::string(line.substr(7)), .numFacesBefore = chunk.faceSizes.size() });
+    } else if ((line[0] == 'g' || line[0] == 'o') && spaceAt(1)) {
+        chunk.statements.push_back({ .type = StatementType::Group, .argument = {}, .numFacesBefore = chunk.faceSizes.size() });
+    }
+}
+
+void parseChunk(const char* begin, const char* end, Chunk& chunk)
+{
+    // Rough reservation based on typical record lengths, which avoids most reallocations for large files
+    const size_t numBytes = static_cast<size_t>(end - begin);
+    chunk.positions.reserve(numBytes / 16);
+    chunk.corners.reserve(numBytes / 12);
+    chunk.faceSizes.reserve(numBytes / 32);
+
+    while (begin != end && chunk.supported) {
+        const char* lineEnd = std::find_if(begin, end, [](char c) { return c == '\n' || c == '\r'; });
+        parseLine(begin, lineEnd, chunk);
+        begin = lineEnd == end ? end : lineEnd + 1;
+    }
+}
+
+// Split at line boundaries into roughly equally sized chunks
+std::vector<std::pair<const char*, const char*>> splitIntoChunks(const char* begin, const char* end)
+{
+    const size_t numBytes = static_cast<size_t>(end - begin);
+    const size_t numChunks = std::clamp(numBytes / MIN_CHUNK_BYTES, size_t(1), static_cast<size_t>(omp_get_max_threads()) * CHUNKS_PER_THREAD);
+
+    std::vector<std::pair<const char*, const char*>> chunks;
+    const char* chunkBegin = begin;
+    for (size_t i = 1; i <= numChunks && chunkBegin != end; i++) {
+        const char* chunkEnd = i == numChunks ? end : std::max(chunkBegin, begin + i * (numBytes / numChunks));
+        chunkEnd = std::find(chunkEnd, end, '\n');
+        if (chunkEnd != end)
+            ++chunkEnd;
+        chunks.emplace_back(chunkBegin, chunkEnd);
+        chunkBegin = chunkEnd;
+    }
+    return chunks;
+}
+
+// Split an mtllib statement into file names like tinyobjloader: space-separated, with '\' escaping the next character
+std::vector<std::string> splitFileNames(const std::string& arguments)
+{
+    std::vector<std::string> fileNames;
+    std::string fileName;
+    bool escaping = false;
+    for (char c : arguments) {
+        if (escaping) {
+            escaping = false;
+        } else if (c == '\\') {
+            escaping = true;
+            continue;
+        } else if (c == ' ') {
+            if (!fileName.empty())
+                fileNames.push_back(fileName);
+            fileName.clear();
+            continue;
+        }
+        fileName += c;
+    }
+    fileNames.push_back(fileName);
+    return fileNames;
+}
+
+// Number of triangles tinyobjloader produces for a face: quads referencing missing vertices and faces with fewer than three corners are dropped
+size_t numTrianglesOfFace(const Corner* corners, uint8_t numCorners, size_t numPositions)
+{
+    if (numCorners == 3)
+        return 1;
+    if (numCorners != 4)
+        return 0;
+    for (int i = 0; i < 4; i++) {
+        if (static_cast<size_t>(corners[i].v) >= numPositions)
+            return 0;
+    }
+    return 2;
+}
+
+tinyobj::index_t toIndex(const Corner& corner)
+{
+    return { .vertex_index = corner.v, .normal_index = corner.vn, .texcoord_index = corner.vt };
+}
+
+}
+
+std::optional<ObjData> parseObjParallel(const std::filesystem::path& file, const std::filesystem::path& materialBaseDir)
+{
+    const MappedFile mapping(file);
+    const char* fileBegin = reinterpret_cast<const char*>(mapping.bytes().data());
+    const auto chunkRanges = splitIntoChunks(fileBegin, fileBegin + mapping.size());
+
+    // Parse all chunks concurrently into their own buffers
+    std::vector<Chunk> chunks(chunkRanges.size());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int chunkIdx = 0; chunkIdx < static_cast<int>(chunks.size()); chunkIdx++)
+        parseChunk(chunkRanges[chunkIdx].first, chunkRanges[chunkIdx].second, chunks[chunkIdx]);
+    if (std::any_of(std::begin(chunks), std::end(chunks), [](const Chunk& chunk) { return !chunk.supported; }))
+        return std::nullopt;
+
+    // Offsets of every chunk in the merged attribute arrays
+    size_t numPositionValues = 0, numNormalValues = 0, numTexCoordValues = 0, numFaces = 0;
+    for (Chunk& chunk : chunks) {
+        chunk.positionBase  = numPositionValues / 3;
+        chunk.normalBase    = numNormalValues / 3;
+        chunk.texCoordBase  = numTexCoordValues / 2;
+        chunk.faceBase      = numFaces;
+        numPositionValues   += chunk.positions.size();
+        numNormalValues     += chunk.normals.size();
+        numTexCoordValues   += chunk.texCoords.size();
+        numFaces            += chunk.faceSizes.size();
+    }
+
+    // Merge attributes, resolve relative indices and count the triangles of each chunk
+    ObjData out;
+    out.attrib.vertices.resize(numPositionValues);
+    out.attrib.normals.resize(numNormalValues);
+    out.attrib.texcoords.resize(numTexCoordValues);
+    const size_t numPositions = numPositionValues / 3;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int chunkIdx = 0; chunkIdx < static_cast<int>(chunks.size()); chunkIdx++) {
+        Chunk& chunk = chunks[chunkIdx];
+        std::copy(std::begin(chunk.positions), std::end(chunk.positions), std::begin(out.attrib.vertices) + 3 * chunk.positionBase);
+        std::copy(std::begin(chunk.normals), std::end(chunk.normals), std::begin(out.attrib.normals) + 3 * chunk.normalBase);
+        std::copy(std::begin(chunk.texCoords), std::end(chunk.texCoords), std::begin(out.attrib.texcoords) + 2 * chunk.texCoordBase);
+        chunk.positions     = {};
+        chunk.normals       = {};
+        chunk.texCoords     = {};
+
+        const int bases[3] = { static_cast<int>(chunk.positionBase), static_cast<int>(chunk.texCoordBase), static_cast<int>(chunk.normalBase) };
+        for (size_t component : chunk.relativeComponents) {
+            Corner& corner = chunk.corners[component / 3];
+            int& index = component % 3 == 0 ? corner.v : (component % 3 == 1 ? corner.vt : corner.vn);
+            index += bases[component % 3];
+        }
+
+        const Corner* corners = chunk.corners.data();
+        auto statement = std::begin(chunk.statements);
+        for (size_t faceIdx = 0; faceIdx < chunk.faceSizes.size(); faceIdx++) {
+            for (; statement != std::end(chunk.statements) && statement->numFacesBefore == faceIdx; ++statement)
+                statement->numTrianglesBefore = chunk.numTriangles;
+            chunk.numTriangles += numTrianglesOfFace(corners, chunk.faceSizes[faceIdx], numPositions);
+            corners += chunk.faceSizes[faceIdx];
+        }
+        for (; statement != std::end(chunk.statements); ++statement)
+            statement->numTrianglesBefore = chunk.numTriangles;
+    }
+
+    // Replay material and group statements in file order to find the shape boundaries and resolve materials
+    std::string baseDir = materialBaseDir.string();
+    if (!baseDir.empty() && baseDir.back() != std::filesystem::path::preferred_separator)
+        baseDir += static_cast<char>(std::filesystem::path::preferred_separator);
+    tinyobj::MaterialFileReader materialReader(baseDir);
+    std::map<std::string, int> materialMap;
+    std::vector<std::pair<size_t, size_t>> shapeRanges; // [first, last) triangles of each shape
+    int materialID = -1;
+    size_t numTriangles = 0, shapeBegin = 0, lastExportedFace = 0;
+    for (Chunk& chunk : chunks) {
+        chunk.triangleBase      = numTriangles;
+        chunk.initialMaterialID = materialID;
+        for (Statement& statement : chunk.statements) {
+            const size_t face       = chunk.faceBase + statement.numFacesBefore;
+            const size_t triangle   = chunk.triangleBase + statement.numTrianglesBefore;
+            if (statement.type == StatementType::UseMaterial) {
+                const auto material = materialMap.find(statement.argument);
+                statement.materialID = material == std::end(materialMap) ? -1 : material->second;
+                if (statement.materialID != materialID) {
+                    lastExportedFace = face;
+                    materialID = statement.materialID;
+                }
+            } else if (statement.type == StatementType::MaterialLibrary) {
+                for (const std::string& fileName : splitFileNames(statement.argument)) {
+                    std::string warning, error;
+                    if (materialReader(fileName, &out.materials, &materialMap, &warning, &error))
+                        break;
+                }
+            } else {
+                // A new group or object only starts a new shape if the current one received triangles
+                if (triangle > shapeBegin)
+                    shapeRanges.emplace_back(shapeBegin, triangle);
+                shapeBegin = triangle;
+                lastExportedFace = face;
+            }
+        }
+        numTriangles += chunk.numTriangles;
+    }
+    if (numFaces > lastExportedFace || numTriangles > shapeBegin)
+        shapeRanges.emplace_back(shapeBegin, numTriangles);
+
+    std::vector<size_t> shapeBegins;
+    for (const auto& [first, last] : shapeRanges) {
+        tinyobj::shape_t& shape = out.shapes.emplace_back();
+        shape.mesh.indices.resize(3 * (last - first));
+        shape.mesh.material_ids.resize(last - first);
+        shape.mesh.num_face_vertices.assign(last - first, 3);
+        shapeBegins.push_back(first);
+    }
+
+    // Triangulate every chunk straight into the shapes it overlaps
+    const std::vector<float>& positions = out.attrib.vertices;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int chunkIdx = 0; chunkIdx < static_cast<int>(chunks.size()); chunkIdx++) {
+        const Chunk& chunk = chunks[chunkIdx];
+        if (chunk.numTriangles == 0)
+            continue;
+
+        size_t shapeIdx = static_cast<size_t>(std::upper_bound(std::begin(shapeBegins), std::end(shapeBegins), chunk.triangleBase) - std::begin(shapeBegins)) - 1;
+        size_t triangle = chunk.triangleBase;
+        const auto emit = [&](const Corner& c0, const Corner& c1, const Corner& c2, int material) {
+            while (shapeIdx + 1 < shapeBegins.size() && triangle >= shapeBegins[shapeIdx + 1])
+                ++shapeIdx;
+            tinyobj::mesh_t& mesh = out.shapes[shapeIdx].mesh;
+            const size_t local = triangle++ - shapeBegins[shapeIdx];
+            mesh.indices[3 * local + 0] = toIndex(c0);
+            mesh.indices[3 * local + 1] = toIndex(c1);
+            mesh.indices[3 * local + 2] = toIndex(c2);
+            mesh.material_ids[local]    = material;
+        };
+
+        int material = chunk.initialMaterialID;
+        const Corner* corners = chunk.corners.data();
+        auto statement = std::begin(chunk.statements);
+        for (size_t faceIdx = 0; faceIdx < chunk.faceSizes.size(); faceIdx++) {
+            for (; statement != std::end(chunk.statements) && statement->numFacesBefore == faceIdx; ++statement) {
+                if (statement->type == StatementType::UseMaterial)
+                    material = statement->materialID;
+            }
+
+            const uint8_t numCorners = chunk.faceSizes[faceIdx];
+            const size_t numFaceTriangles = numTrianglesOfFace(corners, numCorners, numPositions);
+            if (numFaceTriangles == 1) {
+                emit(corners[0], corners[1], corners[2], material);
+            } else if (numFaceTriangles == 2) {
+                // Split along the shorter diagonal, computed in single precision exactly like tinyobjloader
+                const auto position = [&](int cornerIdx, int axis) { return positions[3 * static_cast<size_t>(corners[cornerIdx].v) + axis]; };
+                float squaredLength02 = 0.0f, squaredLength13 = 0.0f;
+                for (int axis = 0; axis < 3; axis++) {
+                    const float edge02 = position(2, axis) - position(0, axis);
+                    const float edge13 = position(3, axis) - position(1, axis);
+                    squaredLength02 += edge02 * edge02;
+                    squaredLength13 += edge13 * edge13;
+                }
+                if (squaredLength02 < squaredLength13) {
+                    emit(corners[0], corners[1], corners[2], material);
+                    emit(corners[0], corners[2], corners[3], material);
+                } else {
+                    emit(corners[0], corners[1], corners[3], material);
+                    emit(corners[1], corners[2], corners[3], material);
+                }
+            }
+            corners += numCorners;
+        }
+    }
+
+    return out;
+}
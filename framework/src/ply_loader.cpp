@@ -0,0 +1,336 @@
+#include "mesh.h"
+#include "mapped_file.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <omp.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+enum class PlyType {
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64
+};
+
+struct PlyProperty {
+    std::string name;
+    PlyType type;                           // Type of the value, or of the list items for list properties
+    std::optional<PlyType> listCountType;   // Only set for list properties
+    size_t offset { 0 };                    // Byte offset within the element, valid for elements without list properties
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count;
+    std::vector<PlyProperty> properties;
+    size_t stride { 0 };                    // Bytes per element, zero if it has list properties and is variable-sized
+
+    const PlyProperty* find(std::initializer_list<std::string_view> names) const
+    {
+        for (const PlyProperty& property : properties) {
+            if (std::find(std::begin(names), std::end(names), property.name) != std::end(names))
+                return &property;
+        }
+        return nullptr;
+    }
+};
+
+[[noreturn]] void fail(const std::filesystem::path& file, std::string_view message)
+{
+    std::cerr << "Failed to load PLY file " << file << ": " << message << std::endl;
+    throw std::exception();
+}
+
+std::optional<PlyType> parseType(std::string_view name)
+{
+    if (name == "char" || name == "int8")       return PlyType::Int8;
+    if (name == "uchar" || name == "uint8")     return PlyType::UInt8;
+    if (name == "short" || name == "int16")     return PlyType::Int16;
+    if (name == "ushort" || name == "uint16")   return PlyType::UInt16;
+    if (name == "int" || name == "int32")       return PlyType::Int32;
+    if (name == "uint" || name == "uint32")     return PlyType::UInt32;
+    if (name == "float" || name == "float32")   return PlyType::Float32;
+    if (name == "double" || name == "float64")  return PlyType::Float64;
+    return std::nullopt;
+}
+
+size_t typeSize(PlyType type)
+{
+    switch (type) {
+    case PlyType::Int8:
+    case PlyType::UInt8:
+        return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16:
+        return 2;
+    case PlyType::Int32:
+    case PlyType::UInt32:
+    case PlyType::Float32:
+        return 4;
+    default:
+        return 8;
+    }
+}
+
+// Read a value of the given size, swapping its bytes if the file endianness differs from ours
+template <typename Stored>
+Stored readRaw(const std::byte* data, bool swapBytes)
+{
+    std::array<std::byte, sizeof(Stored)> bytes;
+    std::memcpy(bytes.data(), data, sizeof(Stored));
+    if (swapBytes)
+        std::reverse(std::begin(bytes), std::end(bytes));
+    return std::bit_cast<Stored>(bytes);
+}
+
+template <typename T>
+T readAs(const std::byte* data, PlyType type, bool swapBytes)
+{
+    switch (type) {
+    case PlyType::Int8:     return static_cast<T>(readRaw<int8_t>(data, swapBytes));
+    case PlyType::UInt8:    return static_cast<T>(readRaw<uint8_t>(data, swapBytes));
+    case PlyType::Int16:    return static_cast<T>(readRaw<int16_t>(data, swapBytes));
+    case PlyType::UInt16:   return static_cast<T>(readRaw<uint16_t>(data, swapBytes));
+    case PlyType::Int32:    return static_cast<T>(readRaw<int32_t>(data, swapBytes));
+    case PlyType::UInt32:   return static_cast<T>(readRaw<uint32_t>(data, swapBytes));
+    case PlyType::Float32:  return static_cast<T>(readRaw<float>(data, swapBytes));
+    default:                return static_cast<T>(readRaw<double>(data, swapBytes));
+    }
+}
+
+// Parse the next whitespace-separated value of an ASCII payload
+template <typename T>
+T readAscii(const std::filesystem::path& file, const char*& cursor, const char* end)
+{
+    const auto isSpace = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    cursor = std::find_if_not(cursor, end, isSpace);
+    const char* tokenEnd = std::find_if(cursor, end, isSpace);
+    T value {};
+    const auto [parsedEnd, error] = std::from_chars(cursor, tokenEnd, value);
+    if (cursor == tokenEnd || error != std::errc() || parsedEnd != tokenEnd)
+        fail(file, "invalid or missing value");
+    cursor = tokenEnd;
+    return value;
+}
+
+}
+
+std::vector<Mesh> loadPLY(const std::filesystem::path& file)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const MappedFile mapping(file);
+    const std::byte* data = mapping.bytes().data();
+    const std::byte* end = data + mapping.size();
+
+    // The header is plain text terminated by an end_header line, directly followed by the payload
+    const std::string_view text(reinterpret_cast<const char*>(data), mapping.size());
+    constexpr std::string_view endHeader = "end_header";
+    size_t headerEnd = text.find(endHeader);
+    if (!text.starts_with("ply") || headerEnd == std::string_view::npos)
+        fail(file, "missing PLY header");
+    headerEnd = text.find('\n', headerEnd);
+    if (headerEnd == std::string_view::npos)
+        fail(file, "truncated header");
+
+    bool ascii = false, swapBytes = false;
+    std::vector<PlyElement> elements;
+    std::istringstream header(std::string(text.substr(0, headerEnd)));
+    std::string line;
+    while (std::getline(header, line)) {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            tokens >> format;
+            if (format == "ascii")
+                ascii = true;
+            else if (format == "binary_little_endian")
+                swapBytes = std::endian::native != std::endian::little;
+            else if (format == "binary_big_endian")
+                swapBytes = std::endian::native != std::endian::big;
+            else
+                fail(file, "unknown format " + format);
+        } else if (keyword == "element") {
+            PlyElement& element = elements.emplace_back();
+            tokens >> element.name >> element.count;
+        } else if (keyword == "property") {
+            if (elements.empty())
+                fail(file, "property outside of an element");
+            PlyProperty property;
+            std::string typeName;
+            tokens >> typeName;
+            if (typeName == "list") {
+                std::string countTypeName;
+                tokens >> countTypeName >> typeName;
+                property.listCountType = parseType(countTypeName);
+                if (!property.listCountType)
+                    fail(file, "unknown property type " + countTypeName);
+            }
+            const auto type = parseType(typeName);
+            if (!type)
+                fail(file, "unknown property type " + typeName);
+            property.type = *type;
+            tokens >> property.name;
+            elements.back().properties.push_back(property);
+        }
+    }
+    for (PlyElement& element : elements) {
+        size_t offset = 0;
+        for (PlyProperty& property : element.properties) {
+            property.offset = offset;
+            offset += typeSize(property.type);
+        }
+        const bool hasLists = std::any_of(std::begin(element.properties), std::end(element.properties), [](const PlyProperty& property) { return property.listCountType.has_value(); });
+        element.stride = hasLists ? 0 : offset;
+    }
+
+    const auto vertexElement = std::find_if(std::begin(elements), std::end(elements), [](const PlyElement& element) { return element.name == "vertex"; });
+    if (vertexElement == std::end(elements))
+        fail(file, "no vertex element");
+    const size_t numVertices = vertexElement->count;
+    const PlyProperty* position[3] = { vertexElement->find({ "x" }), vertexElement->find({ "y" }), vertexElement->find({ "z" }) };
+    const PlyProperty* normal[3] = { vertexElement->find({ "nx" }), vertexElement->find({ "ny" }), vertexElement->find({ "nz" }) };
+    const PlyProperty* texCoord[2] = { vertexElement->find({ "u", "s", "texture_u" }), vertexElement->find({ "v", "t", "texture_v" }) };
+    if (!position[0] || !position[1] || !position[2])
+        fail(file, "vertices have no position");
+    const bool hasNormals = normal[0] && normal[1] && normal[2];
+    const bool hasTexCoords = texCoord[0] && texCoord[1];
+
+    Mesh mesh;
+    mesh.vertices.resize(numVertices);
+    const auto addPolygon = [&](size_t numCorners, const auto& readIndex) {
+        // Polygons are fan-triangulated
+        uint32_t first = 0, previous = 0;
+        for (size_t i = 0; i < numCorners; i++) {
+            const uint32_t index = readIndex(i);
+            if (index >= numVertices)
+                fail(file, "face references a missing vertex");
+            if (i == 0)
+                first = index;
+            else if (i >= 2)
+                mesh.triangles.emplace_back(first, previous, index);
+            previous = index;
+        }
+    };
+
+    const std::byte* cursor = data + headerEnd + 1;
+    if (ascii) {
+        // Whitespace-separated values, which have to be read one after the other
+        const char* textCursor = reinterpret_cast<const char*>(cursor);
+        const char* textEnd = reinterpret_cast<const char*>(end);
+        for (const PlyElement& element : elements) {
+            const bool isVertex = &element == &*vertexElement;
+            const PlyProperty* indices = element.name == "face" ? element.find({ "vertex_indices", "vertex_index" }) : nullptr;
+            for (size_t elementIdx = 0; elementIdx < element.count; elementIdx++) {
+                for (const PlyProperty& property : element.properties) {
+                    const size_t numItems = property.listCountType ? readAscii<size_t>(file, textCursor, textEnd) : 1;
+                    if (&property == indices) {
+                        addPolygon(numItems, [&](size_t) { return readAscii<uint32_t>(file, textCursor, textEnd); });
+                        continue;
+                    }
+                    for (size_t i = 0; i < numItems; i++) {
+                        const float value = readAscii<float>(file, textCursor, textEnd);
+                        if (!isVertex)
+                            continue;
+                        Vertex& vertex = mesh.vertices[elementIdx];
+                        for (int axis = 0; axis < 3; axis++) {
+                            if (&property == position[axis])
+                                vertex.position[axis] = value;
+                            else if (hasNormals && &property == normal[axis])
+                                vertex.normal[axis] = value;
+                        }
+                        for (int axis = 0; axis < 2; axis++) {
+                            if (hasTexCoords && &property == texCoord[axis])
+                                vertex.texCoord[axis] = value;
+                        }
+                    }
+                }
+            }
+        }
+    } else {
+        for (const PlyElement& element : elements) {
+            if (element.name == "vertex") {
+                // Fixed-size vertices are decoded straight from the mapping, in parallel
+                if (element.stride == 0)
+                    fail(file, "list properties on vertices are not supported");
+                if (static_cast<size_t>(end - cursor) / element.stride < element.count)
+                    fail(file, "truncated vertex data");
+
+                #pragma omp parallel for
+                for (int vertexIdx = 0; vertexIdx < static_cast<int>(element.count); vertexIdx++) {
+                    const std::byte* vertexData = cursor + static_cast<size_t>(vertexIdx) * element.stride;
+                    Vertex& vertex = mesh.vertices[vertexIdx];
+                    for (int axis = 0; axis < 3; axis++) {
+                        vertex.position[axis] = readAs<float>(vertexData + position[axis]->offset, position[axis]->type, swapBytes);
+                        vertex.normal[axis] = hasNormals ? readAs<float>(vertexData + normal[axis]->offset, normal[axis]->type, swapBytes) : 0.0f;
+                    }
+                    for (int axis = 0; axis < 2; axis++)
+                        vertex.texCoord[axis] = hasTexCoords ? readAs<float>(vertexData + texCoord[axis]->offset, texCoord[axis]->type, swapBytes) : 0.0f;
+                }
+                cursor += element.count * element.stride;
+            } else if (element.stride != 0 && element.name != "face") {
+                // Skip unused fixed-size elements in one go
+                if (static_cast<size_t>(end - cursor) / element.stride < element.count)
+                    fail(file, "truncated element " + element.name);
+                cursor += element.count * element.stride;
+            } else {
+                // Elements with lists have to be walked one by one
+                const PlyProperty* indices = element.name == "face" ? element.find({ "vertex_indices", "vertex_index" }) : nullptr;
+                if (indices)
+                    mesh.triangles.reserve(element.count);
+                for (size_t elementIdx = 0; elementIdx < element.count; elementIdx++) {
+                    for (const PlyProperty& property : element.properties) {
+                        size_t numItems = 1;
+                        if (property.listCountType) {
+                            if (static_cast<size_t>(end - cursor) < typeSize(*property.listCountType))
+                                fail(file, "truncated element " + element.name);
+                            numItems = readAs<size_t>(cursor, *property.listCountType, swapBytes);
+                            cursor += typeSize(*property.listCountType);
+                        }
+                        const size_t itemSize = typeSize(property.type);
+                        if (static_cast<size_t>(end - cursor) / itemSize < numItems)
+                            fail(file, "truncated element " + element.name);
+
+                        if (&property == indices)
+                            addPolygon(numItems, [&](size_t i) { return readAs<uint32_t>(cursor + i * itemSize, property.type, swapBytes); });
+                        cursor += numItems * itemSize;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!hasNormals)
+        meshComputeSmoothNormals(mesh);
+
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Loaded " << file.filename() << " (" << mesh.vertices.size() << " vertices, " << mesh.triangles.size() << " triangles) in " << milliseconds << " ms" << std::endl;
+
+    std::vector<Mesh> out;
+    out.push_back(std::move(mesh));
+    return out;
+}
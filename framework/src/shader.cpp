@@ -1,4 +1,5 @@
 #include "shader.h"
+#include "gl_state.h"
 
 #include <cassert>
 #include <fstream>
@@ -8,10 +9,12 @@
 #include <string>
 
 static constexpr GLuint invalid = 0xFFFFFFFF;
+static constexpr int maxIncludeDepth = 8;
 
 static bool checkShaderErrors(GLuint shader);
 static bool checkProgramErrors(GLuint program);
 static std::string readFile(std::filesystem::path filePath);
+static std::string resolveIncludes(const std::string& source, const std::filesystem::path& filePath, int sourceNumber, int& lastSourceNumber, int depth);
 
 Shader::Shader(GLuint program)
     : m_program(program)
@@ -26,6 +29,7 @@ Shader::Shader()
 Shader::Shader(Shader&& other)
 {
     m_program = other.m_program;
+    m_uniformBlockBindings = std::move(other.m_uniformBlockBindings);
     other.m_program = invalid;
 }
 
@@ -41,6 +45,7 @@ Shader& Shader::operator=(Shader&& other)
         glDeleteProgram(m_program);
 
     m_program = other.m_program;
+    m_uniformBlockBindings = std::move(other.m_uniformBlockBindings);
     other.m_program = invalid;
     return *this;
 }
@@ -48,13 +53,20 @@ Shader& Shader::operator=(Shader&& other)
 void Shader::bind() const
 {
     assert(m_program != invalid);
-    glUseProgram(m_program);
+    gl_state::useProgram(m_program);
 }
 
 void Shader::bindUniformBlock(const std::string& blockName, GLuint bindingLocation) const
 {
+    auto [iter, inserted] = m_uniformBlockBindings.try_emplace(blockName, GL_INVALID_INDEX);
+    if (!inserted && (iter->second == bindingLocation || iter->second == GL_INVALID_INDEX))
+        return;
+
     GLuint blockIdx = glGetUniformBlockIndex(m_program, blockName.data());
-    if (blockIdx != GL_INVALID_INDEX) { glUniformBlockBinding(m_program, blockIdx, bindingLocation); }
+    if (blockIdx != GL_INVALID_INDEX) {
+        glUniformBlockBinding(m_program, blockIdx, bindingLocation);
+        iter->second = bindingLocation;
+    }
 }
 
 ShaderBuilder::~ShaderBuilder()
@@ -68,7 +80,8 @@ ShaderBuilder& ShaderBuilder::addStage(GLuint shaderStage, std::filesystem::path
         throw ShaderLoadingException(std::format("File {} does not exist", shaderFile.string()));
     }
 
-    const std::string shaderSource = readFile(shaderFile);
+    int lastSourceNumber = 0;
+    const std::string shaderSource = resolveIncludes(readFile(shaderFile), shaderFile, 0, lastSourceNumber, 0);
     const GLuint shader = glCreateShader(shaderStage);
     const char* shaderSourcePtr = shaderSource.c_str();
     glShaderSource(shader, 1, &shaderSourcePtr, nullptr);
@@ -113,6 +126,41 @@ static std::string readFile(std::filesystem::path filePath)
     return buffer.str();
 }
 
+// Replace every line of the form #include "file" with the contents of that file, found relative to the including one.
+// Each included file gets a source string number of its own and #line directives keep compile errors pointing at the right line.
+static std::string resolveIncludes(const std::string& source, const std::filesystem::path& filePath, int sourceNumber, int& lastSourceNumber, int depth)
+{
+    if (depth > maxIncludeDepth)
+        throw ShaderLoadingException(std::format("Includes nested too deeply in {}", filePath.string()));
+
+    std::istringstream lines(source);
+    std::ostringstream out;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        const size_t directive = line.find_first_not_of(" \t");
+        if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0) {
+            out << line << '\n';
+            continue;
+        }
+
+        const size_t nameBegin = line.find('"', directive + 8);
+        const size_t nameEnd = nameBegin == std::string::npos ? nameBegin : line.find('"', nameBegin + 1);
+        if (nameEnd == std::string::npos)
+            throw ShaderLoadingException(std::format("Malformed #include in {} at line {}", filePath.string(), lineNumber));
+        const std::filesystem::path includeFile = filePath.parent_path() / line.substr(nameBegin + 1, nameEnd - nameBegin - 1);
+        if (!std::filesystem::exists(includeFile))
+            throw ShaderLoadingException(std::format("File {} included by {} does not exist", includeFile.string(), filePath.string()));
+
+        const int includeNumber = ++lastSourceNumber;
+        out << "#line 1 " << includeNumber << '\n'
+            << resolveIncludes(readFile(includeFile), includeFile, includeNumber, lastSourceNumber, depth + 1)
+            << "#line " << lineNumber + 1 << ' ' << sourceNumber << '\n';
+    }
+    return out.str();
+}
+
 static bool checkShaderErrors(GLuint shader)
 {
     // Check if the shader compiled successfully.
@@ -179,6 +179,11 @@ bool Window::shouldClose()
     return glfwWindowShouldClose(m_pWindow) != 0;
 }
 
+void Window::waitForInput()
+{
+    glfwWaitEvents();
+}
+
 void Window::updateInput()
 {
     glfwPollEvents();
@@ -0,0 +1,24 @@
+#version 460
+
+// Compact G-buffer texture to render to screen (see write-geometric.frag)
+layout(location = 0) uniform usampler2D compactSampler;
+layout(location = 1) uniform int gbufferLayout;     // GBufferLayout; either of the compact ones
+layout(location = 2) uniform bool showDistance;     // Show d_N rather than the normal
+
+// Screen-space coordinates
+layout(location = 0) in vec2 bufferCoords;
+
+// Output for on-screen color
+layout(location = 0) out vec4 outColor;
+
+#include "gbuffer.glsl"
+
+void main() {
+    uvec2 texel = texture(compactSampler, bufferCoords).xy;
+    if (showDistance) {
+        outColor = vec4(decodeCompactDistance(texel));
+    } else {
+        // Pixels the model does not cover decode to a zero normal, and show up black
+        outColor = vec4(decodeCompactNormal(texel.x), 1.0);
+    }
+}
@@ -0,0 +1,38 @@
+// G-buffer decoding shared by every pass that reads it (see ShaderBuilder for #include).
+// Expects gbufferLayout (see GBufferLayout) to be declared before it is included.
+
+const int GBUFFER_STANDARD  = 0;
+const int GBUFFER_COMPACT   = 1;
+
+// Packed normals are snorms, which never use the most negative integer. Uncovered pixels of the compact layouts are
+// cleared to it (see COMPACT_CLEAR in refraction.cpp) and read as a zero normal, like in the standard layout
+const uint COMPACT_CLEAR_NORMAL     = 0x80008000u;
+const uint COMPACT_LOW_CLEAR_NORMAL = 0x8080u;
+
+// Inverse of the octahedral mapping in write-geometric.frag
+vec3 octahedralDecode(vec2 projected) {
+    vec3 normal = vec3(projected, 1.0 - abs(projected.x) - abs(projected.y));
+    if (normal.z < 0.0) { normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0); }
+    return normalize(normal);
+}
+
+// Normal in the first channel of either compact layout
+vec3 decodeCompactNormal(uint packedNormal) {
+    if (gbufferLayout == GBUFFER_COMPACT) { return packedNormal == COMPACT_CLEAR_NORMAL ? vec3(0.0) : octahedralDecode(unpackSnorm2x16(packedNormal)); }
+    return (packedNormal & 0xFFFFu) == COMPACT_LOW_CLEAR_NORMAL ? vec3(0.0) : octahedralDecode(unpackSnorm4x8(packedNormal).xy);
+}
+
+// d_N in either compact layout
+float decodeCompactDistance(uvec2 texel) {
+    return gbufferLayout == GBUFFER_COMPACT ? uintBitsToFloat(texel.y) : unpackHalf2x16(texel.x >> 16).x;
+}
+
+vec3 readNormal(sampler2D normals, usampler2D compact, vec2 texCoords) {
+    if (gbufferLayout == GBUFFER_STANDARD)  { return texture(normals, texCoords).xyz; }
+    return decodeCompactNormal(texture(compact, texCoords).x);
+}
+
+float readDistanceInner(sampler2D distances, usampler2D compact, vec2 texCoords) {
+    if (gbufferLayout == GBUFFER_STANDARD)  { return texture(distances, texCoords).x; }
+    return decodeCompactDistance(texture(compact, texCoords).xy);
+}
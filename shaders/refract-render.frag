@@ -1,66 +1,123 @@
 #version 460
 
-// Transformation matrices
-layout(location = 0) uniform mat4 mvp;      // Full MVP matrix
-layout(location = 1) uniform mat4 model;    // Model matrix only
+// Per-frame constants, shared by every pass (see FrameUniforms in refraction.cpp)
+layout(std140) uniform Frame {
+    mat4 viewProjection;            // View and projection matrices; each instance has its own model matrix
+    mat4 inverseViewProjection;     // Maps NDC back to world space
+    mat4 previousViewProjection;    // View projection matrix of the previous frame
+    vec3 cameraPosition;
+    float nearPlaneDist;
+    float farPlaneDist;
+    int gbufferLayout;              // See GBufferLayout. Compact layouts keep the normal and d_N of a layer in a single texture
+    int dispersion;                 // See Dispersion. Other than none, red, green and blue are refracted with ratios of their own
+    float dispersionSpread;         // Difference between the refractive index ratios of blue and red light
+};
+
+// Transform and material of every instance of the mesh (see GPUInstance in instances.h)
+struct Instance {
+    mat4 model;                 // Model matrix only
+    mat4 normalModel;           // Upper 3x3 transforms normals, which should be transformed differently than positions (https://paroj.github.io/gltut/Illumination/Tut09%20Normal%20Transformation.html)
+    vec3 transparency;
+    float refractiveIndexRatio;
+};
+layout(std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
 
 // Textures
 layout(location = 2) uniform sampler2D frontDepth;
-layout(location = 3) uniform sampler2D backDepth;
+layout(location = 3) uniform sampler2D backDepth; // Stores 1 - depth (see write-geometric.vert)
 layout(location = 4) uniform sampler2D frontNormals;
 layout(location = 5) uniform sampler2D backNormals;
 layout(location = 6) uniform sampler2D innerDistance;
 layout(location = 7) uniform samplerCube environmentMap;
-
-// Miscellaneous
-layout(location = 8) uniform vec3 cameraPosition;
-layout(location = 9) uniform float refractiveIndexRatio;
-layout(location = 10) uniform float nearPlaneDist;
-layout(location = 11) uniform float farPlaneDist;
-layout(location = 12) uniform vec3 transparency;
+layout(location = 15) uniform usampler2D frontCompact;   // Compact G-buffer layouts
+layout(location = 16) uniform usampler2D backCompact;
 
 // Input from vertex shader
 layout(location = 0) in vec3 fragPosWorld;  // World-space fragment position
 layout(location = 1) in vec3 fragPosScreen; // Screen-space fragment position (NDC space, i.e. [-1, 1])
+layout(location = 2) flat in uint fragInstance;
 
 // Output for color attachments
 layout(location = 0) out vec4 outColor; // On-screen color
 
-void main() {
-    vec2 texCoords = fragPosScreen.xy * 0.5 + 0.5;
+#include "gbuffer.glsl"
 
-    // Compute exterior entry angle
-	vec3 fragToCamera   = normalize(cameraPosition - fragPosWorld);
-    vec3 normalFront    = texture(frontNormals, texCoords).xyz;
-    float cosExterior   = dot(fragToCamera, normalFront); // Theta_i in paper
+const int DISPERSION_NONE               = 0;
+const int DISPERSION_THREE_WAVELENGTHS  = 1;
 
+// Refractive index ratios of red, green and blue light; red is bent the least
+vec3 channelRatios(float refractiveIndexRatio) {
+    return refractiveIndexRatio + vec3(-0.5, 0.0, 0.5) * dispersionSpread;
+}
+
+// Direction in which light entering the front faces at fragPosWorld leaves the back faces, for one refractive index ratio.
+// Also returns the path through the interior and the normal it exits through
+vec3 exitDirection(vec3 fragPosWorld, vec3 cameraToFrag, vec3 normalFront, float cosExterior, float unrefractedDistance, float distanceInner,
+                   float refractiveIndexRatio, out vec3 refractionDirection, out vec3 exitNormal) {
     // Compute interior entry angle
-    vec3 cameraToFrag           = -fragToCamera;
-    vec3 refractionDirection    = refract(cameraToFrag, normalFront, refractiveIndexRatio);
+    refractionDirection         = refract(cameraToFrag, normalFront, refractiveIndexRatio);
     vec3 normalFrontInverse     = -normalFront;
     float cosInterior           = dot(refractionDirection, normalFrontInverse); // Theta_t in paper
 
     // Compute exit point
-    // Depth is in range [0, 1]
-    // 0 corresponds to near plane distance
-    // 1 corresponds to far plane distance
-    // We map back to obtain world-space distance
-    float interPlaneDist                = farPlaneDist - nearPlaneDist;
-    float unrefractedDistance           = interPlaneDist * (texture(backDepth, texCoords).x - texture(frontDepth, texCoords).x) // d_V in paper
-                                          + nearPlaneDist;
-    float distanceInner                 = texture(innerDistance, texCoords).x;                                                  // d_N in paper
     float angleRatio                    = acos(cosInterior) / acos(cosExterior);
     float approximateRefractionDistance = (angleRatio * unrefractedDistance) + ((1.0 - angleRatio) * distanceInner);
     vec3 exitPointWorld                 = fragPosWorld + (approximateRefractionDistance * refractionDirection);
 
     // Compute exit direction
-    vec4 exitPointScreen            = mvp * vec4(exitPointWorld, 1.0);
-    vec2 exitPointTexCoords         = (exitPointScreen.xy / exitPointScreen.w) * 0.5 + 0.5;
-    vec3 exitNormal                 = -texture(backNormals, exitPointTexCoords).xyz;                        // Refract expects normal defining a hemisphere that the incident direction is in
-    vec3 exitRefractionDirection    = refract(refractionDirection, exitNormal, 1.0 / refractiveIndexRatio); // The entry and exit media have been flipped, so this second refraction uses the repicrocal of their ratio
+    vec4 exitPointScreen    = viewProjection * vec4(exitPointWorld, 1.0);
+    vec2 exitPointTexCoords = (exitPointScreen.xy / exitPointScreen.w) * 0.5 + 0.5;
+    exitNormal              = -readNormal(backNormals, backCompact, exitPointTexCoords);     // Refract expects normal defining a hemisphere that the incident direction is in
+    return refract(refractionDirection, exitNormal, 1.0 / refractiveIndexRatio);           // The entry and exit media have been flipped, so this second refraction uses the repicrocal of their ratio
+}
+
+void main() {
+    vec2 texCoords      = fragPosScreen.xy * 0.5 + 0.5;
+    Instance instance   = instances[fragInstance];
+
+    // Compute exterior entry angle
+	vec3 fragToCamera   = normalize(cameraPosition - fragPosWorld);
+    vec3 cameraToFrag   = -fragToCamera;
+    vec3 normalFront    = readNormal(frontNormals, frontCompact, texCoords);
+    float cosExterior   = dot(fragToCamera, normalFront); // Theta_i in paper
+
+    // Depth is in range [0, 1]
+    // 0 corresponds to near plane distance
+    // 1 corresponds to far plane distance
+    // We map back to obtain world-space distance
+    float interPlaneDist        = farPlaneDist - nearPlaneDist;
+    float unrefractedDistance   = interPlaneDist * (1.0 - texture(backDepth, texCoords).x - texture(frontDepth, texCoords).x) // d_V in paper
+                                  + nearPlaneDist;
+    float distanceInner         = readDistanceInner(innerDistance, frontCompact, texCoords);                                  // d_N in paper
+
+    // Everything fetched above is shared by the paths of all channels (see refract-resolve.frag)
+    vec3 color;
+    vec3 refractionDirection, exitNormal;
+    if (dispersion == DISPERSION_NONE) {
+        vec3 direction  = exitDirection(fragPosWorld, cameraToFrag, normalFront, cosExterior, unrefractedDistance, distanceInner,
+                                        instance.refractiveIndexRatio, refractionDirection, exitNormal);
+        color           = texture(environmentMap, direction).rgb;
+    } else if (dispersion == DISPERSION_THREE_WAVELENGTHS) {
+        vec3 ratios = channelRatios(instance.refractiveIndexRatio);
+        for (int channel = 0; channel < 3; channel++) {
+            vec3 direction  = exitDirection(fragPosWorld, cameraToFrag, normalFront, cosExterior, unrefractedDistance, distanceInner,
+                                            ratios[channel], refractionDirection, exitNormal);
+            color[channel]  = texture(environmentMap, direction)[channel];
+        }
+    } else {
+        vec3 ratios     = channelRatios(instance.refractiveIndexRatio);
+        vec3 green      = exitDirection(fragPosWorld, cameraToFrag, normalFront, cosExterior, unrefractedDistance, distanceInner,
+                                        ratios.g, refractionDirection, exitNormal);
+        for (int channel = 0; channel < 3; channel++) {
+            vec3 direction  = channel == 1 ? green : refract(refractionDirection, exitNormal, 1.0 / ratios[channel]);
+            color[channel]  = texture(environmentMap, direction == vec3(0.0) ? green : direction)[channel];
+        }
+    }
     
     // Compute final color
     // Two refraction media, so light is attenuated twice
-    vec3 attenuatedColor    = texture(environmentMap, exitRefractionDirection).rgb * transparency * transparency;
+    vec3 attenuatedColor    = color * instance.transparency * instance.transparency;
     outColor                = vec4(attenuatedColor, 1.0);
 }
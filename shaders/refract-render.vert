@@ -1,8 +1,28 @@
 #version 460
 
-// Uniforms
-layout(location = 0) uniform mat4 mvp;      // Full MVP matrix
-layout(location = 1) uniform mat4 model;    // Model matrix only
+// Per-frame constants, shared by every pass (see FrameUniforms in refraction.cpp)
+layout(std140) uniform Frame {
+    mat4 viewProjection;            // View and projection matrices; each instance has its own model matrix
+    mat4 inverseViewProjection;     // Maps NDC back to world space
+    mat4 previousViewProjection;    // View projection matrix of the previous frame
+    vec3 cameraPosition;
+    float nearPlaneDist;
+    float farPlaneDist;
+    int gbufferLayout;              // See GBufferLayout. Compact layouts keep the normal and d_N of a layer in a single texture
+    int dispersion;                 // See Dispersion. Other than none, red, green and blue are refracted with ratios of their own
+    float dispersionSpread;         // Difference between the refractive index ratios of blue and red light
+};
+
+// Transform and material of every instance of the mesh (see GPUInstance in instances.h)
+struct Instance {
+    mat4 model;                 // Model matrix only
+    mat4 normalModel;           // Upper 3x3 transforms normals, which should be transformed differently than positions (https://paroj.github.io/gltut/Illumination/Tut09%20Normal%20Transformation.html)
+    vec3 transparency;
+    float refractiveIndexRatio;
+};
+layout(std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
 
 // Per-vertex attributes
 layout(location = 0) in vec3 pos;               // Model-space position
@@ -13,10 +33,12 @@ layout(location = 3) in float distanceInner;    // Distance to the nearest point
 // Data to pass to fragment shader
 layout(location = 0) out vec3 fragPosWorld;     // World-space fragment position
 layout(location = 1) out vec3 fragPosScreen;    // Screen-space fragment position (NDC space, i.e. [-1, 1])
+layout(location = 2) flat out uint fragInstance; // Index into the Instances storage block
 
 void main() {
-    vec4 screenPos  = mvp * vec4(pos, 1.0);         // Transform 3D position into on-screen position
+    fragInstance    = gl_BaseInstance + gl_InstanceID;
+    fragPosWorld    = (instances[fragInstance].model * vec4(pos, 1.0)).xyz;
+    vec4 screenPos  = viewProjection * vec4(fragPosWorld, 1.0); // Transform 3D position into on-screen position
     gl_Position     = screenPos;
     fragPosScreen   = screenPos.xyz /= screenPos.w;
-    fragPosWorld    = (model * vec4(pos, 1.0)).xyz;
 }
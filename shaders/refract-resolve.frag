@@ -0,0 +1,280 @@
+#version 460
+
+// Per-frame constants, shared by every pass (see FrameUniforms in refraction.cpp)
+layout(std140) uniform Frame {
+    mat4 viewProjection;            // View and projection matrices; each instance has its own model matrix
+    mat4 inverseViewProjection;     // Maps NDC back to world space
+    mat4 previousViewProjection;    // View projection matrix of the previous frame
+    vec3 cameraPosition;
+    float nearPlaneDist;
+    float farPlaneDist;
+    int gbufferLayout;              // See GBufferLayout. Compact layouts keep the normal and d_N of a layer in a single texture
+    int dispersion;                 // See Dispersion. Other than none, red, green and blue are refracted with ratios of their own
+    float dispersionSpread;         // Difference between the refractive index ratios of blue and red light
+};
+
+// Transform and material of every instance of the mesh (see GPUInstance in instances.h)
+struct Instance {
+    mat4 model;                 // Model matrix only
+    mat4 normalModel;           // Upper 3x3 transforms normals, which should be transformed differently than positions (https://paroj.github.io/gltut/Illumination/Tut09%20Normal%20Transformation.html)
+    vec3 transparency;
+    float refractiveIndexRatio;
+};
+layout(std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+// Textures
+layout(location = 2) uniform sampler2D frontDepth;
+layout(location = 3) uniform sampler2D backDepth; // Stores 1 - depth (see write-geometric.vert)
+layout(location = 4) uniform sampler2D frontNormals;
+layout(location = 5) uniform sampler2D backNormals;
+layout(location = 6) uniform sampler2D innerDistance;
+layout(location = 7) uniform samplerCube environmentMap;
+layout(location = 15) uniform usampler2D frontCompact;   // Compact G-buffer layouts
+layout(location = 16) uniform usampler2D backCompact;
+layout(location = 27) uniform usampler2D frontInstance;  // Instance nearest to the camera in each pixel
+
+// Reduced rate refraction: computed for one pixel per block of the front faces, then upsampled (see RefractionRender::renderCombined())
+layout(location = 17) uniform int resolvePass;          // One of the RESOLVE_* constants below
+layout(location = 18) uniform int downsampleFactor;     // Size of the blocks along each axis
+layout(location = 19) uniform sampler2D lowResColor;    // Refracted color per block; zero alpha where the block shows no model
+layout(location = 20) uniform sampler2D lowResGuide;    // Normal and depth of the pixel each block's color was computed for
+
+// Temporal reuse: results of the previous frame are reprojected and kept for up to temporalInterval - 1 frames
+layout(location = 22) uniform sampler2D historyColor;   // Resolved color (RGB) and the number of frames it has been reused for (A)
+layout(location = 23) uniform sampler2D historyGuide;   // Normal and depth it was resolved for; depth 1 where the model was not seen
+layout(location = 24) uniform int temporalInterval;     // 1 disables temporal reuse
+layout(location = 25) uniform int refreshSlot;          // Pixels of this slot are refracted again regardless of their history
+layout(location = 26) uniform bool historyValid;
+layout(binding = 0, rgba16f) uniform writeonly image2D historyColorOut; // History of this frame, in the same layout
+layout(binding = 1, rgba32f) uniform writeonly image2D historyGuideOut;
+
+// Pixel shader work (see RefractionShading)
+layout(binding = 0, offset = 0) uniform atomic_uint lowResEvaluations;
+layout(binding = 0, offset = 4) uniform atomic_uint coveredPixels;
+layout(binding = 0, offset = 8) uniform atomic_uint fullRateEvaluations;
+layout(binding = 0, offset = 12) uniform atomic_uint reusedPixels;
+
+// Output for color attachments
+layout(location = 0) out vec4 outColor; // On-screen color
+layout(location = 1) out vec4 outGuide; // Low resolution pass only, see lowResGuide
+
+const int RESOLVE_FULL_RATE = 0;
+const int RESOLVE_LOW_RES   = 1;
+const int RESOLVE_UPSAMPLE  = 2;
+
+const float DEPTH_TOLERANCE     = 0.02; // Relative difference in view depth at which a low resolution sample stops contributing
+const float NORMAL_SHARPNESS    = 16.0; // Exponent of the cosine between normals that weighs low resolution samples
+const float MIN_WEIGHT          = 0.5;  // Pixels whose samples carry less total weight are computed at full rate
+const float HISTORY_COSINE      = 0.95; // Smallest cosine between the normals of a pixel and its reprojected history for the latter to be reused
+const vec4 NO_HISTORY           = vec4(-1.0);
+
+#include "gbuffer.glsl"
+
+const int DISPERSION_NONE               = 0;
+const int DISPERSION_THREE_WAVELENGTHS  = 1;
+
+// Refractive index ratios of red, green and blue light; red is bent the least
+vec3 channelRatios(float refractiveIndexRatio) {
+    return refractiveIndexRatio + vec3(-0.5, 0.0, 0.5) * dispersionSpread;
+}
+
+vec2 pixelCenter(ivec2 pixel) {
+    return (vec2(pixel) + 0.5) / vec2(textureSize(frontDepth, 0));
+}
+
+// Rebuild what the rasterised combined pass interpolated: the world-space position of the nearest surface
+vec3 surfacePosition(ivec2 pixel, float depth) {
+    vec4 positionWorld = inverseViewProjection * vec4(vec3(pixelCenter(pixel), depth) * 2.0 - 1.0, 1.0);
+    return positionWorld.xyz / positionWorld.w;
+}
+
+// Direction in which light entering the front faces at fragPosWorld leaves the back faces, for one refractive index ratio.
+// Also returns the path through the interior and the normal it exits through
+vec3 exitDirection(vec3 fragPosWorld, vec3 cameraToFrag, vec3 normalFront, float cosExterior, float unrefractedDistance, float distanceInner,
+                   float refractiveIndexRatio, out vec3 refractionDirection, out vec3 exitNormal) {
+    // Compute interior entry angle
+    refractionDirection         = refract(cameraToFrag, normalFront, refractiveIndexRatio);
+    vec3 normalFrontInverse     = -normalFront;
+    float cosInterior           = dot(refractionDirection, normalFrontInverse); // Theta_t in paper
+
+    // Compute exit point
+    float angleRatio                    = acos(cosInterior) / acos(cosExterior);
+    float approximateRefractionDistance = (angleRatio * unrefractedDistance) + ((1.0 - angleRatio) * distanceInner);
+    vec3 exitPointWorld                 = fragPosWorld + (approximateRefractionDistance * refractionDirection);
+
+    // Compute exit direction
+    vec4 exitPointScreen    = viewProjection * vec4(exitPointWorld, 1.0);
+    vec2 exitPointTexCoords = (exitPointScreen.xy / exitPointScreen.w) * 0.5 + 0.5;
+    exitNormal              = -readNormal(backNormals, backCompact, exitPointTexCoords);     // Refract expects normal defining a hemisphere that the incident direction is in
+    return refract(refractionDirection, exitNormal, 1.0 / refractiveIndexRatio);           // The entry and exit media have been flipped, so this second refraction uses the repicrocal of their ratio
+}
+
+// Refracted environment color seen through the given pixel of the front faces
+vec3 refractedColor(ivec2 pixel, float depthFront, out vec3 normalFront) {
+    vec2 texCoords      = pixelCenter(pixel);
+    vec3 fragPosWorld   = surfacePosition(pixel, depthFront);
+    Instance instance   = instances[texelFetch(frontInstance, pixel, 0).x];
+
+    // Compute exterior entry angle
+	vec3 fragToCamera   = normalize(cameraPosition - fragPosWorld);
+    vec3 cameraToFrag   = -fragToCamera;
+    normalFront         = readNormal(frontNormals, frontCompact, texCoords);
+    float cosExterior   = dot(fragToCamera, normalFront); // Theta_i in paper
+
+    // Depth is in range [0, 1]
+    // 0 corresponds to near plane distance
+    // 1 corresponds to far plane distance
+    // We map back to obtain world-space distance
+    float interPlaneDist        = farPlaneDist - nearPlaneDist;
+    float unrefractedDistance   = interPlaneDist * (1.0 - texture(backDepth, texCoords).x - depthFront)  // d_V in paper
+                                  + nearPlaneDist;
+    float distanceInner         = readDistanceInner(innerDistance, frontCompact, texCoords);             // d_N in paper
+
+    // Everything fetched above is shared by the paths of all channels
+    vec3 color;
+    vec3 refractionDirection, exitNormal;
+    if (dispersion == DISPERSION_NONE) {
+        vec3 direction  = exitDirection(fragPosWorld, cameraToFrag, normalFront, cosExterior, unrefractedDistance, distanceInner,
+                                        instance.refractiveIndexRatio, refractionDirection, exitNormal);
+        color           = texture(environmentMap, direction).rgb;
+    } else if (dispersion == DISPERSION_THREE_WAVELENGTHS) {
+        // A path through the interior per channel, each with its own exit point
+        vec3 ratios = channelRatios(instance.refractiveIndexRatio);
+        for (int channel = 0; channel < 3; channel++) {
+            vec3 direction  = exitDirection(fragPosWorld, cameraToFrag, normalFront, cosExterior, unrefractedDistance, distanceInner,
+                                            ratios[channel], refractionDirection, exitNormal);
+            color[channel]  = texture(environmentMap, direction)[channel];
+        }
+    } else {
+        // A single path at the green ratio, only split into channels where it leaves the back faces
+        vec3 ratios     = channelRatios(instance.refractiveIndexRatio);
+        vec3 green      = exitDirection(fragPosWorld, cameraToFrag, normalFront, cosExterior, unrefractedDistance, distanceInner,
+                                        ratios.g, refractionDirection, exitNormal);
+        for (int channel = 0; channel < 3; channel++) {
+            vec3 direction  = channel == 1 ? green : refract(refractionDirection, exitNormal, 1.0 / ratios[channel]);
+            color[channel]  = texture(environmentMap, direction == vec3(0.0) ? green : direction)[channel]; // Keep green where a channel is totally internally reflected
+        }
+    }
+
+    // Compute final color
+    // Two refraction media, so light is attenuated twice
+    return color * instance.transparency * instance.transparency;
+}
+
+float linearDepth(float depth) {
+    return 2.0 * nearPlaneDist * farPlaneDist / (farPlaneDist + nearPlaneDist - (2.0 * depth - 1.0) * (farPlaneDist - nearPlaneDist));
+}
+
+void resolveLowRes() {
+    // Each block is computed for its nearest covered pixel, so that thin parts of the model are not lost
+    ivec2 blockStart    = ivec2(gl_FragCoord.xy) * downsampleFactor;
+    ivec2 lastPixel     = textureSize(frontDepth, 0) - 1;
+    ivec2 nearestPixel  = blockStart;
+    float nearestDepth  = 1.0;
+    for (int y = 0; y < downsampleFactor; y++) {
+        for (int x = 0; x < downsampleFactor; x++) {
+            ivec2 pixel = min(blockStart + ivec2(x, y), lastPixel);
+            float depth = texelFetch(frontDepth, pixel, 0).x;
+            if (depth < nearestDepth) {
+                nearestDepth = depth;
+                nearestPixel = pixel;
+            }
+        }
+    }
+    if (nearestDepth == 1.0) { discard; }
+
+    atomicCounterIncrement(lowResEvaluations);
+    vec3 normal;
+    outColor = vec4(refractedColor(nearestPixel, nearestDepth, normal), 1.0);
+    outGuide = vec4(normalize(normal), nearestDepth);
+}
+
+// Joint bilateral upsample of the four nearest blocks: bilinear weights, scaled down for blocks whose depth or normal
+// differ from the pixel's. Returns zero alpha if too little of them applies, e.g. along silhouettes
+vec4 upsample(ivec2 pixel, float depth) {
+    vec3 normal         = normalize(readNormal(frontNormals, frontCompact, pixelCenter(pixel)));
+    float pixelDepth    = linearDepth(depth);
+    vec2 lowResPos      = (vec2(pixel) + 0.5) / float(downsampleFactor) - 0.5;
+    ivec2 base          = ivec2(floor(lowResPos));
+    vec2 fraction       = lowResPos - vec2(base);
+    ivec2 lastBlock     = textureSize(lowResColor, 0) - 1;
+
+    vec3 colorSum       = vec3(0.0);
+    float weightSum     = 0.0;
+    for (int tap = 0; tap < 4; tap++) {
+        ivec2 offset    = ivec2(tap & 1, tap >> 1);
+        ivec2 block     = clamp(base + offset, ivec2(0), lastBlock);
+        vec4 color      = texelFetch(lowResColor, block, 0);
+        if (color.a == 0.0) { return vec4(0.0); }
+
+        vec4 guide          = texelFetch(lowResGuide, block, 0);
+        vec2 bilinear       = mix(1.0 - fraction, fraction, vec2(offset));
+        float depthWeight   = max(1.0 - abs(linearDepth(guide.w) - pixelDepth) / (DEPTH_TOLERANCE * pixelDepth), 0.0);
+        float normalWeight  = pow(max(dot(guide.xyz, normal), 0.0), NORMAL_SHARPNESS);
+        float weight        = bilinear.x * bilinear.y * depthWeight * normalWeight;
+        colorSum           += weight * color.rgb;
+        weightSum          += weight;
+    }
+    return weightSum < MIN_WEIGHT ? vec4(0.0) : vec4(colorSum / weightSum, 1.0);
+}
+
+// Color of the previous frame at the same point of the surface, or NO_HISTORY if it showed another surface there,
+// was reused for too long already, or this pixel is due to be refracted again
+vec4 reprojectHistory(ivec2 pixel, float depth, vec3 normal) {
+    int slot = ((pixel.x & 1) + 2 * (pixel.y & 1)) % temporalInterval;
+    if (!historyValid || slot == refreshSlot) { return NO_HISTORY; }
+
+    vec4 previousClip = previousViewProjection * vec4(surfacePosition(pixel, depth), 1.0);
+    if (previousClip.w <= 0.0) { return NO_HISTORY; }
+    vec3 previousNdc        = previousClip.xyz / previousClip.w;
+    ivec2 historyDims       = textureSize(historyGuide, 0);
+    ivec2 previousPixel     = ivec2(floor((previousNdc.xy * 0.5 + 0.5) * vec2(historyDims)));
+    if (any(lessThan(previousPixel, ivec2(0))) || any(greaterThanEqual(previousPixel, historyDims))) { return NO_HISTORY; }
+
+    // Disocclusions show up as a different depth, and the surface sliding under a silhouette as a different normal
+    vec4 guide              = texelFetch(historyGuide, previousPixel, 0);
+    vec4 color              = texelFetch(historyColor, previousPixel, 0);
+    float expectedDepth     = linearDepth(previousNdc.z * 0.5 + 0.5);
+    bool sameSurface        = guide.w < 1.0
+                              && abs(linearDepth(guide.w) - expectedDepth) < DEPTH_TOLERANCE * expectedDepth
+                              && dot(guide.xyz, normal) > HISTORY_COSINE;
+    return sameSurface && color.a + 1.0 < float(temporalInterval) ? color : NO_HISTORY;
+}
+
+void main() {
+    if (resolvePass == RESOLVE_LOW_RES) {
+        resolveLowRes();
+        return;
+    }
+
+    // Pixels the front face pass did not cover show whatever is behind the model
+    ivec2 pixel         = ivec2(gl_FragCoord.xy);
+    float depthFront    = texelFetch(frontDepth, pixel, 0).x;
+    if (depthFront == 1.0) { discard; }
+    gl_FragDepth = depthFront;
+    atomicCounterIncrement(coveredPixels);
+
+    vec3 normal     = normalize(readNormal(frontNormals, frontCompact, pixelCenter(pixel)));
+    vec4 history    = temporalInterval > 1 ? reprojectHistory(pixel, depthFront, normal) : NO_HISTORY;
+    vec3 color      = history.rgb;
+    if (history == NO_HISTORY) {
+        vec4 upsampled = resolvePass == RESOLVE_UPSAMPLE ? upsample(pixel, depthFront) : vec4(0.0);
+        if (upsampled.a > 0.0) {
+            color = upsampled.rgb;
+        } else {
+            atomicCounterIncrement(fullRateEvaluations);
+            vec3 normalFront;
+            color = refractedColor(pixel, depthFront, normalFront);
+        }
+    } else {
+        atomicCounterIncrement(reusedPixels);
+    }
+    outColor = vec4(color, 1.0);
+
+    if (temporalInterval > 1) {
+        imageStore(historyColorOut, pixel, vec4(color, history == NO_HISTORY ? 0.0 : history.a + 1.0));
+        imageStore(historyGuideOut, pixel, vec4(normal, depthFront));
+    }
+}
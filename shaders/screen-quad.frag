@@ -2,6 +2,7 @@
 
 // Texture to render to screen
 layout(location = 0) uniform sampler2D texSampler;
+layout(location = 1) uniform bool invert; // Show 1 - value, e.g. for back face depth which is stored reversed
 
 // Screen-space coordinates
 layout(location = 0) in vec2 bufferCoords;
@@ -11,4 +12,5 @@ layout(location = 0) out vec4 outColor;
 
 void main() {
     outColor = texture(texSampler, bufferCoords);
+    if (invert) { outColor.rgb = 1.0 - outColor.rgb; }
 }
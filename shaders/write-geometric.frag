@@ -4,12 +4,30 @@
 layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec3 fragNormal;
 layout(location = 2) in float fragDistanceInner;
+layout(location = 3) flat in uint fragInstance;
 
-// Output for color attachments
+// Output for color attachments. The framebuffer's draw buffers pick the outputs of the G-buffer layout in use
 layout(location = 0) out vec3 outColor;				// Normal texture
 layout(location = 1) out float outDistanceInner;	// Distance to the nearest point on the interior of the mesh along normal (d_N in the paper)
+layout(location = 2) out uvec2 outCompact;			// Octahedral normal as two 16-bit snorms, and d_N as a float
+layout(location = 3) out uint outCompactLow;		// Octahedral normal as two 8-bit snorms, and d_N as a half float
+layout(location = 4) out uint outInstance;			// Index of the instance in the Instances storage block, whatever the layout
+
+const float MAX_HALF = 65504.0;
+
+// Map a unit vector onto the octahedron, and its lower half onto the corners of the square (Cigolle et al. 2014)
+vec2 octahedralEncode(vec3 normal) {
+	vec2 projected = normal.xy / (abs(normal.x) + abs(normal.y) + abs(normal.z));
+	if (normal.z < 0.0) { projected = (1.0 - abs(projected.yx)) * vec2(projected.x >= 0.0 ? 1.0 : -1.0, projected.y >= 0.0 ? 1.0 : -1.0); }
+	return projected;
+}
 
 void main() {
 	outColor 			= fragNormal;
 	outDistanceInner	= fragDistanceInner;
+	outInstance			= fragInstance;
+
+	vec2 octahedral		= octahedralEncode(normalize(fragNormal));
+	outCompact			= uvec2(packSnorm2x16(octahedral), floatBitsToUint(fragDistanceInner));
+	outCompactLow		= (packSnorm4x8(vec4(octahedral, 0.0, 0.0)) & 0xFFFFu) | (packHalf2x16(vec2(min(fragDistanceInner, MAX_HALF), 0.0)) << 16);
 }
@@ -1,9 +1,31 @@
 #version 460
 
+// Per-frame constants, shared by every pass (see FrameUniforms in refraction.cpp)
+layout(std140) uniform Frame {
+    mat4 viewProjection;            // View and projection matrices; each instance has its own model matrix
+    mat4 inverseViewProjection;     // Maps NDC back to world space
+    mat4 previousViewProjection;    // View projection matrix of the previous frame
+    vec3 cameraPosition;
+    float nearPlaneDist;
+    float farPlaneDist;
+    int gbufferLayout;              // See GBufferLayout. Compact layouts keep the normal and d_N of a layer in a single texture
+    int dispersion;                 // See Dispersion. Other than none, red, green and blue are refracted with ratios of their own
+    float dispersionSpread;         // Difference between the refractive index ratios of blue and red light
+};
+
+// Transform and material of every instance of the mesh (see GPUInstance in instances.h)
+struct Instance {
+    mat4 model;                 // Model matrix only
+    mat4 normalModel;           // Upper 3x3 transforms normals, which should be transformed differently than positions (https://paroj.github.io/gltut/Illumination/Tut09%20Normal%20Transformation.html)
+    vec3 transparency;
+    float refractiveIndexRatio;
+};
+layout(std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
 // Uniforms
-layout(location = 0) uniform mat4 mvp;                          // Full MVP matrix
-layout(location = 1) uniform mat4 model;                        // Model matrix only
-layout(location = 2) uniform mat3 normalModel;                  // Normals should be transformed differently than positions (https://paroj.github.io/gltut/Illumination/Tut09%20Normal%20Transformation.html)
+layout(location = 3) uniform bool reverseDepth;                 // Store 1 - depth, so that a less-than depth test keeps the farthest surface
 
 // Per-vertex attributes
 layout(location = 0) in vec3 pos;               // Model-space position
@@ -15,13 +37,21 @@ layout(location = 3) in float distanceInner;    // Distance to the nearest point
 layout(location = 0) out vec3 fragPos;
 layout(location = 1) out vec3 fragNormal;
 layout(location = 2) out float fragDistanceInner;
+layout(location = 3) flat out uint fragInstance;
 
 void main() {
+    // Indirect draw commands carry their instance as the base instance, and draw a single one each
+    uint instanceIdx    = gl_BaseInstance + gl_InstanceID;
+    Instance instance   = instances[instanceIdx];
+
 	// Transform 3D position into on-screen position
-    gl_Position = mvp * vec4(pos, 1.0);
+    vec4 worldPos   = instance.model * vec4(pos, 1.0);
+    gl_Position     = viewProjection * worldPos;
+    if (reverseDepth) { gl_Position.z = -gl_Position.z; }
 
-    // Pass world-space position and normal through to fragment shader
-    fragPos             = (model * vec4(pos, 1.0)).xyz;
-    fragNormal          = normalModel * normal;
-    fragDistanceInner   = distanceInner;
+    // Pass world-space position, normal and d_N through to fragment shader. Instances are scaled uniformly
+    fragPos             = worldPos.xyz;
+    fragNormal          = mat3(instance.normalModel) * normal;
+    fragDistanceInner   = distanceInner * length(instance.model[0].xyz);
+    fragInstance        = instanceIdx;
 }
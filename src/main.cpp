@@ -1,22 +1,55 @@
+#include <framework/gl_state.h>
 #include <framework/opengl_includes.h>
 #include <framework/trackball.h>
 #include <framework/window.h>
 
+#include <render/cache_directory.h>
+#include <render/dispersion_benchmark.h>
+#include <render/dynamic_resolution.h>
 #include <render/environment_map.h>
+#include <render/frame_cache.h>
+#include <render/instances.h>
+#include <render/layout_benchmark.h>
 #include <render/mesh_manager.h>
 #include <render/refraction.h>
 #include <ui/menu.h>
 #include <utils/config.h>
 #include <utils/constants.h>
 
+#include <format>
+#include <iostream>
+#include <optional>
+#include <string_view>
+
 int main(int argc, char* argv[]) {
-    // Init core objects
+    // Cache maintenance and benchmark commands run without opening a window
     Config config;
+    if (argc > 1) {
+        const std::string_view command = argv[1];
+        if (command == "--benchmark-layout" && argc > 2) {
+            benchmarkMeshLayouts(argv[2], config);
+            return EXIT_SUCCESS;
+        }
+        if (command != "--prune-cache" && command != "--verify-cache") {
+            std::cerr << "Usage: " << argv[0] << " [--prune-cache | --verify-cache | --benchmark-layout <model>]" << std::endl;
+            return EXIT_FAILURE;
+        }
+        CacheDirectory cacheDirectory(utils::CACHE_PATH, static_cast<uint64_t>(config.cacheBudgetMiB) << 20ULL);
+        CacheMaintenanceReport report = command == "--prune-cache" ? cacheDirectory.prune() : cacheDirectory.verify();
+        std::cout << std::format("Removed {} file(s) ({} bytes); {} file(s) ({} bytes) remain",
+                                 report.filesRemoved, report.bytesFreed, report.filesRemaining, report.bytesRemaining) << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    // Init core objects
     Window window { "Interactive Refraction", glm::ivec2(utils::WIDTH, utils::HEIGHT), OpenGLVersion::GL46 };
     Trackball trackball { &window, glm::radians(50.0f) };
     MeshManager meshManager(config, utils::RESOURCES_PATH / "dragon.obj");
-    Menu menu(config, meshManager);
+    DispersionBenchmark dispersionBenchmark(config);
+    Menu menu(config, meshManager, dispersionBenchmark);
     RefractionRender refractionRender(config, window.getWindowSize());
+    FrameCache frameCache(window.getWindowSize());
+    DynamicResolution dynamicResolution(config);
 
     // Environment map
     constexpr char envMapFolder[]   = "Skansen";
@@ -34,6 +67,10 @@ int main(int argc, char* argv[]) {
             return;
     });
 
+    // Render targets follow the window, at the resolution scale of the frame they are next used in
+    glm::ivec2 windowDims = window.getWindowSize();
+    window.registerWindowResizeCallback([&](const glm::ivec2& size) { windowDims = size; });
+
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
@@ -43,26 +80,63 @@ int main(int argc, char* argv[]) {
     glClearDepth(1.0f);
 
     // Render loop
+    // When waiting for input, a few frames are still drawn after every event so that the UI can settle (e.g. hover highlights)
+    constexpr int UI_SETTLE_FRAMES  = 3;
+    int framesUntilWait             = UI_SETTLE_FRAMES;
     while (!window.shouldClose()) {
+        if (config.waitForInput && !dispersionBenchmark.running() && framesUntilWait-- <= 0) {
+            window.waitForInput();
+            framesUntilWait = UI_SETTLE_FRAMES;
+        }
         window.updateInput();
 
-        // Clear previous output
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Nothing to render into while minimised
+        const bool minimized = windowDims.x == 0 || windowDims.y == 0;
+        if (minimized) {
+            menu.draw(refractionRender.stats());
+            window.swapBuffers();
+            continue;
+        }
+        const glm::ivec2 renderDims = dynamicResolution.renderDims(windowDims);
+        refractionRender.resize(renderDims);
+        frameCache.resize(renderDims);
+
+        // The UI renderer binds programs, textures and vertex arrays of its own, and resizing may delete bound objects
+        gl_state::invalidate();
+
+        // Only render the scene again if anything it depends on changed, otherwise the last one is presented again
+        const FrameInputs frameInputs   = { .view = trackball.viewMatrix(), .projection = trackball.projectionMatrix(), .renderDims = renderDims,
+                                            .config = config, .meshVersion = meshManager.meshVersion() };
+        // Results reprojected from earlier frames only carry over while nothing but the camera changes
+        if (const std::optional<FrameInputs>& cached = frameCache.cachedInputs(); cached && (cached->config != config || cached->meshVersion != frameInputs.meshVersion)) {
+            refractionRender.invalidateHistory();
+        }
+        const bool redraw               = frameCache.needsRedraw(frameInputs) || !config.onDemandRendering || refractionRender.hasStalePixels()
+                                          || dispersionBenchmark.running();
+        if (redraw) {
+            // Clear previous output
+            gl_state::bindFramebuffer(frameCache.framebuffer());
+            glViewport(0, 0, renderDims.x, renderDims.y);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Set model matrix
-        const glm::mat4 model = glm::mat4(1.0f);
-        
-        // Draw the requested option and environment map if desired
-        // Environment map must be drawn first to allow for model to overwrite it later
-        if (config.currentRender == RenderOption::Combined && config.showEnvironmentMap) {
-            environmentMap.render(trackball.projectionMatrix(), trackball.forward(), trackball.up());
+            // Draw the requested option and environment map if desired
+            // Environment map must be drawn first to allow for model to overwrite it later
+            if (config.currentRender == RenderOption::Combined && config.showEnvironmentMap) {
+                environmentMap.render(trackball.projectionMatrix(), trackball.forward(), trackball.up(), frameCache.framebuffer());
+            }
+            refractionRender.draw(meshManager.getMesh(), makeInstanceGrid(config),
+                                  trackball.viewMatrix(), trackball.projectionMatrix(),
+                                  trackball.position(), environmentMap.getTexId(), frameCache.framebuffer());
+            if (const std::optional<double> gpuMilliseconds = refractionRender.stats().newGpuMilliseconds) {
+                dynamicResolution.update(*gpuMilliseconds);
+                dispersionBenchmark.update(*gpuMilliseconds);
+            }
         }
-        refractionRender.draw(meshManager.getMesh(),
-                              model, trackball.viewMatrix(), trackball.projectionMatrix(),
-                              trackball.position(), environmentMap.getTexId());
+        gl_state::bindFramebuffer(0);
+        frameCache.present(windowDims);
 
         // Render UI
-        menu.draw();
+        menu.draw(refractionRender.stats());
 
         // Present result to the screen.
         window.swapBuffers();
@@ -151,7 +151,7 @@ std::vector<Primitive> BoundingVolumeHierarchy::buildPrimitives() const {
 AxisAlignedBox BoundingVolumeHierarchy::boundingBox(const std::span<Primitive>& triangles) const {
     AxisAlignedBox bb = {
         .lower = glm::vec3(std::numeric_limits<float>::max()),
-        .upper = glm::vec3(std::numeric_limits<float>::min())
+        .upper = glm::vec3(std::numeric_limits<float>::lowest())
     };
 
     for (const Primitive& triangle : triangles) {
@@ -76,6 +76,7 @@ public:
     std::span<Node> nodes()                         { return m_nodes; }
     std::span<const Primitive> primitives() const   { return m_primitives; }
     std::span<Primitive> primitives()               { return m_primitives; }
+    uint32_t rootIndex() const                      { return m_rootIdx; }
 
 private:
     const Mesh& m_mesh;
@@ -0,0 +1,199 @@
+#include "chunked_bvh.h"
+
+#include "intersect.h"
+
+#include <algorithm>
+#include <format>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+
+
+static constexpr size_t TOP_LEVEL_LEAF_SIZE = 2ULL; // Maximum nr. of chunks in a top-level leaf
+
+// Distance along the ray at which it enters the box, zero if it starts inside of it.
+// Axes the ray runs parallel to are handled explicitly, as the slab test would produce NaNs for them
+static std::optional<float> entryDistance(const AxisAlignedBox& box, const Ray& ray) {
+    float tIn   = 0.0f;
+    float tOut  = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; axis++) {
+        if (ray.direction[axis] == 0.0f) {
+            if (ray.origin[axis] < box.lower[axis] || ray.origin[axis] > box.upper[axis]) { return std::nullopt; }
+            continue;
+        }
+        const float tLower  = (box.lower[axis] - ray.origin[axis]) / ray.direction[axis];
+        const float tUpper  = (box.upper[axis] - ray.origin[axis]) / ray.direction[axis];
+        tIn                 = std::max(tIn, std::min(tLower, tUpper));
+        tOut                = std::min(tOut, std::max(tLower, tUpper));
+    }
+    if (tIn > tOut) { return std::nullopt; }
+    return tIn;
+}
+
+static AxisAlignedBox merge(const AxisAlignedBox& lhs, const AxisAlignedBox& rhs) {
+    return { .lower = glm::min(lhs.lower, rhs.lower), .upper = glm::max(lhs.upper, rhs.upper) };
+}
+
+ChunkedBVH::ChunkedBVH(const std::filesystem::path& storePath, uint64_t residentByteBudget, const Config& config)
+    : m_storePath(storePath)
+    , m_residentByteBudget(residentByteBudget)
+    , m_config(config)
+    , m_storeWriter(storePath, std::ios::binary | std::ios::trunc) {
+    if (!m_storeWriter) { throw std::runtime_error(std::format("Could not open node store {} for writing", storePath.string())); }
+}
+
+void ChunkedBVH::addChunk(const Mesh& chunkMesh) {
+    // The in-memory hierarchy holds full vertex copies; only positions go to disk
+    BoundingVolumeHierarchy bvh(chunkMesh, m_config);
+    std::vector<StoredTriangle> triangles;
+    triangles.reserve(bvh.primitives().size());
+    for (const Primitive& primitive : bvh.primitives()) { triangles.push_back({ primitive.v0.position, primitive.v1.position, primitive.v2.position }); }
+
+    const ChunkRecord record = { .offset        = m_storeBytes,
+                                 .numNodes      = static_cast<uint32_t>(bvh.nodes().size()),
+                                 .numTriangles  = static_cast<uint32_t>(triangles.size()),
+                                 .rootIdx       = bvh.rootIndex(),
+                                 .aabb          = bvh.nodes()[bvh.rootIndex()].aabb };
+    m_storeWriter.write(reinterpret_cast<const char*>(bvh.nodes().data()), static_cast<std::streamsize>(bvh.nodes().size_bytes()));
+    m_storeWriter.write(reinterpret_cast<const char*>(triangles.data()), static_cast<std::streamsize>(triangles.size() * sizeof(StoredTriangle)));
+    if (!m_storeWriter) { throw std::runtime_error(std::format("Failed writing to node store {}", m_storePath.string())); }
+    m_storeBytes += bvh.nodes().size_bytes() + triangles.size() * sizeof(StoredTriangle);
+    m_chunks.push_back(record);
+}
+
+void ChunkedBVH::finalize() {
+    m_storeWriter.close();
+    m_storeReader.open(m_storePath, std::ios::binary);
+    if (!m_storeReader) { throw std::runtime_error(std::format("Could not open node store {} for reading", m_storePath.string())); }
+    m_resident.resize(m_chunks.size());
+
+    std::vector<uint32_t> chunkIndices(m_chunks.size());
+    for (uint32_t chunkIdx = 0U; chunkIdx < chunkIndices.size(); chunkIdx++) { chunkIndices[chunkIdx] = chunkIdx; }
+    if (!chunkIndices.empty()) { m_topLevelRootIdx = constructTopLevel(chunkIndices); }
+}
+
+bool ChunkedBVH::intersect(Ray& ray, HitInfo& hitInfo) const {
+    if (m_topLevelNodes.empty()) { return false; }
+
+    // Gather the chunks along the ray first so that they can be visited front to back
+    struct Candidate {
+        float entry;
+        uint32_t chunkIdx;
+    };
+    std::vector<Candidate> candidates;
+    std::vector<uint32_t> nodeStack = { m_topLevelRootIdx };
+    while (!nodeStack.empty()) {
+        const Node& node = m_topLevelNodes[nodeStack.back()];
+        nodeStack.pop_back();
+        std::optional<float> entry = entryDistance(node.aabb, ray);
+        if (!entry || *entry > ray.t) { continue; }
+
+        if (node.isLeaf()) {
+            for (uint32_t leafIdx = node.primitiveOffset(); leafIdx < node.primitiveOffset() + node.primitiveCount(); leafIdx++) {
+                const uint32_t chunkIdx = m_topLevelChunks[leafIdx];
+                if (std::optional<float> chunkEntry = entryDistance(m_chunks[chunkIdx].aabb, ray)) { candidates.push_back({ *chunkEntry, chunkIdx }); }
+            }
+        } else {
+            nodeStack.push_back(node.leftChild());
+            nodeStack.push_back(node.rightChild());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs) { return lhs.entry < rhs.entry; });
+
+    // Chunks beyond the closest hit so far cannot contain a closer one, and never need to be loaded
+    bool hit = false;
+    for (const Candidate& candidate : candidates) {
+        if (candidate.entry > ray.t) { break; }
+        hit |= acquire(candidate.chunkIdx)->intersect(ray, hitInfo);
+    }
+    return hit;
+}
+
+uint64_t ChunkedBVH::chunkLoads() const {
+    std::scoped_lock lock(m_mutex);
+    return m_chunkLoads;
+}
+
+bool ChunkedBVH::ResidentChunk::intersect(Ray& ray, HitInfo& hitInfo) const {
+    // Iterative version of BoundingVolumeHierarchy::intersectAcceleratedRecursive()
+    bool hit                        = false;
+    std::vector<uint32_t> nodeStack = { rootIdx };
+    while (!nodeStack.empty()) {
+        const Node& node = nodes[nodeStack.back()];
+        nodeStack.pop_back();
+        const float tOriginal   = ray.t;
+        const bool hitBox       = intersectRayWithShape(node.aabb, ray);
+        ray.t                   = tOriginal;
+        if (!hitBox) { continue; }
+
+        if (node.isLeaf()) {
+            for (uint32_t triangleIdx = node.primitiveOffset(); triangleIdx < node.primitiveOffset() + node.primitiveCount(); triangleIdx++) {
+                const StoredTriangle& triangle = triangles[triangleIdx];
+                hit |= intersectRayWithTriangle(triangle.v0, triangle.v1, triangle.v2, ray, hitInfo);
+            }
+        } else {
+            nodeStack.push_back(node.rightChild());
+            nodeStack.push_back(node.leftChild());
+        }
+    }
+    return hit;
+}
+
+std::shared_ptr<const ChunkedBVH::ResidentChunk> ChunkedBVH::acquire(uint32_t chunkIdx) const {
+    std::scoped_lock lock(m_mutex);
+    ResidentSlot& slot = m_resident[chunkIdx];
+    if (slot.chunk) {
+        m_leastRecentlyUsed.splice(m_leastRecentlyUsed.begin(), m_leastRecentlyUsed, slot.lruPosition);
+        return slot.chunk;
+    }
+
+    // Read the chunk back from the node store
+    const ChunkRecord& record   = m_chunks[chunkIdx];
+    auto chunk                  = std::make_shared<ResidentChunk>();
+    chunk->nodes.resize(record.numNodes);
+    chunk->triangles.resize(record.numTriangles);
+    chunk->rootIdx              = record.rootIdx;
+    m_storeReader.seekg(static_cast<std::streamoff>(record.offset));
+    m_storeReader.read(reinterpret_cast<char*>(chunk->nodes.data()), static_cast<std::streamsize>(chunk->nodes.size() * sizeof(Node)));
+    m_storeReader.read(reinterpret_cast<char*>(chunk->triangles.data()), static_cast<std::streamsize>(chunk->triangles.size() * sizeof(StoredTriangle)));
+    if (!m_storeReader) { throw std::runtime_error(std::format("Failed reading chunk {} from node store {}", chunkIdx, m_storePath.string())); }
+    m_chunkLoads++;
+
+    // Make room for it; the chunk that was just loaded always stays
+    m_residentBytes += chunk->bytes();
+    while (m_residentBytes > m_residentByteBudget && !m_leastRecentlyUsed.empty()) {
+        ResidentSlot& evicted = m_resident[m_leastRecentlyUsed.back()];
+        m_residentBytes      -= evicted.chunk->bytes();
+        evicted.chunk.reset();
+        m_leastRecentlyUsed.pop_back();
+    }
+    m_leastRecentlyUsed.push_front(chunkIdx);
+    slot = { .chunk = std::move(chunk), .lruPosition = m_leastRecentlyUsed.begin() };
+    return slot.chunk;
+}
+
+uint32_t ChunkedBVH::constructTopLevel(std::span<uint32_t> chunkIndices) {
+    AxisAlignedBox bbNode = m_chunks[chunkIndices.front()].aabb;
+    for (uint32_t chunkIdx : chunkIndices) { bbNode = merge(bbNode, m_chunks[chunkIdx].aabb); }
+
+    if (chunkIndices.size() <= TOP_LEVEL_LEAF_SIZE) {
+        const uint32_t nodeIndex = static_cast<uint32_t>(m_topLevelNodes.size());
+        m_topLevelNodes.push_back({ .aabb = bbNode, .data = { static_cast<uint32_t>(m_topLevelChunks.size()) | Node::LeafBit, static_cast<uint32_t>(chunkIndices.size()) } });
+        m_topLevelChunks.insert(m_topLevelChunks.end(), chunkIndices.begin(), chunkIndices.end());
+        return nodeIndex;
+    }
+
+    // Median split of the chunk centres along the longest axis, as for the per-chunk hierarchies
+    const glm::vec3 extent  = bbNode.upper - bbNode.lower;
+    const int splitAxis     = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    const size_t splitIndex = chunkIndices.size() / 2ULL;
+    std::nth_element(chunkIndices.begin(), chunkIndices.begin() + static_cast<std::span<uint32_t>::difference_type>(splitIndex), chunkIndices.end(), [&](uint32_t lhs, uint32_t rhs) {
+        return m_chunks[lhs].aabb.lower[splitAxis] + m_chunks[lhs].aabb.upper[splitAxis] < m_chunks[rhs].aabb.lower[splitAxis] + m_chunks[rhs].aabb.upper[splitAxis];
+    });
+    const uint32_t leftChildIdx  = constructTopLevel(chunkIndices.subspan(0ULL, splitIndex));
+    const uint32_t rightChildIdx = constructTopLevel(chunkIndices.subspan(splitIndex));
+
+    const uint32_t nodeIndex = static_cast<uint32_t>(m_topLevelNodes.size());
+    m_topLevelNodes.push_back({ .aabb = bbNode, .data = { leftChildIdx, rightChildIdx } });
+    return nodeIndex;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#ifndef _CHUNKED_BVH_H_
+#define _CHUNKED_BVH_H_
+
+#include <framework/mesh.h>
+#include <framework/ray.h>
+#include <ray_tracing/bounding_volume_hierarchy.h>
+#include <ray_tracing/common.h>
+#include <utils/config.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+// Triangle as kept in the node store; tracing only needs positions
+struct StoredTriangle {
+    glm::vec3 v0, v1, v2;
+};
+static_assert(std::is_trivially_copyable_v<StoredTriangle> && sizeof(StoredTriangle) == 36ULL);
+
+// BVH over a mesh which is too large to be held in memory as a whole. Every spatial chunk of triangles gets its own
+// BVH, which is written to an on-disk node store as soon as it has been built. Tracing visits the chunks a ray may hit
+// front to back through a small top-level hierarchy, reading them back in through a least recently used set whose
+// size is bounded by a byte budget
+class ChunkedBVH {
+public:
+    ChunkedBVH(const std::filesystem::path& storePath, uint64_t residentByteBudget, const Config& config);
+
+    // Build the BVH of a chunk and append it to the node store
+    void addChunk(const Mesh& chunkMesh);
+    // Finish the node store and build the top-level hierarchy over all chunks; required before tracing
+    void finalize();
+
+    // Same contract as BoundingVolumeHierarchy::intersect(). Safe to call from multiple threads
+    bool intersect(Ray& ray, HitInfo& hitInfo) const;
+
+    // Getters
+    size_t numChunks() const        { return m_chunks.size(); }
+    uint64_t storeBytes() const     { return m_storeBytes; }
+    uint64_t chunkLoads() const;    // Number of times a chunk had to be read from the node store
+
+private:
+    // Location of a chunk in the node store: numNodes Nodes directly followed by numTriangles StoredTriangles
+    struct ChunkRecord {
+        uint64_t offset;
+        uint32_t numNodes;
+        uint32_t numTriangles;
+        uint32_t rootIdx;
+        AxisAlignedBox aabb;
+    };
+
+    struct ResidentChunk {
+        std::vector<Node> nodes;
+        std::vector<StoredTriangle> triangles;
+        uint32_t rootIdx;
+
+        uint64_t bytes() const { return nodes.size() * sizeof(Node) + triangles.size() * sizeof(StoredTriangle); }
+        bool intersect(Ray& ray, HitInfo& hitInfo) const;
+    };
+
+    struct ResidentSlot {
+        std::shared_ptr<const ResidentChunk> chunk;
+        std::list<uint32_t>::iterator lruPosition;
+    };
+
+    // Fetch a chunk from the resident set, loading it (and evicting others) if needed.
+    // Evicted chunks stay alive for as long as a thread still traces against them
+    std::shared_ptr<const ResidentChunk> acquire(uint32_t chunkIdx) const;
+
+    /**
+     * Recursively construct the top-level hierarchy over the given chunks
+     *
+     * @param chunkIndices Chunks that the node should cover
+     *
+     * @return Index of the constructed node in the top-level node vector
+    */
+    uint32_t constructTopLevel(std::span<uint32_t> chunkIndices);
+
+    const std::filesystem::path m_storePath;
+    const uint64_t m_residentByteBudget;
+    const Config& m_config;
+
+    std::ofstream m_storeWriter;
+    uint64_t m_storeBytes { 0ULL };
+    std::vector<ChunkRecord> m_chunks;
+
+    std::vector<Node> m_topLevelNodes;      // Leaves refer to ranges of m_topLevelChunks rather than primitives
+    std::vector<uint32_t> m_topLevelChunks;
+    uint32_t m_topLevelRootIdx { 0U };
+
+    mutable std::mutex m_mutex;             // Guards everything below
+    mutable std::ifstream m_storeReader;
+    mutable std::vector<ResidentSlot> m_resident;
+    mutable std::list<uint32_t> m_leastRecentlyUsed; // Resident chunk indices, most recently used first
+    mutable uint64_t m_residentBytes { 0ULL };
+    mutable uint64_t m_chunkLoads { 0ULL };
+};
+
+
+#endif // _CHUNKED_BVH_H_
@@ -0,0 +1,58 @@
+#include "inner_distances.h"
+
+#include <framework/ray.h>
+
+#include <utils/constants.h>
+#include <utils/progressbar.hpp>
+
+#include <iostream>
+#include <limits>
+#include <optional>
+
+
+static float traceInnerDistance(const glm::vec3& position, const glm::vec3& normal, const BoundingVolumeHierarchy& bvh) {
+    const glm::vec3 reverseNormal = -normal;
+    Ray interiorRay = {
+        .origin     = position + utils::INTERIOR_RAY_OFFSET * reverseNormal,
+        .direction  = reverseNormal,
+        .t          = std::numeric_limits<float>::max()
+    };
+    HitInfo hitInfo;
+    bvh.intersect(interiorRay, hitInfo);
+    return interiorRay.t;
+}
+
+// Loop shared by both layouts, which only differ in how a single vertex is read and written
+template <typename TraceVertex>
+static void traceAllVertices(size_t numVertices, TraceVertex traceVertex, bool showProgress) {
+    // We have to use an index-based loop WITH A FUCKING SIGNED INT because MSVC OpenMP support is stuck in 2006
+    std::optional<progressbar> progress;
+    if (showProgress) {
+        progress.emplace(static_cast<int32_t>(numVertices));
+        std::cout << "Computing inner distances..." << std::endl;
+    }
+    #pragma omp parallel for
+    for (int32_t vertexIdx = 0; vertexIdx < static_cast<int32_t>(numVertices); vertexIdx++) {
+        traceVertex(vertexIdx);
+        if (progress) {
+            #pragma omp critical
+            progress->update();
+        }
+    }
+    if (showProgress) { std::cout << std::endl << "Finished computing inner distances!" << std::endl; }
+}
+
+void computeInnerDistances(std::span<const glm::vec3> positions, std::span<const glm::vec3> normals, std::span<float> distancesInner,
+                           const BoundingVolumeHierarchy& bvh, bool showProgress) {
+    traceAllVertices(positions.size(), [&](int32_t vertexIdx) {
+        const size_t idx    = static_cast<size_t>(vertexIdx);
+        distancesInner[idx] = traceInnerDistance(positions[idx], normals[idx], bvh);
+    }, showProgress);
+}
+
+void computeInnerDistances(std::span<Vertex> vertices, const BoundingVolumeHierarchy& bvh, bool showProgress) {
+    traceAllVertices(vertices.size(), [&](int32_t vertexIdx) {
+        Vertex& vertex          = vertices[static_cast<size_t>(vertexIdx)];
+        vertex.distanceInner    = traceInnerDistance(vertex.position, vertex.normal, bvh);
+    }, showProgress);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#ifndef _INNER_DISTANCES_H_
+#define _INNER_DISTANCES_H_
+
+#include <framework/mesh.h>
+#include <ray_tracing/bounding_volume_hierarchy.h>
+
+#include <span>
+
+/**
+ * Trace d_N for every vertex: the distance travelled inside the model by a ray leaving the vertex against its normal
+ *
+ * @param positions Vertex positions
+ * @param normals Vertex normals, one per position
+ * @param distancesInner Output distances, one per position; misses are left at the largest float
+ * @param bvh Hierarchy over the model's triangles
+ * @param showProgress Whether to print a progress bar while tracing
+*/
+void computeInnerDistances(std::span<const glm::vec3> positions, std::span<const glm::vec3> normals, std::span<float> distancesInner,
+                           const BoundingVolumeHierarchy& bvh, bool showProgress = true);
+
+// Same as above, reading and writing interleaved vertices
+void computeInnerDistances(std::span<Vertex> vertices, const BoundingVolumeHierarchy& bvh, bool showProgress = true);
+
+
+#endif // _INNER_DISTANCES_H_
@@ -0,0 +1,222 @@
+#include "cache_directory.h"
+
+#include <framework/disable_all_warnings.h>
+// rapidjson stringifies "GCC diagnostic ..." for its own pragmas, which the GCC macro of disable_all_warnings.h turns into "1 diagnostic"
+#pragma push_macro("GCC")
+#undef GCC
+DISABLE_WARNINGS_PUSH()
+#include <cereal/archives/json.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+DISABLE_WARNINGS_POP()
+#pragma pop_macro("GCC")
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+
+static int64_t secondsSinceEpoch() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Temporaries are unique per thread so that concurrent writers never clobber each other's output
+static std::filesystem::path temporaryPathFor(const std::filesystem::path& filePath) {
+    return std::filesystem::path(std::format("{}.{}.tmp", filePath.string(), std::hash<std::thread::id>{}(std::this_thread::get_id())));
+}
+
+CacheDirectory::CacheDirectory(const std::filesystem::path& directory, uint64_t byteBudget)
+    : m_directory(directory)
+    , m_byteBudget(byteBudget) {
+    if (!std::filesystem::exists(m_directory)) { std::filesystem::create_directories(m_directory); }
+    loadIndex();
+}
+
+void CacheDirectory::store(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, const BakeParameters& bake, const FileWriter& writeFile) {
+    // Writing happens outside of the lock; only the rename and bookkeeping need to be serialised
+    const std::filesystem::path temporaryPath = temporaryPathFor(cachePath);
+    {
+        std::scoped_lock lock(m_mutex);
+        m_filesInFlight.insert(temporaryPath.filename().string());
+    }
+    try {
+        writeFile(temporaryPath);
+    } catch (...) {
+        std::scoped_lock lock(m_mutex);
+        m_filesInFlight.erase(temporaryPath.filename().string());
+        std::filesystem::remove(temporaryPath);
+        throw;
+    }
+
+    std::scoped_lock lock(m_mutex);
+    m_filesInFlight.erase(temporaryPath.filename().string());
+    std::filesystem::rename(temporaryPath, cachePath);
+    CacheIndexEntry entry = { .fileName     = cachePath.filename().string(),
+                              .sourcePath   = std::filesystem::absolute(sourcePath).string(),
+                              .sizeBytes    = std::filesystem::file_size(cachePath),
+                              .lastAccess   = secondsSinceEpoch(),
+                              .bake         = bake };
+    auto existing = std::find_if(m_entries.begin(), m_entries.end(), [&](const CacheIndexEntry& other) { return other.fileName == entry.fileName; });
+    if (existing != m_entries.end())    { *existing = std::move(entry); }
+    else                                { m_entries.push_back(std::move(entry)); }
+
+    CacheMaintenanceReport report;
+    evictToBudget(cachePath.filename().string(), report);
+    if (report.filesRemoved > 0ULL) { std::cout << std::format("Evicted {} cache file(s) ({} bytes) to stay within budget", report.filesRemoved, report.bytesFreed) << std::endl; }
+    saveIndex();
+}
+
+void CacheDirectory::touch(const std::filesystem::path& cachePath) {
+    std::error_code error; // Files outside of the directory (e.g. opened explicitly) are not tracked
+    if (!std::filesystem::equivalent(cachePath.parent_path(), m_directory, error)) { return; }
+
+    std::scoped_lock lock(m_mutex);
+    const std::string fileName = cachePath.filename().string();
+    auto entry = std::find_if(m_entries.begin(), m_entries.end(), [&](const CacheIndexEntry& other) { return other.fileName == fileName; });
+    if (entry == m_entries.end()) { return; }
+    entry->lastAccess = secondsSinceEpoch();
+    saveIndex();
+}
+
+void CacheDirectory::setByteBudget(uint64_t byteBudget) {
+    std::scoped_lock lock(m_mutex);
+    m_byteBudget = byteBudget;
+}
+
+uint64_t CacheDirectory::byteBudget() const {
+    std::scoped_lock lock(m_mutex);
+    return m_byteBudget;
+}
+
+uint64_t CacheDirectory::totalBytes() const {
+    std::scoped_lock lock(m_mutex);
+    uint64_t total = 0ULL;
+    for (const CacheIndexEntry& entry : m_entries) { total += entry.sizeBytes; }
+    return total;
+}
+
+CacheMaintenanceReport CacheDirectory::prune() {
+    std::scoped_lock lock(m_mutex);
+    CacheMaintenanceReport report;
+
+    // Index entries whose files disappeared
+    std::erase_if(m_entries, [&](const CacheIndexEntry& entry) { return !std::filesystem::exists(m_directory / entry.fileName); });
+
+    // Files the index does not know about, including temporaries left behind by a crash
+    for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(m_directory)) {
+        const std::string fileName = file.path().filename().string();
+        if (file.is_directory() && file.path().extension() == ".work" && !m_filesInFlight.contains(file.path().stem().string())) {
+            // Scratch directory of a streamed bake (see streaming_bake.h) which did not finish
+            std::error_code error;
+            std::filesystem::remove_all(file.path(), error);
+            report.filesRemoved++;
+            continue;
+        }
+        if (!file.is_regular_file() || fileName == INDEX_FILE_NAME || m_filesInFlight.contains(fileName)) { continue; }
+        const bool indexed = std::any_of(m_entries.begin(), m_entries.end(), [&](const CacheIndexEntry& entry) { return entry.fileName == fileName; });
+        if (indexed) { continue; }
+
+        // Readable caches (e.g. from a lost index) are adopted instead of thrown away
+        if (file.path().extension() == ".cache") {
+            try {
+                MeshCacheView cache(file.path());
+                m_entries.push_back({ .fileName     = fileName,
+                                      .sourcePath   = "",
+                                      .sizeBytes    = file.file_size(),
+                                      .lastAccess   = 0,
+                                      .bake         = cache.header().bake });
+                continue;
+            } catch (const std::runtime_error&) {}
+        }
+        report.filesRemoved++;
+        report.bytesFreed += file.file_size();
+        std::filesystem::remove(file.path());
+    }
+
+    evictToBudget("", report);
+    saveIndex();
+    return finishReport(report);
+}
+
+CacheMaintenanceReport CacheDirectory::verify() {
+    CacheMaintenanceReport report = prune();
+
+    std::scoped_lock lock(m_mutex);
+    for (size_t entryIdx = m_entries.size(); entryIdx-- > 0ULL;) {
+        const std::filesystem::path cachePath = m_directory / m_entries[entryIdx].fileName;
+        bool valid = std::filesystem::file_size(cachePath) == m_entries[entryIdx].sizeBytes;
+        if (valid) {
+            try {
+                MeshCacheView cache(cachePath);
+                if (cache.isEncoded()) { (void) cache.toMesh(); } // Decoding checks the coded triangle stream as well
+            } catch (const std::runtime_error&) {
+                valid = false;
+            }
+        }
+        if (!valid) {
+            std::cout << "Removing corrupt cache file " << cachePath << std::endl;
+            removeEntry(entryIdx, report);
+        }
+    }
+
+    saveIndex();
+    return finishReport(report);
+}
+
+void CacheDirectory::loadIndex() {
+    const std::filesystem::path indexPath = m_directory / INDEX_FILE_NAME;
+    if (!std::filesystem::exists(indexPath)) { return; }
+
+    // A damaged index only costs us the access history, so start afresh rather than fail
+    try {
+        std::ifstream fileStream(indexPath);
+        cereal::JSONInputArchive indexArchive(fileStream);
+        indexArchive(cereal::make_nvp("entries", m_entries));
+    } catch (const cereal::Exception&) {
+        std::cout << "Cache index " << indexPath << " is unreadable, starting a new one" << std::endl;
+        m_entries.clear();
+    }
+}
+
+void CacheDirectory::saveIndex() const {
+    // Same write-then-rename scheme as the cache files themselves
+    const std::filesystem::path indexPath       = m_directory / INDEX_FILE_NAME;
+    const std::filesystem::path temporaryPath   = temporaryPathFor(indexPath);
+    {
+        std::ofstream fileStream(temporaryPath);
+        cereal::JSONOutputArchive indexArchive(fileStream);
+        indexArchive(cereal::make_nvp("entries", m_entries));
+    }
+    std::filesystem::rename(temporaryPath, indexPath);
+}
+
+void CacheDirectory::evictToBudget(const std::string& keepFileName, CacheMaintenanceReport& report) {
+    uint64_t total = 0ULL;
+    for (const CacheIndexEntry& entry : m_entries) { total += entry.sizeBytes; }
+
+    // Least recently used first; the entry that was just written always survives
+    std::sort(m_entries.begin(), m_entries.end(), [](const CacheIndexEntry& lhs, const CacheIndexEntry& rhs) { return lhs.lastAccess > rhs.lastAccess; });
+    for (size_t entryIdx = m_entries.size(); entryIdx-- > 0ULL && total > m_byteBudget;) {
+        if (m_entries[entryIdx].fileName == keepFileName) { continue; }
+        total -= m_entries[entryIdx].sizeBytes;
+        removeEntry(entryIdx, report);
+    }
+}
+
+void CacheDirectory::removeEntry(size_t entryIdx, CacheMaintenanceReport& report) {
+    std::error_code error; // Files may already be gone, which is fine
+    std::filesystem::remove(m_directory / m_entries[entryIdx].fileName, error);
+    report.filesRemoved++;
+    report.bytesFreed += m_entries[entryIdx].sizeBytes;
+    m_entries.erase(m_entries.begin() + static_cast<std::ptrdiff_t>(entryIdx));
+}
+
+CacheMaintenanceReport CacheDirectory::finishReport(CacheMaintenanceReport report) const {
+    report.filesRemaining = m_entries.size();
+    report.bytesRemaining = 0ULL;
+    for (const CacheIndexEntry& entry : m_entries) { report.bytesRemaining += entry.sizeBytes; }
+    return report;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef _CACHE_DIRECTORY_H_
+#define _CACHE_DIRECTORY_H_
+
+#include <render/mesh_cache.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Bookkeeping for a single file in the cache directory
+struct CacheIndexEntry {
+    std::string fileName;
+    std::string sourcePath;
+    uint64_t sizeBytes;
+    int64_t lastAccess;     // Seconds since the UNIX epoch
+    BakeParameters bake;
+
+    template<class Archive>
+    void serialize(Archive& ar) { ar(CEREAL_NVP(fileName), CEREAL_NVP(sourcePath), CEREAL_NVP(sizeBytes), CEREAL_NVP(lastAccess), CEREAL_NVP(bake)); }
+};
+
+struct CacheMaintenanceReport {
+    size_t filesRemoved     { 0ULL };
+    uint64_t bytesFreed     { 0ULL };
+    size_t filesRemaining   { 0ULL };
+    uint64_t bytesRemaining { 0ULL };
+};
+
+// Owns the cache directory: keeps an index of its contents, publishes new cache files atomically
+// and evicts the least recently used entries once the directory exceeds its byte budget.
+// All public methods are safe to call from multiple threads
+class CacheDirectory {
+public:
+    CacheDirectory(const std::filesystem::path& directory, uint64_t byteBudget);
+
+    using FileWriter = std::function<void(const std::filesystem::path& filePath)>;
+
+    /**
+     * Publish a cache file. The writer produces the file under a temporary name which is then renamed
+     * into place, so a crash mid-write never leaves a truncated cache behind
+     * 
+     * @param cachePath Final location of the cache file (must lie inside the cache directory)
+     * @param sourcePath Model file the cache was generated from
+     * @param bake Parameters the cache was generated with
+     * @param writeFile Callback writing the full cache file to the path it is given
+    */
+    void store(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, const BakeParameters& bake, const FileWriter& writeFile);
+
+    // Mark a cache file as used so that it is evicted last
+    void touch(const std::filesystem::path& cachePath);
+
+    void setByteBudget(uint64_t byteBudget);
+    uint64_t byteBudget() const;
+    uint64_t totalBytes() const;
+
+    // Drop index entries without files, delete unknown files (e.g. leftover temporaries) and enforce the budget
+    CacheMaintenanceReport prune();
+    // Additionally open every cache file and delete those that are truncated or unreadable
+    CacheMaintenanceReport verify();
+
+    static constexpr char INDEX_FILE_NAME[] = "index.json";
+
+private:
+    void loadIndex();
+    void saveIndex() const;
+    void evictToBudget(const std::string& keepFileName, CacheMaintenanceReport& report);
+    void removeEntry(size_t entryIdx, CacheMaintenanceReport& report);
+    CacheMaintenanceReport finishReport(CacheMaintenanceReport report) const;
+
+    const std::filesystem::path m_directory;
+    uint64_t m_byteBudget;
+    std::vector<CacheIndexEntry> m_entries;
+    std::set<std::string> m_filesInFlight;  // Temporaries currently being written, which pruning must leave alone
+    mutable std::mutex m_mutex;
+};
+
+
+#endif // _CACHE_DIRECTORY_H_
@@ -0,0 +1,63 @@
+#include "cache_writer.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+CacheWriter::CacheWriter(CacheDirectory& cacheDirectory, size_t maxQueuedJobs)
+    : m_cacheDirectory(cacheDirectory)
+    , m_maxQueuedJobs(std::max(maxQueuedJobs, size_t(1ULL)))
+    , m_thread(&CacheWriter::run, this) {}
+
+CacheWriter::~CacheWriter() {
+    flush();
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobAvailable.notify_all();
+    m_thread.join();
+}
+
+void CacheWriter::enqueue(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath,
+                          const CacheHeader& header, std::shared_ptr<const Mesh> mesh,
+                          std::vector<MeshLod> lods, std::vector<Meshlet> meshlets) {
+    std::unique_lock lock(m_mutex);
+    m_jobFinished.wait(lock, [&] { return m_jobs.size() < m_maxQueuedJobs; });
+    m_jobs.push_back({ .cachePath = cachePath, .sourcePath = sourcePath, .header = header, .mesh = std::move(mesh), .lods = std::move(lods), .meshlets = std::move(meshlets) });
+    lock.unlock();
+    m_jobAvailable.notify_one();
+}
+
+bool CacheWriter::isPending(const std::filesystem::path& cachePath) const {
+    std::scoped_lock lock(m_mutex);
+    return std::any_of(m_jobs.begin(), m_jobs.end(), [&](const Job& job) { return job.cachePath == cachePath; });
+}
+
+void CacheWriter::flush() {
+    std::unique_lock lock(m_mutex);
+    m_jobFinished.wait(lock, [&] { return m_jobs.empty(); });
+}
+
+void CacheWriter::run() {
+    std::unique_lock lock(m_mutex);
+    while (true) {
+        m_jobAvailable.wait(lock, [&] { return m_stopping || !m_jobs.empty(); });
+        if (m_jobs.empty()) { return; } // Only reached when stopping with nothing left to do
+
+        // Leave the job in the queue while writing so that isPending() and flush() account for it
+        // (references to deque elements survive insertions at the back)
+        const Job& job = m_jobs.front();
+        lock.unlock();
+        try {
+            m_cacheDirectory.store(job.cachePath, job.sourcePath, job.header.bake,
+                                   [&](const std::filesystem::path& writePath) { writeMeshCache(writePath, job.header, *job.mesh, job.lods, job.meshlets); });
+            std::cout << "Saved cache file " << job.cachePath << std::endl;
+        } catch (const std::exception& error) {
+            std::cerr << "Failed to write cache file " << job.cachePath << ": " << error.what() << std::endl;
+        }
+        lock.lock();
+        m_jobs.pop_front();
+        m_jobFinished.notify_all();
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef _CACHE_WRITER_H_
+#define _CACHE_WRITER_H_
+
+#include <render/cache_directory.h>
+#include <render/mesh_cache.h>
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Writes cache files on a background thread so that serialisation stays off the load critical path.
+// Jobs hold an immutable snapshot of the mesh, so callers are free to carry on with their own copy
+class CacheWriter {
+public:
+    CacheWriter(CacheDirectory& cacheDirectory, size_t maxQueuedJobs);
+    CacheWriter(const CacheWriter&) = delete;
+    // Flushes all outstanding jobs before returning, so no cache is lost on exit
+    ~CacheWriter();
+
+    CacheWriter& operator=(const CacheWriter&) = delete;
+
+    // Queue a cache file for writing. Blocks while the queue is full
+    void enqueue(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath,
+                 const CacheHeader& header, std::shared_ptr<const Mesh> mesh,
+                 std::vector<MeshLod> lods = {}, std::vector<Meshlet> meshlets = {});
+
+    // Whether a write to the given cache file is queued or in progress
+    bool isPending(const std::filesystem::path& cachePath) const;
+
+    // Block until every queued job has been written
+    void flush();
+
+private:
+    struct Job {
+        std::filesystem::path cachePath;
+        std::filesystem::path sourcePath;
+        CacheHeader header;
+        std::shared_ptr<const Mesh> mesh;
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+    };
+
+    void run();
+
+    CacheDirectory& m_cacheDirectory;
+    const size_t m_maxQueuedJobs;
+
+    std::deque<Job> m_jobs;                 // Front job stays queued while it is being written
+    bool m_stopping { false };
+    mutable std::mutex m_mutex;
+    std::condition_variable m_jobAvailable; // Signalled when a job is queued or the writer shuts down
+    std::condition_variable m_jobFinished;  // Signalled when a job completes, freeing a queue slot
+    std::thread m_thread;
+};
+
+
+#endif // _CACHE_WRITER_H_
@@ -0,0 +1,56 @@
+#include "dispersion_benchmark.h"
+
+#include <utils/magic_enum.hpp>
+
+#include <algorithm>
+#include <format>
+#include <iostream>
+
+
+static constexpr size_t SAMPLES_PER_MODE    = 60ULL;
+static constexpr int SAMPLES_AFTER_CHANGE   = 4;    // At least the number of frames a GpuTimer can have in flight
+
+
+DispersionBenchmark::DispersionBenchmark(Config& config)
+    : m_config(config) {}
+
+void DispersionBenchmark::start() {
+    if (running()) { return; }
+    m_configured = m_config.dispersion;
+    m_results.fill(std::nullopt);
+    beginMode(0ULL);
+}
+
+void DispersionBenchmark::beginMode(size_t mode) {
+    m_mode              = mode;
+    m_config.dispersion = static_cast<Dispersion>(mode);
+    m_samples.clear();
+    m_samplesToSkip     = SAMPLES_AFTER_CHANGE;
+}
+
+void DispersionBenchmark::update(double gpuMilliseconds) {
+    if (!running()) { return; }
+    if (m_samplesToSkip > 0) {
+        m_samplesToSkip--;
+        return;
+    }
+    m_samples.push_back(gpuMilliseconds);
+    if (m_samples.size() < SAMPLES_PER_MODE) { return; }
+
+    // The median ignores the occasional frame held up by something else, e.g. the driver or the compositor
+    const auto median = m_samples.begin() + static_cast<ptrdiff_t>(m_samples.size() / 2ULL);
+    std::nth_element(m_samples.begin(), median, m_samples.end());
+    m_results[*m_mode] = *median;
+    if (*m_mode + 1ULL < NUM_MODES) {
+        beginMode(*m_mode + 1ULL);
+        return;
+    }
+
+    // Relative to the monochrome path
+    m_mode.reset();
+    m_config.dispersion = m_configured;
+    for (size_t mode = 0ULL; mode < NUM_MODES; mode++) {
+        std::cout << std::format("{:<20}{:>8.3f} ms{:>8.2f}x", magic_enum::enum_name(static_cast<Dispersion>(mode)), *m_results[mode],
+                                 *m_results[mode] / *m_results[0]) << std::endl;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef _DISPERSION_BENCHMARK_H_
+#define _DISPERSION_BENCHMARK_H_
+
+#include <utils/config.h>
+
+#include <array>
+#include <optional>
+#include <vector>
+
+// Times the refraction passes with every dispersion mode in turn, on the scene and settings currently shown.
+// Each mode is rendered for a number of frames and its median GPU time is kept; the configured mode is restored afterwards
+class DispersionBenchmark {
+public:
+    static constexpr size_t NUM_MODES = 3ULL;
+
+    DispersionBenchmark(Config& config);
+
+    void start();
+    // Every frame needs rendering while running, even if nothing else changed
+    bool running() const { return m_mode.has_value(); }
+    // Feed the GPU time of a rendered frame
+    void update(double gpuMilliseconds);
+
+    // Median GPU time per mode, indexed by Dispersion, of the last run that completed
+    const std::array<std::optional<double>, NUM_MODES>& results() const { return m_results; }
+
+private:
+    void beginMode(size_t mode);
+
+    Config& m_config;
+
+    Dispersion m_configured { Dispersion::None };
+    std::optional<size_t> m_mode;   // Mode being measured, if running
+    std::vector<double> m_samples;
+    int m_samplesToSkip { 0 };      // Measurements still in flight when the mode changed describe the previous one
+    std::array<std::optional<double>, NUM_MODES> m_results;
+};
+
+
+#endif // _DISPERSION_BENCHMARK_H_
@@ -0,0 +1,47 @@
+#include "dynamic_resolution.h"
+
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <algorithm>
+#include <cmath>
+
+
+static constexpr float SCALE_STEP           = 0.05f;    // Scales are quantised, so that render targets are only reallocated for changes worth making
+static constexpr double TARGET_LOAD         = 0.9;      // Fraction of the budget a new scale aims for
+static constexpr double INCREASE_THRESHOLD  = 0.75;     // The scale only grows once frames take less than this fraction of the budget
+static constexpr double SMOOTHING           = 0.2;      // Weight of the newest measurement in the running average
+static constexpr int SAMPLES_AFTER_CHANGE   = 4;        // At least the number of frames a GpuTimer can have in flight
+
+
+DynamicResolution::DynamicResolution(const Config& config)
+    : m_config(config) {}
+
+glm::ivec2 DynamicResolution::renderDims(glm::ivec2 windowDims) const {
+    return glm::max(glm::ivec2(glm::round(glm::vec2(windowDims) * scale())), glm::ivec2(1));
+}
+
+void DynamicResolution::update(double gpuMilliseconds) {
+    if (!m_config.dynamicResolution) {
+        m_scale = 1.0f;
+        m_smoothedMilliseconds.reset();
+        return;
+    }
+    if (m_samplesToSkip > 0) {
+        m_samplesToSkip--;
+        return;
+    }
+    m_smoothedMilliseconds = m_smoothedMilliseconds ? SMOOTHING * gpuMilliseconds + (1.0 - SMOOTHING) * *m_smoothedMilliseconds : gpuMilliseconds;
+
+    // GPU time grows with the number of pixels, and hence with the square of the scale
+    const double budget = m_config.frameBudgetMs;
+    if (*m_smoothedMilliseconds <= budget && *m_smoothedMilliseconds >= budget * INCREASE_THRESHOLD) { return; }
+    const float minScale    = std::clamp(m_config.minResolutionScale, SCALE_STEP, 1.0f);
+    const float idealScale  = m_scale * static_cast<float>(std::sqrt(budget * TARGET_LOAD / std::max(*m_smoothedMilliseconds, 1e-3)));
+    const float newScale    = std::clamp(std::round(idealScale / SCALE_STEP) * SCALE_STEP, minScale, 1.0f);
+    if (newScale == m_scale) { return; }
+    m_scale = newScale;
+    m_smoothedMilliseconds.reset();
+    m_samplesToSkip = SAMPLES_AFTER_CHANGE;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef _DYNAMIC_RESOLUTION_H_
+#define _DYNAMIC_RESOLUTION_H_
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec2.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <utils/config.h>
+
+#include <optional>
+
+// Picks the resolution the scene is rendered at, relative to the window, so that its GPU time stays within the configured budget
+class DynamicResolution {
+public:
+    DynamicResolution(const Config& config);
+
+    // Fraction of the window's width and height that is rendered; always one while disabled
+    float scale() const { return m_config.dynamicResolution ? m_scale : 1.0f; }
+    glm::ivec2 renderDims(glm::ivec2 windowDims) const;
+
+    // Feed the GPU time of a rendered frame
+    void update(double gpuMilliseconds);
+
+private:
+    const Config& m_config;
+
+    float m_scale { 1.0f };
+    std::optional<double> m_smoothedMilliseconds;
+    int m_samplesToSkip { 0 };  // Measurements still in flight when the scale changed describe the previous one
+};
+
+
+#endif // _DYNAMIC_RESOLUTION_H_
@@ -6,6 +6,8 @@ DISABLE_WARNINGS_PUSH()
 DISABLE_WARNINGS_POP()
 #include <stb/stb_image.h>
 
+#include <framework/gl_state.h>
+
 #include <utils/constants.h>
 
 #include <array>
@@ -23,24 +25,23 @@ EnvironmentMap::~EnvironmentMap() {
     glDeleteBuffers(1, &m_cubeVBO);
 }
 
-void EnvironmentMap::render(const glm::mat4& projection, const glm::vec3 cameraForward, const glm::vec3& cameraUp) {
+void EnvironmentMap::render(const glm::mat4& projection, const glm::vec3 cameraForward, const glm::vec3& cameraUp, GLuint outputFramebuffer) {
     // Compute MVP (no model component)
     glm::mat4 view              = glm::lookAt(glm::vec3(0.0f), cameraForward, cameraUp); // View matrix at the center of the scene (0, 0, 0)
     glm::mat4 viewProjection    = projection * view;
 
-    // Bind on-screen framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Bind output framebuffer
+    gl_state::bindFramebuffer(outputFramebuffer);
     
     // Bind shader and set uniforms
     m_renderCubeMap.bind();
     glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(viewProjection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemapTex);
+    gl_state::bindTextureUnit(0, m_cubemapTex);
     glUniform1i(1, 0);
 
     // Draw unit cube without writing to depth buffer so everything else can render on top of the map
     glDepthMask(GL_FALSE);
-    glBindVertexArray(m_cubeVAO);
+    gl_state::bindVertexArray(m_cubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, NUM_CUBE_TRIANGLES * 3); // 3 vertices per triangle
     glDepthMask(GL_TRUE);
 }
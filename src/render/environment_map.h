@@ -23,7 +23,7 @@ public:
     EnvironmentMap(const EnvMapFilePaths& texPaths);
     ~EnvironmentMap();
 
-    void render(const glm::mat4& projection, const glm::vec3 cameraForward, const glm::vec3& cameraUp);
+    void render(const glm::mat4& projection, const glm::vec3 cameraForward, const glm::vec3& cameraUp, GLuint outputFramebuffer = 0);
 
     GLuint getTexId() { return m_cubemapTex; }
 
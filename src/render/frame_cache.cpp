@@ -0,0 +1,51 @@
+#include "frame_cache.h"
+
+#include <array>
+
+
+FrameCache::FrameCache(glm::ivec2 renderDims)
+    : m_renderDims(renderDims) {
+    initTexturesAndFramebuffer();
+}
+
+FrameCache::~FrameCache() {
+    freeTexturesAndFramebuffer();
+}
+
+void FrameCache::resize(glm::ivec2 renderDims) {
+    if (renderDims == m_renderDims) { return; }
+    freeTexturesAndFramebuffer();
+    m_renderDims = renderDims;
+    initTexturesAndFramebuffer();
+    m_cachedInputs.reset();
+}
+
+bool FrameCache::needsRedraw(const FrameInputs& inputs) {
+    if (m_cachedInputs == inputs) { return false; }
+    m_cachedInputs = inputs;
+    return true;
+}
+
+void FrameCache::present(glm::ivec2 windowDims) const {
+    glBlitNamedFramebuffer(m_framebuffer, 0,
+                           0, 0, m_renderDims.x, m_renderDims.y,
+                           0, 0, windowDims.x, windowDims.y,
+                           GL_COLOR_BUFFER_BIT, m_renderDims == windowDims ? GL_NEAREST : GL_LINEAR);
+}
+
+void FrameCache::initTexturesAndFramebuffer() {
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_colorTex);
+    glTextureStorage2D(m_colorTex, 1, GL_RGBA8, m_renderDims.x, m_renderDims.y);
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_depthTex);
+    glTextureStorage2D(m_depthTex, 1, GL_DEPTH_COMPONENT32F, m_renderDims.x, m_renderDims.y);
+
+    glCreateFramebuffers(1, &m_framebuffer);
+    glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_colorTex, 0);
+    glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, m_depthTex, 0);
+}
+
+void FrameCache::freeTexturesAndFramebuffer() {
+    glDeleteFramebuffers(1, &m_framebuffer);
+    std::array<GLuint, 2> textures = { m_colorTex, m_depthTex };
+    glDeleteTextures(textures.size(), textures.data());
+}
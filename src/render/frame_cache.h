@@ -0,0 +1,59 @@
+#pragma once
+#ifndef _FRAME_CACHE_H_
+#define _FRAME_CACHE_H_
+
+#include <framework/opengl_includes.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <utils/config.h>
+
+#include <cstdint>
+#include <optional>
+
+// Everything the rendered scene depends on; the UI is drawn on top of it every frame regardless
+struct FrameInputs {
+    glm::mat4 view, projection;
+    glm::ivec2 renderDims;
+    Config config;
+    uint64_t meshVersion;
+
+    [[nodiscard]] bool operator==(const FrameInputs&) const = default;
+};
+
+// Offscreen copy of the last rendered scene, so that frames in which nothing changed only have to present it again
+class FrameCache {
+public:
+    FrameCache(glm::ivec2 renderDims);
+    ~FrameCache();
+
+    // Reallocate the cached frame; its contents are lost
+    void resize(glm::ivec2 renderDims);
+
+    // Whether the scene differs from the cached one and has to be rendered again. Remembers the given inputs as the cached ones
+    bool needsRedraw(const FrameInputs& inputs);
+
+    // Inputs of the cached scene, if any
+    const std::optional<FrameInputs>& cachedInputs() const { return m_cachedInputs; }
+
+    // Framebuffer to render the scene into
+    GLuint framebuffer() const { return m_framebuffer; }
+
+    // Copy the cached scene to the screen, scaling it up if it was rendered at a lower resolution
+    void present(glm::ivec2 windowDims) const;
+
+private:
+    void initTexturesAndFramebuffer();
+    void freeTexturesAndFramebuffer();
+
+    glm::ivec2 m_renderDims;
+    std::optional<FrameInputs> m_cachedInputs;
+
+    GLuint m_colorTex, m_depthTex;
+    GLuint m_framebuffer;
+};
+
+
+#endif // _FRAME_CACHE_H_
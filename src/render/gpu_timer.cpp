@@ -0,0 +1,47 @@
+#include "gpu_timer.h"
+
+
+GpuTimer::GpuTimer() {
+    glCreateQueries(GL_TIME_ELAPSED, NUM_QUERIES, m_queries.data());
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(NUM_QUERIES, m_queries.data());
+}
+
+void GpuTimer::begin() {
+    // Only once every query is in flight does reusing the oldest one have to wait for it
+    collect(false);
+    if (m_pending[m_next]) { collect(true); }
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+}
+
+void GpuTimer::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+    m_pending[m_next]   = true;
+    m_next              = (m_next + 1ULL) % NUM_QUERIES;
+}
+
+std::optional<double> GpuTimer::takeNewMilliseconds() {
+    if (!m_lastIsNew) { return std::nullopt; }
+    m_lastIsNew = false;
+    return m_lastMilliseconds;
+}
+
+void GpuTimer::collect(bool wait) {
+    // Queries complete in the order they were issued, so stop at the first one that is still running
+    for (size_t offset = 0ULL; offset < NUM_QUERIES; offset++) {
+        const size_t queryIdx = (m_next + offset) % NUM_QUERIES;
+        if (!m_pending[queryIdx]) { continue; }
+        GLint available = GL_FALSE;
+        if (!wait) { glGetQueryObjectiv(m_queries[queryIdx], GL_QUERY_RESULT_AVAILABLE, &available); }
+        if (!wait && available == GL_FALSE) { return; }
+
+        GLuint64 nanoseconds;
+        glGetQueryObjectui64v(m_queries[queryIdx], GL_QUERY_RESULT, &nanoseconds);
+        m_lastMilliseconds  = static_cast<double>(nanoseconds) * 1e-6;
+        m_lastIsNew         = true;
+        m_pending[queryIdx] = false;
+        if (wait) { return; }
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef _GPU_TIMER_H_
+#define _GPU_TIMER_H_
+
+#include <framework/opengl_includes.h>
+
+#include <array>
+#include <optional>
+
+// Measures the GPU time spent between begin() and end() without stalling the pipeline: every measurement
+// uses a query of its own, which is only read back once the GPU has finished it a few frames later
+class GpuTimer {
+public:
+    GpuTimer();
+    ~GpuTimer();
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void begin();
+    void end();
+
+    // Duration of the most recent measurement that has completed, if any
+    std::optional<double> lastMilliseconds() const { return m_lastMilliseconds; }
+    // Same, but only once per measurement
+    std::optional<double> takeNewMilliseconds();
+
+private:
+    void collect(bool wait);
+
+    static constexpr size_t NUM_QUERIES = 4ULL;
+
+    std::array<GLuint, NUM_QUERIES> m_queries;
+    std::array<bool, NUM_QUERIES> m_pending {};
+    size_t m_next { 0ULL };     // Query the next measurement uses; also the oldest one that may still be pending
+    std::optional<double> m_lastMilliseconds;
+    bool m_lastIsNew { false };
+};
+
+
+#endif // _GPU_TIMER_H_
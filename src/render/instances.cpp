@@ -0,0 +1,45 @@
+#include "instances.h"
+
+DISABLE_WARNINGS_PUSH()
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+
+static constexpr float CELL_FILL            = 0.8f;     // Fraction of a grid cell's width the unit-sized model spans
+static constexpr float IOR_STEP             = 0.05f;    // Increase of the refractive index ratio from one object on a shelf to the next
+static constexpr float MAX_IOR_RATIO        = 2.0f;
+static constexpr std::array<glm::vec3, 4> SHELF_TINTS = {{ { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.85f, 0.85f }, { 0.85f, 1.0f, 0.9f }, { 0.85f, 0.9f, 1.0f } }};
+
+
+std::vector<MeshInstance> makeInstanceGrid(const Config& config) {
+    const int count = std::max(config.numInstances, 1);
+    if (count == 1) { return { { .model = glm::mat4(1.0f), .refractiveIndexRatio = config.refractiveIndexRatio, .transparency = config.transparency } }; }
+
+    // Square grid in the XY plane, filling the unit square, so that the whole scene still fits the unit sphere
+    const int side          = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+    const float cellSize    = 2.0f / static_cast<float>(side);
+    const float scale       = CELL_FILL * 0.5f * cellSize / std::sqrt(2.0f);
+    std::vector<MeshInstance> instances;
+    instances.reserve(static_cast<size_t>(count));
+    for (int instanceIdx = 0; instanceIdx < count; instanceIdx++) {
+        const int column        = instanceIdx % side;
+        const int shelf         = instanceIdx / side;
+        const glm::vec3 center  = { -1.0f + cellSize * (static_cast<float>(column) + 0.5f), 1.0f - cellSize * (static_cast<float>(shelf) + 0.5f), 0.0f };
+        instances.push_back({ .model                = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(scale)),
+                              .refractiveIndexRatio = std::min(config.refractiveIndexRatio + IOR_STEP * static_cast<float>(column), MAX_IOR_RATIO),
+                              .transparency         = config.transparency * SHELF_TINTS[static_cast<size_t>(shelf) % SHELF_TINTS.size()] });
+    }
+    return instances;
+}
+
+GPUInstance toGPUInstance(const MeshInstance& instance) {
+    return { .model                 = instance.model,
+             .normalModel           = glm::mat4(glm::inverseTranspose(glm::mat3(instance.model))),
+             .transparency          = instance.transparency,
+             .refractiveIndexRatio  = instance.refractiveIndexRatio };
+}
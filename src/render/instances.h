@@ -0,0 +1,40 @@
+#pragma once
+#ifndef _INSTANCES_H_
+#define _INSTANCES_H_
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <utils/config.h>
+
+#include <vector>
+
+// Placement and material of one copy of the loaded mesh
+struct MeshInstance {
+    glm::mat4 model;
+    float refractiveIndexRatio;
+    glm::vec3 transparency;
+};
+
+// Mirrors the std430 layout of an element of the Instances storage block
+struct GPUInstance {
+    glm::mat4 model;
+    glm::mat4 normalModel;      // Only the upper 3x3 is used
+    glm::vec3 transparency;
+    float refractiveIndexRatio;
+};
+
+/**
+ * Lay out config.numInstances copies of the mesh on a square grid of shelves that, like a single loaded model, fits the unit sphere.
+ * The refractive index ratio increases along every shelf and the shelves alternate between tints of the configured transparency,
+ * so that neighbouring objects look like different kinds of glass. A single instance is the model as loaded, with the configured material
+*/
+std::vector<MeshInstance> makeInstanceGrid(const Config& config);
+
+GPUInstance toGPUInstance(const MeshInstance& instance);
+
+
+#endif // _INSTANCES_H_
@@ -0,0 +1,74 @@
+#include "layout_benchmark.h"
+
+#include <framework/mesh.h>
+
+#include <ray_tracing/bounding_volume_hierarchy.h>
+#include <ray_tracing/inner_distances.h>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <string_view>
+
+
+static constexpr int BENCHMARK_REPEATS          = 10;
+static constexpr int TRACE_REPEATS              = 3;
+static constexpr size_t TRACED_VERTICES         = 1ULL << 16ULL;
+
+// Fastest of several runs in milliseconds; setup() runs untimed before every run
+template <typename Setup, typename Pass>
+static double fastestRun(Setup setup, Pass pass, int repeats = BENCHMARK_REPEATS) {
+    double fastest = std::numeric_limits<double>::max();
+    for (int run = 0; run < repeats; run++) {
+        setup();
+        const auto start    = std::chrono::steady_clock::now();
+        pass();
+        fastest             = std::min(fastest, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return fastest;
+}
+
+static void printResult(std::string_view pass, double interleavedMilliseconds, double separateMilliseconds) {
+    std::cout << std::format("{:<24}{:>12.2f}{:>12.2f}{:>9.2f}x", pass, interleavedMilliseconds, separateMilliseconds,
+                             interleavedMilliseconds / separateMilliseconds) << std::endl;
+}
+
+void benchmarkMeshLayouts(const std::filesystem::path& modelPath, const Config& config) {
+    std::cout << "Loading model file " << modelPath << std::endl;
+    const Mesh original             = loadMesh(modelPath, true, config.parallelObjParsing)[0];
+    const MeshSoA originalSoA       = meshToSoA(original);
+    std::cout << std::format("{} vertices, {} triangles, best of {} runs", original.vertices.size(), original.triangles.size(), BENCHMARK_REPEATS) << std::endl;
+
+    // Conversions, which only pay off if the passes run on separate arrays save more than they cost
+    MeshSoA convertedSoA;
+    Mesh converted;
+    const double toSoA              = fastestRun([&] { convertedSoA = {}; }, [&] { convertedSoA = meshToSoA(original); });
+    const double fromSoA            = fastestRun([&] { converted = {}; }, [&] { converted = meshFromSoA(originalSoA); });
+    std::cout << std::format("Mesh -> MeshSoA {:.2f} ms, MeshSoA -> Mesh {:.2f} ms", toSoA, fromSoA) << std::endl;
+
+    std::cout << std::format("{:<24}{:>12}{:>12}{:>10}", "Pass (ms)", "Mesh", "MeshSoA", "Speedup") << std::endl;
+    Mesh mesh;
+    MeshSoA meshSoA;
+    const auto resetMesh            = [&] { mesh = original; };
+    const auto resetMeshSoA         = [&] { meshSoA = originalSoA; };
+    printResult("Flip X", fastestRun(resetMesh, [&] { meshFlipX(mesh); }), fastestRun(resetMeshSoA, [&] { meshFlipX(meshSoA); }));
+    printResult("Flip Y", fastestRun(resetMesh, [&] { meshFlipY(mesh); }), fastestRun(resetMeshSoA, [&] { meshFlipY(meshSoA); }));
+    printResult("Flip Z", fastestRun(resetMesh, [&] { meshFlipZ(mesh); }), fastestRun(resetMeshSoA, [&] { meshFlipZ(meshSoA); }));
+    printResult("Center and scale",
+                fastestRun(resetMesh, [&] { meshCenterAndScaleToUnit(std::span(&mesh, 1ULL)); }),
+                fastestRun(resetMeshSoA, [&] { meshCenterAndScaleToUnit(std::span(&meshSoA, 1ULL)); }));
+
+    // Tracing is dominated by the BVH traversal, which is the same for both layouts
+    const BoundingVolumeHierarchy bvh(original, config);
+    const size_t tracedVertices     = std::min(TRACED_VERTICES, original.vertices.size());
+    printResult(std::format("Trace d_N ({} verts)", tracedVertices),
+                fastestRun(resetMesh, [&] { computeInnerDistances(std::span(mesh.vertices).first(tracedVertices), bvh, false); }, TRACE_REPEATS),
+                fastestRun(resetMeshSoA, [&] {
+                    computeInnerDistances(std::span<const glm::vec3>(meshSoA.positions).first(tracedVertices),
+                                          std::span<const glm::vec3>(meshSoA.normals).first(tracedVertices),
+                                          std::span(meshSoA.distancesInner).first(tracedVertices), bvh, false);
+                }, TRACE_REPEATS));
+}
@@ -0,0 +1,20 @@
+#pragma once
+#ifndef _LAYOUT_BENCHMARK_H_
+#define _LAYOUT_BENCHMARK_H_
+
+#include <utils/config.h>
+
+#include <filesystem>
+
+/**
+ * Time the CPU-side mesh passes on interleaved vertices (Mesh) against separate attribute arrays (MeshSoA) and print the results.
+ * Covers conversion between the two, axis flips, normalisation and the d_N tracing loop. Each pass is repeated and the fastest
+ * run is reported; tracing covers a prefix of the vertices only, as a full bake would dominate the runtime
+ *
+ * @param modelPath Model to benchmark on
+ * @param config Config to build the BVH with
+*/
+void benchmarkMeshLayouts(const std::filesystem::path& modelPath, const Config& config);
+
+
+#endif // _LAYOUT_BENCHMARK_H_
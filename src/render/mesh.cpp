@@ -1,8 +1,18 @@
 #include "mesh.h"
+#include <framework/gl_state.h>
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
+void MeshletDrawList::clear()
+{
+    commands.clear();
+    totalMeshlets = 0;
+    visibleMeshlets = 0;
+    visibleTriangles = 0;
+}
+
 GPUMaterial::GPUMaterial(const Material& material) :
     kd(material.kd),
     ks(material.ks),
@@ -10,22 +20,31 @@ GPUMaterial::GPUMaterial(const Material& material) :
     transparency(material.transparency)
 {}
 
-GPUMesh::GPUMesh(const Mesh& cpuMesh)
+GPUMesh::GPUMesh(const Mesh& cpuMesh, std::span<const MeshLod> lods, std::span<const Meshlet> meshlets)
+    : GPUMesh(cpuMesh.vertices, cpuMesh.triangles, cpuMesh.material, lods, meshlets)
+{
+}
+
+GPUMesh::GPUMesh(std::span<const Vertex> vertices, std::span<const glm::uvec3> triangles, const Material& material,
+                 std::span<const MeshLod> lods, std::span<const Meshlet> meshlets)
 {
     // Create uniform buffer to store mesh material (https://learnopengl.com/Advanced-OpenGL/Advanced-GLSL)
-    GPUMaterial gpuMaterial(cpuMesh.material);
+    GPUMaterial gpuMaterial(material);
     glCreateBuffers(1, &m_uboMaterial);
     glNamedBufferData(m_uboMaterial, sizeof(GPUMaterial), &gpuMaterial, GL_STATIC_DRAW);
 
+    // Indirect draw commands are written by the CPU every frame
+    glCreateBuffers(1, &m_indirectBuffer);
+
     // Figure out if this mesh has texture coordinates
-    m_hasTextureCoords = static_cast<bool>(cpuMesh.material.kdTexture);
+    m_hasTextureCoords = static_cast<bool>(material.kdTexture);
 
     // Create Element(/Index) Buffer Objects and Vertex Buffer Object.
     glCreateBuffers(1, &m_ibo);
-    glNamedBufferStorage(m_ibo, static_cast<GLsizeiptr>(cpuMesh.triangles.size() * sizeof(decltype(cpuMesh.triangles)::value_type)), cpuMesh.triangles.data(), 0);
+    glNamedBufferStorage(m_ibo, static_cast<GLsizeiptr>(triangles.size_bytes()), triangles.data(), 0);
 
     glCreateBuffers(1, &m_vbo);
-    glNamedBufferStorage(m_vbo, static_cast<GLsizeiptr>(cpuMesh.vertices.size() * sizeof(decltype(cpuMesh.vertices)::value_type)), cpuMesh.vertices.data(), 0);
+    glNamedBufferStorage(m_vbo, static_cast<GLsizeiptr>(vertices.size_bytes()), vertices.data(), 0);
 
     // Bind vertex data to shader inputs using their index (location).
     // These bindings are stored in the Vertex Array Object.
@@ -53,8 +72,22 @@ GPUMesh::GPUMesh(const Mesh& cpuMesh)
     glVertexArrayAttribBinding(m_vao, 2, 0);
     glVertexArrayAttribBinding(m_vao, 3, 0);
 
-    // Each triangle has 3 vertices.
-    m_numIndices = static_cast<GLsizei>(3 * cpuMesh.triangles.size());
+    // Levels of detail are ranges of the one index buffer
+    if (lods.empty())
+        m_lods = { { .firstTriangle = 0U, .numTriangles = static_cast<uint32_t>(triangles.size()), .error = 0.0f } };
+    else
+        m_lods.assign(lods.begin(), lods.end());
+
+    // Meshlets never cross levels, so each level owns a contiguous run of them
+    if (meshlets.empty())
+        m_meshlets = buildMeshlets(vertices, triangles, m_lods);
+    else
+        m_meshlets.assign(meshlets.begin(), meshlets.end());
+    for (const MeshLod& lod : m_lods) {
+        m_lodFirstMeshlets.push_back(static_cast<uint32_t>(std::lower_bound(m_meshlets.begin(), m_meshlets.end(), lod.firstTriangle,
+            [](const Meshlet& meshlet, uint32_t firstTriangle) { return meshlet.firstTriangle < firstTriangle; }) - m_meshlets.begin()));
+    }
+    m_lodFirstMeshlets.push_back(static_cast<uint32_t>(m_meshlets.size()));
 }
 
 GPUMesh::GPUMesh(GPUMesh&& other)
@@ -90,34 +123,84 @@ bool GPUMesh::hasTextureCoords() const
     return m_hasTextureCoords;
 }
 
-void GPUMesh::draw(const Shader& drawingShader) const
+void GPUMesh::draw(const Shader& drawingShader, size_t lod) const
+{
+    bindMaterial(drawingShader);
+
+    // Draw the triangles of the requested level. Each triangle has 3 vertices.
+    const MeshLod& range = m_lods[std::min(lod, m_lods.size() - 1)];
+    gl_state::bindVertexArray(m_vao);
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(3 * range.numTriangles), GL_UNSIGNED_INT,
+                   reinterpret_cast<const void*>(range.firstTriangle * sizeof(glm::uvec3)));
+}
+
+void GPUMesh::cullMeshlets(size_t lod, const CullingView& view, FaceCulling faceCulling, uint32_t instance, MeshletDrawList& drawList) const
+{
+    lod = std::min(lod, m_lods.size() - 1);
+    drawList.totalMeshlets += m_lodFirstMeshlets[lod + 1] - m_lodFirstMeshlets[lod];
+
+    uint32_t rangeEnd = 0; // One past the last triangle of the range drawn last
+    const size_t firstCommand = drawList.commands.size();
+    for (uint32_t meshletIdx = m_lodFirstMeshlets[lod]; meshletIdx < m_lodFirstMeshlets[lod + 1]; meshletIdx++) {
+        const Meshlet& meshlet = m_meshlets[meshletIdx];
+        if (!isMeshletVisible(meshlet, view, faceCulling))
+            continue;
+
+        drawList.visibleMeshlets++;
+        drawList.visibleTriangles += meshlet.numTriangles;
+        if (drawList.commands.size() > firstCommand && rangeEnd == meshlet.firstTriangle) {
+            drawList.commands.back().count += 3 * meshlet.numTriangles;
+        } else {
+            drawList.commands.push_back({ .count = 3 * meshlet.numTriangles, .instanceCount = 1, .firstIndex = 3 * meshlet.firstTriangle,
+                                          .baseVertex = 0, .baseInstance = instance });
+        }
+        rangeEnd = meshlet.firstTriangle + meshlet.numTriangles;
+    }
+}
+
+void GPUMesh::draw(const Shader& drawingShader, const MeshletDrawList& drawList) const
+{
+    if (drawList.commands.empty())
+        return;
+    bindMaterial(drawingShader);
+    gl_state::bindVertexArray(m_vao);
+
+    // Respecifying the whole store lets the driver hand out fresh memory instead of waiting for the previous draw to read it
+    glNamedBufferData(m_indirectBuffer, static_cast<GLsizeiptr>(drawList.commands.size() * sizeof(DrawElementsIndirectCommand)), drawList.commands.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(drawList.commands.size()), 0);
+}
+
+void GPUMesh::bindMaterial(const Shader& drawingShader) const
 {
     // Bind material data uniform (we assume that the uniform buffer object is always called 'Material')
     // Yes, we could define the binding inside the shader itself, but that would break on OpenGL versions below 4.2
     drawingShader.bindUniformBlock("Material", 0);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_uboMaterial);
-    
-    // Draw the mesh's triangles
-    glBindVertexArray(m_vao);
-    glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, nullptr);
+    gl_state::bindUniformBuffer(0, m_uboMaterial);
 }
 
 void GPUMesh::moveInto(GPUMesh&& other)
 {
     freeGpuMemory();
-    m_numIndices = other.m_numIndices;
+    m_lods = std::move(other.m_lods);
+    m_meshlets = std::move(other.m_meshlets);
+    m_lodFirstMeshlets = std::move(other.m_lodFirstMeshlets);
     m_hasTextureCoords = other.m_hasTextureCoords;
     m_ibo = other.m_ibo;
     m_vbo = other.m_vbo;
     m_vao = other.m_vao;
     m_uboMaterial = other.m_uboMaterial;
+    m_indirectBuffer = other.m_indirectBuffer;
 
-    other.m_numIndices = 0;
+    other.m_lods.clear();
+    other.m_meshlets.clear();
+    other.m_lodFirstMeshlets.clear();
     other.m_hasTextureCoords = other.m_hasTextureCoords;
     other.m_ibo = INVALID;
     other.m_vbo = INVALID;
     other.m_vao = INVALID;
     other.m_uboMaterial = INVALID;
+    other.m_indirectBuffer = INVALID;
 }
 
 void GPUMesh::freeGpuMemory()
@@ -130,4 +213,6 @@ void GPUMesh::freeGpuMemory()
         glDeleteBuffers(1, &m_ibo);
     if (m_uboMaterial != INVALID)
         glDeleteBuffers(1, &m_uboMaterial);
+    if (m_indirectBuffer != INVALID)
+        glDeleteBuffers(1, &m_indirectBuffer);
 }
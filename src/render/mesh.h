@@ -10,8 +10,13 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/vec3.hpp>
 DISABLE_WARNINGS_POP()
 
+#include <render/mesh_lod.h>
+#include <render/meshlets.h>
+
 #include <exception>
 #include <filesystem>
+#include <span>
+#include <vector>
 
 struct MeshLoadingException : public std::runtime_error {
     using std::runtime_error::runtime_error;
@@ -27,9 +32,32 @@ struct alignas(16) GPUMaterial {
 	float transparency{ 1.0f };
 };
 
+// Layout glMultiDrawElementsIndirect() reads its commands in (https://registry.khronos.org/OpenGL-Refpages/gl4/html/glMultiDrawElementsIndirect.xhtml)
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;    // Index of the instance the range belongs to, as gl_BaseInstance
+};
+
+// Triangle ranges of every instance left over after culling, ready for glMultiDrawElementsIndirect
+struct MeshletDrawList {
+    std::vector<DrawElementsIndirectCommand> commands;
+    uint32_t totalMeshlets;
+    uint32_t visibleMeshlets;
+    uint64_t visibleTriangles;
+
+    void clear();
+};
+
 class GPUMesh {
 public:
-    GPUMesh(const Mesh& cpuMesh);
+    // Without any levels of detail, all triangles make up a single level. Meshlets are built here if none are given
+    GPUMesh(const Mesh& cpuMesh, std::span<const MeshLod> lods = {}, std::span<const Meshlet> meshlets = {});
+    // Upload directly from externally owned (e.g. memory-mapped) data
+    GPUMesh(std::span<const Vertex> vertices, std::span<const glm::uvec3> triangles, const Material& material,
+            std::span<const MeshLod> lods = {}, std::span<const Meshlet> meshlets = {});
     // Cannot copy a GPU mesh because it would require reference counting of GPU resources.
     GPUMesh(const GPUMesh&) = delete;
     GPUMesh(GPUMesh&&);
@@ -44,23 +72,32 @@ public:
     GPUMesh& operator=(GPUMesh&&);
 
     bool hasTextureCoords() const;
+    std::span<const MeshLod> lods() const { return m_lods; }
 
-    // Bind VAO and call glDrawElements.
-    void draw(const Shader& drawingShader) const;
+    // Bind VAO and call glDrawElements on the triangles of the given level of detail.
+    void draw(const Shader& drawingShader, size_t lod = 0ULL) const;
+    // Append the meshlets of a level of detail that survive culling to a draw list, as ranges of the given instance. Neighbouring meshlets are merged into one range
+    void cullMeshlets(size_t lod, const CullingView& view, FaceCulling faceCulling, uint32_t instance, MeshletDrawList& drawList) const;
+    // Upload the commands of a draw list, bind VAO and call glMultiDrawElementsIndirect on them.
+    void draw(const Shader& drawingShader, const MeshletDrawList& drawList) const;
 
 private:
+    void bindMaterial(const Shader& drawingShader) const;
     void moveInto(GPUMesh&&);
     void freeGpuMemory();
 
 private:
     static constexpr GLuint INVALID = 0xFFFFFFFF;
 
-    GLsizei m_numIndices { 0 };
+    std::vector<MeshLod> m_lods;
+    std::vector<Meshlet> m_meshlets;
+    std::vector<uint32_t> m_lodFirstMeshlets;   // Meshlets of level i are [m_lodFirstMeshlets[i], m_lodFirstMeshlets[i + 1])
     bool m_hasTextureCoords { false };
     GLuint m_ibo { INVALID };
     GLuint m_vbo { INVALID };
     GLuint m_vao { INVALID };
     GLuint m_uboMaterial { INVALID };
+    GLuint m_indirectBuffer { INVALID };    // Commands of the last draw list, respecified by every draw
 };
 
 
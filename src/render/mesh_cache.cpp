@@ -0,0 +1,317 @@
+#include "mesh_cache.h"
+
+#include <render/streaming_bake.h>
+#include <utils/constants.h>
+#include <utils/hash.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+
+
+static int64_t modifiedTime(const std::filesystem::path& modelPath) {
+    return std::filesystem::last_write_time(modelPath).time_since_epoch().count();
+}
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1ULL) / alignment * alignment;
+}
+
+template<typename T>
+static std::span<const T> reinterpretSection(std::span<const std::byte> bytes, uint64_t count) {
+    if (bytes.size() % sizeof(T) != 0ULL || bytes.size() / sizeof(T) != count) { throw MeshCacheException("Cache section size does not match its element count"); }
+    return { reinterpret_cast<const T*>(bytes.data()), count };
+}
+
+MeshCacheView::MeshCacheView(const std::filesystem::path& cachePath)
+    : m_file(cachePath) {
+    // Header and offset table
+    std::span<const std::byte> fileBytes = m_file.bytes();
+    if (fileBytes.size() < sizeof(CacheHeader)) { throw MeshCacheException(std::format("Cache file {} is truncated", cachePath.string())); }
+    std::memcpy(&m_header, fileBytes.data(), sizeof(CacheHeader));
+    if (m_header.magic != CACHE_MAGIC)                  { throw MeshCacheException(std::format("{} is not a cache file", cachePath.string())); }
+    if (m_header.formatVersion != CACHE_FORMAT_VERSION) { throw MeshCacheException(std::format("Cache file {} uses an outdated layout", cachePath.string())); }
+    const uint64_t tableEnd = sizeof(CacheHeader) + uint64_t(m_header.numSections) * sizeof(CacheSection);
+    if (fileBytes.size() < tableEnd)                    { throw MeshCacheException(std::format("Cache file {} is truncated", cachePath.string())); }
+    std::vector<CacheSection> sections(m_header.numSections);
+    std::memcpy(sections.data(), fileBytes.data() + sizeof(CacheHeader), sections.size() * sizeof(CacheSection));
+
+    // Resolve payloads
+    for (const CacheSection& section : sections) {
+        std::span<const std::byte> payload = sectionBytes(section);
+        switch (section.type) {
+            case CacheSectionType::Vertices: {
+                m_vertices = reinterpretSection<Vertex>(payload, section.count);
+            } break;
+            case CacheSectionType::Triangles: {
+                m_triangles = reinterpretSection<glm::uvec3>(payload, section.count);
+            } break;
+            case CacheSectionType::Lods: {
+                m_lods = reinterpretSection<MeshLod>(payload, section.count);
+            } break;
+            case CacheSectionType::Meshlets: {
+                m_meshlets = reinterpretSection<Meshlet>(payload, section.count);
+            } break;
+            case CacheSectionType::Material: {
+                std::memcpy(&m_material, reinterpretSection<CachedMaterial>(payload, 1ULL).data(), sizeof(CachedMaterial));
+            } break;
+            case CacheSectionType::EncodedBounds: {
+                std::memcpy(&m_encoded.bounds, reinterpretSection<EncodedBounds>(payload, 1ULL).data(), sizeof(EncodedBounds));
+                m_isEncoded = true;
+            } break;
+            case CacheSectionType::EncodedPositions: {
+                m_encoded.positions = reinterpretSection<std::array<uint16_t, 3>>(payload, section.count);
+            } break;
+            case CacheSectionType::EncodedNormals: {
+                m_encoded.normals = reinterpretSection<uint32_t>(payload, section.count);
+            } break;
+            case CacheSectionType::EncodedTexCoords: {
+                m_encoded.texCoords = reinterpretSection<uint32_t>(payload, section.count);
+            } break;
+            case CacheSectionType::EncodedDistances: {
+                m_encoded.distances = reinterpretSection<uint16_t>(payload, section.count);
+            } break;
+            case CacheSectionType::EncodedTriangleChunks: {
+                m_encoded.triangleChunkOffsets = reinterpretSection<uint64_t>(payload, section.count);
+            } break;
+            case CacheSectionType::EncodedTriangles: {
+                m_encoded.triangleBytes = reinterpretSection<uint8_t>(payload, section.size);
+                m_encoded.numTriangles  = section.count;
+            } break;
+            default: break; // Unknown sections are skipped to allow for additive extensions
+        }
+    }
+
+    // Levels of detail and meshlets are drawn straight from the index buffer, so they must not reach past its end
+    const uint64_t numTriangles = m_isEncoded ? m_encoded.numTriangles : m_triangles.size();
+    for (const MeshLod& lod : m_lods) {
+        if (uint64_t(lod.firstTriangle) + lod.numTriangles > numTriangles) { throw MeshCacheException(std::format("Cache file {} has a level of detail beyond its triangles", cachePath.string())); }
+    }
+    for (const Meshlet& meshlet : m_meshlets) {
+        if (uint64_t(meshlet.firstTriangle) + meshlet.numTriangles > numTriangles) { throw MeshCacheException(std::format("Cache file {} has a meshlet beyond its triangles", cachePath.string())); }
+    }
+}
+
+Material MeshCacheView::material() const {
+    Material material;
+    material.kd             = m_material.kd;
+    material.ks             = m_material.ks;
+    material.shininess      = m_material.shininess;
+    material.transparency   = m_material.transparency;
+    return material;
+}
+
+Mesh MeshCacheView::toMesh() const {
+    if (m_isEncoded) {
+        const auto start            = std::chrono::steady_clock::now();
+        Mesh mesh                   = decodeMesh(m_encoded, material());
+        const double seconds        = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const double decodedMiB     = double(mesh.vertices.size() * sizeof(Vertex) + mesh.triangles.size() * sizeof(glm::uvec3)) / double(1ULL << 20ULL);
+        std::cout << std::format("Decoded {:.1f} MiB of mesh data in {:.1f} ms ({:.0f} MiB/s)", decodedMiB, seconds * 1e3, decodedMiB / seconds) << std::endl;
+        return mesh;
+    }
+
+    Mesh mesh;
+    mesh.vertices.assign(m_vertices.begin(), m_vertices.end());
+    mesh.triangles.assign(m_triangles.begin(), m_triangles.end());
+    mesh.material = material();
+    return mesh;
+}
+
+std::span<const std::byte> MeshCacheView::sectionBytes(const CacheSection& section) const {
+    // Written so that corrupted offsets and sizes cannot wrap around
+    if (section.offset % CACHE_SECTION_ALIGNMENT != 0ULL || section.size > m_file.size() || section.offset > m_file.size() - section.size) {
+        throw MeshCacheException("Cache section lies outside of the file or is misaligned");
+    }
+    return m_file.bytes().subspan(section.offset, section.size);
+}
+
+void writeMeshCache(const std::filesystem::path& cachePath, CacheHeader header, const Mesh& mesh,
+                    std::span<const MeshLod> lods, std::span<const Meshlet> meshlets) {
+    const CachedMaterial material = { .kd           = mesh.material.kd,
+                                      .ks           = mesh.material.ks,
+                                      .shininess    = mesh.material.shininess,
+                                      .transparency = mesh.material.transparency };
+    struct Payload {
+        CacheSectionType type;
+        std::span<const std::byte> bytes;
+        uint64_t count;
+    };
+    std::vector<Payload> payloads = { { CacheSectionType::Material, std::as_bytes(std::span(&material, 1)), 1ULL } };
+
+    // Encoded payloads must outlive the write below
+    EncodedMesh encoded;
+    if (header.compressed) {
+        encoded = encodeMesh(mesh);
+        payloads.insert(payloads.end(), {
+            { CacheSectionType::EncodedBounds,          std::as_bytes(std::span(&encoded.bounds, 1)),               1ULL },
+            { CacheSectionType::EncodedPositions,       std::as_bytes(std::span(encoded.positions)),                encoded.positions.size() },
+            { CacheSectionType::EncodedNormals,         std::as_bytes(std::span(encoded.normals)),                  encoded.normals.size() },
+            { CacheSectionType::EncodedTexCoords,       std::as_bytes(std::span(encoded.texCoords)),                encoded.texCoords.size() },
+            { CacheSectionType::EncodedDistances,       std::as_bytes(std::span(encoded.distances)),                encoded.distances.size() },
+            { CacheSectionType::EncodedTriangleChunks,  std::as_bytes(std::span(encoded.triangleChunkOffsets)),     encoded.triangleChunkOffsets.size() },
+            { CacheSectionType::EncodedTriangles,       std::as_bytes(std::span(encoded.triangleBytes)),            encoded.numTriangles } });
+
+        const uint64_t rawBytes     = mesh.vertices.size() * sizeof(Vertex) + mesh.triangles.size() * sizeof(glm::uvec3);
+        uint64_t encodedBytes       = 0ULL;
+        for (const Payload& payload : payloads) { encodedBytes += payload.bytes.size(); }
+        std::cout << std::format("Compressed mesh cache from {} to {} bytes (ratio {:.2f})", rawBytes, encodedBytes, double(rawBytes) / double(encodedBytes)) << std::endl;
+    } else {
+        payloads.insert(payloads.end(), {
+            { CacheSectionType::Vertices,   std::as_bytes(std::span(mesh.vertices)),    mesh.vertices.size() },
+            { CacheSectionType::Triangles,  std::as_bytes(std::span(mesh.triangles)),   mesh.triangles.size() } });
+    }
+    if (!lods.empty())      { payloads.push_back({ CacheSectionType::Lods,      std::as_bytes(lods),        lods.size() }); }
+    if (!meshlets.empty())  { payloads.push_back({ CacheSectionType::Meshlets,  std::as_bytes(meshlets),    meshlets.size() }); }
+
+    // Lay out the offset table and aligned payloads
+    header.numSections = static_cast<uint32_t>(payloads.size());
+    std::vector<CacheSection> sections;
+    uint64_t offset = alignUp(sizeof(CacheHeader) + payloads.size() * sizeof(CacheSection), CACHE_SECTION_ALIGNMENT);
+    for (const Payload& payload : payloads) {
+        sections.push_back({ .type = payload.type, .offset = offset, .size = payload.bytes.size(), .count = payload.count });
+        offset = alignUp(offset + payload.bytes.size(), CACHE_SECTION_ALIGNMENT);
+    }
+
+    // Write everything out, zero-filling the gaps
+    std::ofstream fileStream(cachePath, std::ios::binary);
+    if (!fileStream) { throw MeshCacheException(std::format("Could not open {} for writing", cachePath.string())); }
+    const std::array<char, CACHE_SECTION_ALIGNMENT> padding {};
+    fileStream.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+    fileStream.write(reinterpret_cast<const char*>(sections.data()), static_cast<std::streamsize>(sections.size() * sizeof(CacheSection)));
+    uint64_t written = sizeof(CacheHeader) + sections.size() * sizeof(CacheSection);
+    for (size_t sectionIdx = 0ULL; sectionIdx < sections.size(); sectionIdx++) {
+        fileStream.write(padding.data(), static_cast<std::streamsize>(sections[sectionIdx].offset - written));
+        fileStream.write(reinterpret_cast<const char*>(payloads[sectionIdx].bytes.data()), static_cast<std::streamsize>(payloads[sectionIdx].bytes.size()));
+        written = sections[sectionIdx].offset + sections[sectionIdx].size;
+    }
+    if (!fileStream) { throw MeshCacheException(std::format("Failed writing cache file {}", cachePath.string())); }
+}
+
+MeshCacheStreamWriter::MeshCacheStreamWriter(const std::filesystem::path& cachePath, const CacheHeader& header, const Material& material, uint64_t numTriangles)
+    : m_cachePath(cachePath)
+    , m_header(header)
+    , m_fileStream(cachePath, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc)
+    , m_numTriangles(numTriangles) {
+    if (!m_fileStream) { throw MeshCacheException(std::format("Could not open {} for writing", cachePath.string())); }
+
+    // Same layout as writeMeshCache(), except that vertices come last as their number is not known yet
+    m_header.numSections            = static_cast<uint32_t>(m_sections.size());
+    m_header.compressed             = false;
+    const CachedMaterial cached     = { .kd             = material.kd,
+                                        .ks             = material.ks,
+                                        .shininess      = material.shininess,
+                                        .transparency   = material.transparency };
+    const uint64_t materialOffset   = alignUp(sizeof(CacheHeader) + m_sections.size() * sizeof(CacheSection), CACHE_SECTION_ALIGNMENT);
+    const uint64_t trianglesOffset  = alignUp(materialOffset + sizeof(CachedMaterial), CACHE_SECTION_ALIGNMENT);
+    const uint64_t verticesOffset   = alignUp(trianglesOffset + numTriangles * sizeof(glm::uvec3), CACHE_SECTION_ALIGNMENT);
+    m_sections = {{
+        { .type = CacheSectionType::Material,   .offset = materialOffset,   .size = sizeof(CachedMaterial),                 .count = 1ULL },
+        { .type = CacheSectionType::Triangles,  .offset = trianglesOffset,  .size = numTriangles * sizeof(glm::uvec3),      .count = numTriangles },
+        { .type = CacheSectionType::Vertices,   .offset = verticesOffset,   .size = 0ULL,                                   .count = 0ULL } }};
+
+    // Gaps are zero-filled by seeking past the end
+    m_fileStream.seekp(static_cast<std::streamoff>(materialOffset));
+    m_fileStream.write(reinterpret_cast<const char*>(&cached), sizeof(CachedMaterial));
+    check("writing the material of");
+}
+
+void MeshCacheStreamWriter::appendTriangles(std::span<const glm::uvec3> triangles) {
+    if (m_trianglesWritten + triangles.size() > m_numTriangles) { throw MeshCacheException("More triangles were streamed than announced"); }
+    m_fileStream.seekp(static_cast<std::streamoff>(m_sections[1].offset + m_trianglesWritten * sizeof(glm::uvec3)));
+    m_fileStream.write(reinterpret_cast<const char*>(triangles.data()), static_cast<std::streamsize>(triangles.size_bytes()));
+    check("writing triangles to");
+    m_trianglesWritten += triangles.size();
+}
+
+uint64_t MeshCacheStreamWriter::appendVertices(std::span<const Vertex> vertices) {
+    const uint64_t firstVertex = m_verticesWritten;
+    m_verticesWritten += vertices.size();
+    writeVertices(firstVertex, vertices);
+    return firstVertex;
+}
+
+void MeshCacheStreamWriter::readVertices(uint64_t firstVertex, std::span<Vertex> vertices) {
+    if (firstVertex + vertices.size() > m_verticesWritten) { throw MeshCacheException("Read of vertices which have not been streamed yet"); }
+    m_fileStream.seekg(static_cast<std::streamoff>(m_sections[2].offset + firstVertex * sizeof(Vertex)));
+    m_fileStream.read(reinterpret_cast<char*>(vertices.data()), static_cast<std::streamsize>(vertices.size_bytes()));
+    check("reading vertices from");
+}
+
+void MeshCacheStreamWriter::writeVertices(uint64_t firstVertex, std::span<const Vertex> vertices) {
+    if (firstVertex + vertices.size() > m_verticesWritten) { throw MeshCacheException("Write of vertices which have not been streamed yet"); }
+    m_fileStream.seekp(static_cast<std::streamoff>(m_sections[2].offset + firstVertex * sizeof(Vertex)));
+    m_fileStream.write(reinterpret_cast<const char*>(vertices.data()), static_cast<std::streamsize>(vertices.size_bytes()));
+    check("writing vertices to");
+}
+
+void MeshCacheStreamWriter::finish() {
+    if (m_trianglesWritten != m_numTriangles) { throw MeshCacheException(std::format("Only {} of {} triangles were streamed", m_trianglesWritten, m_numTriangles)); }
+    m_sections[2].size  = m_verticesWritten * sizeof(Vertex);
+    m_sections[2].count = m_verticesWritten;
+    m_fileStream.seekp(0);
+    m_fileStream.write(reinterpret_cast<const char*>(&m_header), sizeof(CacheHeader));
+    m_fileStream.write(reinterpret_cast<const char*>(m_sections.data()), static_cast<std::streamsize>(m_sections.size() * sizeof(CacheSection)));
+    m_fileStream.flush();
+    check("finishing");
+}
+
+void MeshCacheStreamWriter::check(const char* operation) const {
+    if (!m_fileStream) { throw MeshCacheException(std::format("Failed {} cache file {}", operation, m_cachePath.string())); }
+}
+
+void rewriteCacheSource(const std::filesystem::path& cachePath, const SourceFingerprint& source) {
+    std::fstream fileStream(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+    if (!fileStream) { throw MeshCacheException(std::format("Could not open {} for writing", cachePath.string())); }
+    fileStream.seekp(offsetof(CacheHeader, source));
+    fileStream.write(reinterpret_cast<const char*>(&source), sizeof(SourceFingerprint));
+    fileStream.flush();
+    if (!fileStream) { throw MeshCacheException(std::format("Failed writing cache file {}", cachePath.string())); }
+}
+
+std::filesystem::path cachePathForModel(const std::filesystem::path& modelPath) {
+    utils::Hasher pathHasher;
+    const std::string canonicalPath = std::filesystem::weakly_canonical(modelPath).generic_string();
+    pathHasher.update(std::as_bytes(std::span(canonicalPath)));
+    return utils::CACHE_PATH / std::format("{}-{:016x}.cache", modelPath.stem().string(), pathHasher.digest());
+}
+
+BakeParameters currentBakeParameters(const Config& config, const std::filesystem::path& modelPath) {
+    // Streamed bakes are never welded or simplified
+    const bool streamed = config.streamingBake && supportsStreamingBake(modelPath);
+    return { .interiorRayOffset = utils::INTERIOR_RAY_OFFSET,
+             .weldEpsilon       = config.weldVertices && !streamed ? config.weldEpsilon : 0.0f,
+             .streamed          = streamed,
+             .optimized         = config.optimizeMesh,
+             .lods              = config.generateLods && !streamed };
+}
+
+bool wantsCompressedCache(const Config& config, const BakeParameters& bake) {
+    return config.compressCache && !bake.streamed;
+}
+
+SourceFingerprint fingerprintModel(const std::filesystem::path& modelPath) {
+    return { .size          = std::filesystem::file_size(modelPath),
+             .modifiedTime  = modifiedTime(modelPath),
+             .contentHash   = utils::hashFile(modelPath) };
+}
+
+CacheValidation validateCacheHeader(CacheHeader& header, const std::filesystem::path& modelPath, const BakeParameters& bake) {
+    // Anything baked differently or stored in another layout is never reusable
+    if (header.formatVersion != CACHE_FORMAT_VERSION || header.bake != bake) { return { false, false }; }
+
+    // Cheap checks first. A differing size means differing contents, so no need to hash
+    const uint64_t size     = std::filesystem::file_size(modelPath);
+    const int64_t mtime     = modifiedTime(modelPath);
+    if (size != header.source.size)                                 { return { false, false }; }
+    if (mtime == header.source.modifiedTime)                        { return { true, false }; }
+
+    // Same size but touched since the bake; only the contents can tell us if it really changed
+    if (utils::hashFile(modelPath) != header.source.contentHash)    { return { false, false }; }
+    header.source.modifiedTime = mtime;
+    return { true, true };
+}
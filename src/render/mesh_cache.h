@@ -0,0 +1,203 @@
+#pragma once
+#ifndef _MESH_CACHE_H_
+#define _MESH_CACHE_H_
+
+#include <framework/mapped_file.h>
+#include <framework/mesh.h>
+#include <render/mesh_encoding.h>
+#include <render/mesh_lod.h>
+#include <render/meshlets.h>
+#include <utils/config.h>
+
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+struct MeshCacheException : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Bump whenever the layout or semantics of cached data changes so that old caches get rebuilt
+constexpr uint32_t CACHE_FORMAT_VERSION = 11U;
+constexpr std::array<char, 8> CACHE_MAGIC = { 'I', 'S', 'R', 'C', 'A', 'C', 'H', 'E' };
+constexpr uint64_t CACHE_SECTION_ALIGNMENT = 64ULL; // Payloads start on cache line boundaries
+
+// Parameters of the d_N bake and storage which influence the contents of a cache file. Settings that only change how
+// fast the same result is computed (e.g. Config::useBVH) are deliberately left out, so that toggling them never forces a rebake
+struct BakeParameters {
+    float interiorRayOffset;
+    float weldEpsilon;          // Distance within which vertices were welded, zero if welding was disabled
+    bool streamed;              // Baked out of core (see streaming_bake.h), which duplicates vertices along chunk borders
+    bool optimized;             // Triangle and vertex order optimised for the GPU (see mesh_optimizer.h)
+    bool lods;                  // Simplified levels of detail appended to the full-resolution mesh (see mesh_lod.h)
+
+    [[nodiscard]] constexpr bool operator==(const BakeParameters&) const noexcept = default;
+
+    template<class Archive>
+    void serialize(Archive& ar) { ar(CEREAL_NVP(interiorRayOffset), CEREAL_NVP(weldEpsilon), CEREAL_NVP(streamed), CEREAL_NVP(optimized), CEREAL_NVP(lods)); }
+};
+
+// Identifies the exact contents of the model file a cache was baked from
+struct SourceFingerprint {
+    uint64_t size;
+    int64_t modifiedTime;
+    uint64_t contentHash;
+};
+
+// Written at the very start of every cache file, directly followed by the section table
+struct CacheHeader {
+    std::array<char, 8> magic   { CACHE_MAGIC };
+    uint32_t formatVersion      { CACHE_FORMAT_VERSION };
+    uint32_t numSections        { 0U };
+    SourceFingerprint source;
+    BakeParameters bake;
+    bool compressed             { false };  // Payload holds quantised attributes and coded indices (see mesh_encoding.h). Only a storage
+                                            // format: both hold the same bake, so it is left out of validation and transcoded when it changes
+};
+
+enum class CacheSectionType : uint32_t {
+    Vertices = 0,   // Vertex records, uploaded verbatim as the vertex buffer
+    Triangles,      // glm::uvec3 index triplets, uploaded verbatim as the index buffer
+    Material,       // A single CachedMaterial
+
+    // Compressed alternative to the vertex and triangle sections
+    EncodedBounds,
+    EncodedPositions,
+    EncodedNormals,
+    EncodedTexCoords,
+    EncodedDistances,
+    EncodedTriangleChunks,
+    EncodedTriangles,
+
+    Lods,           // MeshLod triangle ranges; without this section all triangles make up a single level
+    Meshlets        // Meshlet ranges and culling bounds; rebuilt on upload if absent
+};
+
+// Entry of the offset table; offsets are relative to the start of the file
+struct CacheSection {
+    CacheSectionType type;
+    uint32_t reserved { 0U };
+    uint64_t offset;
+    uint64_t size;
+    uint64_t count;
+};
+
+// Material without its (non-trivially copyable) texture
+struct CachedMaterial {
+    glm::vec3 kd;
+    glm::vec3 ks;
+    float shininess;
+    float transparency;
+};
+
+static_assert(std::is_trivially_copyable_v<CacheHeader> && std::is_trivially_copyable_v<CacheSection>);
+static_assert(std::is_trivially_copyable_v<Vertex> && sizeof(Vertex) == 36ULL);
+static_assert(std::is_trivially_copyable_v<glm::uvec3> && sizeof(glm::uvec3) == 12ULL);
+static_assert(std::is_trivially_copyable_v<MeshLod> && sizeof(MeshLod) == 12ULL);
+static_assert(std::is_trivially_copyable_v<Meshlet> && sizeof(Meshlet) == 40ULL);
+
+// Read-only view of a memory-mapped cache file. Spans point straight into the mapping,
+// so they can be handed to the GPU without any intermediate copies
+class MeshCacheView {
+public:
+    explicit MeshCacheView(const std::filesystem::path& cachePath);
+
+    const CacheHeader& header() const               { return m_header; }
+    Material material() const;
+
+    // Compressed caches have to be decoded via toMesh(); their vertex and triangle spans are empty
+    bool isEncoded() const                          { return m_isEncoded; }
+    std::span<const Vertex> vertices() const        { return m_vertices; }
+    std::span<const glm::uvec3> triangles() const   { return m_triangles; }
+    std::span<const MeshLod> lods() const           { return m_lods; }
+    std::span<const Meshlet> meshlets() const       { return m_meshlets; }
+
+    // Copy (or decode) the mapped data into a regular CPU-side mesh
+    Mesh toMesh() const;
+
+private:
+    std::span<const std::byte> sectionBytes(const CacheSection& section) const;
+
+    MappedFile m_file;
+    CacheHeader m_header;
+    std::span<const Vertex> m_vertices;
+    std::span<const glm::uvec3> m_triangles;
+    std::span<const MeshLod> m_lods;
+    std::span<const Meshlet> m_meshlets;
+    bool m_isEncoded { false };
+    EncodedMeshView m_encoded {};
+    CachedMaterial m_material { .kd = glm::vec3(1.0f), .ks = glm::vec3(0.0f), .shininess = 1.0f, .transparency = 1.0f };
+};
+
+// Levels of detail and meshlets index into the mesh's triangles, and are stored as they are
+void writeMeshCache(const std::filesystem::path& cachePath, CacheHeader header, const Mesh& mesh,
+                    std::span<const MeshLod> lods = {}, std::span<const Meshlet> meshlets = {});
+
+// Writes an uncompressed cache file piece by piece, for meshes that are never held in memory as a whole.
+// The triangle count has to be known up front, as triangles are laid out before the vertices. Vertices are
+// appended, and may be read back and patched (e.g. once their d_N is known) before the file is finished
+class MeshCacheStreamWriter {
+public:
+    MeshCacheStreamWriter(const std::filesystem::path& cachePath, const CacheHeader& header, const Material& material, uint64_t numTriangles);
+
+    void appendTriangles(std::span<const glm::uvec3> triangles);
+    // Returns the index of the first appended vertex
+    uint64_t appendVertices(std::span<const Vertex> vertices);
+    void readVertices(uint64_t firstVertex, std::span<Vertex> vertices);
+    void writeVertices(uint64_t firstVertex, std::span<const Vertex> vertices);
+
+    // Write the header and section table; the file is incomplete until this is called
+    void finish();
+
+private:
+    void check(const char* operation) const;
+
+    const std::filesystem::path m_cachePath;
+    CacheHeader m_header;
+    std::fstream m_fileStream;
+    const uint64_t m_numTriangles;
+    uint64_t m_trianglesWritten { 0ULL };
+    uint64_t m_verticesWritten  { 0ULL };
+    std::array<CacheSection, 3> m_sections;
+};
+
+// Overwrite only the source fingerprint stored in the header of an existing cache file
+void rewriteCacheSource(const std::filesystem::path& cachePath, const SourceFingerprint& source);
+
+// Cache file location for a given model. The stem keeps the cache directory browsable,
+// while the path hash keeps equally named models from different folders apart
+std::filesystem::path cachePathForModel(const std::filesystem::path& modelPath);
+
+// Parameters a model would be baked with under the given config; these depend on whether it can be streamed
+BakeParameters currentBakeParameters(const Config& config, const std::filesystem::path& modelPath);
+// Payload format a cache of the given bake should be stored in. Streamed bakes are always written uncompressed
+bool wantsCompressedCache(const Config& config, const BakeParameters& bake);
+
+// Size and modification time are cheap to query; the content hash requires reading the whole file
+SourceFingerprint fingerprintModel(const std::filesystem::path& modelPath);
+
+struct CacheValidation {
+    bool valid;             // Cached data can be used as-is
+    bool headerRefreshed;   // Header was updated and should be written back to the cache file
+};
+
+/**
+ * Check whether a cache header still describes the given model and bake parameters.
+ * Size and modification time are compared first; the full content hash is only computed
+ * if those differ but the size does not (e.g. the file was touched or copied)
+ * 
+ * @param header Header read from the cache file. Its modification time is updated if the content hash proved the cache valid
+ * @param modelPath Model file the cache was supposedly generated from
+ * @param bake Parameters that the bake would be performed with now
+ * 
+ * @return Whether the cached data can be used as-is, and whether the header was updated
+*/
+CacheValidation validateCacheHeader(CacheHeader& header, const std::filesystem::path& modelPath, const BakeParameters& bake);
+
+
+#endif // _MESH_CACHE_H_
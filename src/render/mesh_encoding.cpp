@@ -0,0 +1,174 @@
+#include "mesh_encoding.h"
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/packing.hpp>
+DISABLE_WARNINGS_POP()
+#include <omp.h>
+
+#include <utils/constants.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+
+static constexpr uint16_t DISTANCE_MISS = std::numeric_limits<uint16_t>::max();
+static constexpr float DISTANCE_SCALE   = static_cast<float>(DISTANCE_MISS - 1U);
+
+// Octahedral normal mapping (https://jcgt.org/published/0003/02/01/)
+static glm::vec2 octahedralWrap(const glm::vec2& v) {
+    return (1.0f - glm::abs(glm::vec2(v.y, v.x))) * glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+static uint32_t encodeNormal(glm::vec3 normal) {
+    normal /= (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z)) + utils::ZERO_EPSILON;
+    glm::vec2 projected = normal.z >= 0.0f ? glm::vec2(normal) : octahedralWrap(glm::vec2(normal));
+    return glm::packSnorm2x16(projected);
+}
+
+static glm::vec3 decodeNormal(uint32_t packed) {
+    glm::vec2 projected = glm::unpackSnorm2x16(packed);
+    glm::vec3 normal(projected, 1.0f - std::abs(projected.x) - std::abs(projected.y));
+    float fold = std::max(-normal.z, 0.0f);
+    normal.x  += normal.x >= 0.0f ? -fold : fold;
+    normal.y  += normal.y >= 0.0f ? -fold : fold;
+    return glm::normalize(normal);
+}
+
+static uint64_t zigzagEncode(int64_t value)    { return (static_cast<uint64_t>(value) << 1U) ^ static_cast<uint64_t>(value >> 63U); }
+static int64_t zigzagDecode(uint64_t value)    { return static_cast<int64_t>(value >> 1U) ^ -static_cast<int64_t>(value & 1U); }
+
+static void writeVarint(std::vector<uint8_t>& bytes, uint64_t value) {
+    while (value >= 0x80U) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80U));
+        value >>= 7U;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+static uint64_t readVarint(const uint8_t*& cursor, const uint8_t* end) {
+    uint64_t value  = 0ULL;
+    uint32_t shift  = 0U;
+    while (cursor != end) {
+        if (shift >= 64U) { throw std::runtime_error("Encoded index is longer than 64 bits"); }
+        uint8_t byte = *cursor++;
+        value       |= static_cast<uint64_t>(byte & 0x7FU) << shift;
+        if ((byte & 0x80U) == 0U) { return value; }
+        shift       += 7U;
+    }
+    throw std::runtime_error("Encoded triangle stream ends in the middle of an index");
+}
+
+EncodedMesh encodeMesh(const Mesh& mesh) {
+    EncodedMesh encoded;
+
+    // Quantisation frame
+    glm::vec3 lower(std::numeric_limits<float>::max()), upper(std::numeric_limits<float>::lowest());
+    float maxDistanceInner = 0.0f;
+    for (const Vertex& vertex : mesh.vertices) {
+        lower = glm::min(lower, vertex.position);
+        upper = glm::max(upper, vertex.position);
+        if (vertex.distanceInner != std::numeric_limits<float>::max()) { maxDistanceInner = std::max(maxDistanceInner, vertex.distanceInner); }
+    }
+    if (mesh.vertices.empty()) { lower = upper = glm::vec3(0.0f); }
+    encoded.bounds = { .lower = lower, .extent = glm::max(upper - lower, glm::vec3(utils::ZERO_EPSILON)), .maxDistanceInner = std::max(maxDistanceInner, utils::ZERO_EPSILON) };
+
+    // Vertex attributes
+    encoded.positions.resize(mesh.vertices.size());
+    encoded.normals.resize(mesh.vertices.size());
+    encoded.texCoords.resize(mesh.vertices.size());
+    encoded.distances.resize(mesh.vertices.size());
+    #pragma omp parallel for
+    for (int64_t vertexIdx = 0; vertexIdx < static_cast<int64_t>(mesh.vertices.size()); vertexIdx++) {
+        const size_t idx            = static_cast<size_t>(vertexIdx);
+        const Vertex& vertex        = mesh.vertices[idx];
+        const glm::vec3 relative    = (vertex.position - encoded.bounds.lower) / encoded.bounds.extent;
+        encoded.positions[idx]      = { glm::packUnorm1x16(relative.x), glm::packUnorm1x16(relative.y), glm::packUnorm1x16(relative.z) };
+        encoded.normals[idx]        = encodeNormal(vertex.normal);
+        encoded.texCoords[idx]      = glm::packHalf2x16(vertex.texCoord);
+        encoded.distances[idx]      = vertex.distanceInner == std::numeric_limits<float>::max()
+                                        ? DISTANCE_MISS
+                                        : static_cast<uint16_t>(std::lround(std::clamp(vertex.distanceInner / encoded.bounds.maxDistanceInner, 0.0f, 1.0f) * DISTANCE_SCALE));
+    }
+
+    // Triangles; each chunk restarts the delta chain so that it decodes independently
+    encoded.numTriangles = mesh.triangles.size();
+    for (size_t chunkStart = 0ULL; chunkStart < mesh.triangles.size(); chunkStart += ENCODED_TRIANGLES_PER_CHUNK) {
+        encoded.triangleChunkOffsets.push_back(encoded.triangleBytes.size());
+        const size_t chunkEnd   = std::min(chunkStart + ENCODED_TRIANGLES_PER_CHUNK, mesh.triangles.size());
+        int64_t previousIndex   = 0;
+        for (size_t triangleIdx = chunkStart; triangleIdx < chunkEnd; triangleIdx++) {
+            for (glm::length_t corner = 0; corner < 3; corner++) {
+                const int64_t index = mesh.triangles[triangleIdx][corner];
+                writeVarint(encoded.triangleBytes, zigzagEncode(index - previousIndex));
+                previousIndex       = index;
+            }
+        }
+    }
+
+    return encoded;
+}
+
+Mesh decodeMesh(const EncodedMeshView& encoded, const Material& material) {
+    const size_t numVertices = encoded.positions.size();
+    if (encoded.normals.size() != numVertices || encoded.texCoords.size() != numVertices || encoded.distances.size() != numVertices) {
+        throw std::runtime_error("Encoded vertex attribute streams differ in length");
+    }
+    const size_t numChunks = (encoded.numTriangles + ENCODED_TRIANGLES_PER_CHUNK - 1ULL) / ENCODED_TRIANGLES_PER_CHUNK;
+    if (encoded.triangleChunkOffsets.size() != numChunks) { throw std::runtime_error("Encoded triangle chunk table does not match triangle count"); }
+
+    Mesh mesh;
+    mesh.material = material;
+    mesh.vertices.resize(numVertices);
+    mesh.triangles.resize(encoded.numTriangles);
+
+    // Vertices are independent of each other
+    #pragma omp parallel for
+    for (int64_t vertexIdx = 0; vertexIdx < static_cast<int64_t>(numVertices); vertexIdx++) {
+        const size_t idx                        = static_cast<size_t>(vertexIdx);
+        const std::array<uint16_t, 3>& position = encoded.positions[idx];
+        const glm::vec3 relative(glm::unpackUnorm1x16(position[0]), glm::unpackUnorm1x16(position[1]), glm::unpackUnorm1x16(position[2]));
+        const uint16_t distance = encoded.distances[idx];
+        mesh.vertices[idx] = {
+            .position       = encoded.bounds.lower + relative * encoded.bounds.extent,
+            .normal         = decodeNormal(encoded.normals[idx]),
+            .texCoord       = glm::unpackHalf2x16(encoded.texCoords[idx]),
+            .distanceInner  = distance == DISTANCE_MISS ? std::numeric_limits<float>::max()
+                                                        : (static_cast<float>(distance) / DISTANCE_SCALE) * encoded.bounds.maxDistanceInner
+        };
+    }
+
+    // Triangle chunks restart their delta chains, so they too can be decoded independently
+    bool chunksValid = true;
+    #pragma omp parallel for reduction(&& : chunksValid)
+    for (int64_t chunkIdx = 0; chunkIdx < static_cast<int64_t>(numChunks); chunkIdx++) {
+        const size_t chunk      = static_cast<size_t>(chunkIdx);
+        const size_t chunkStart = chunk * ENCODED_TRIANGLES_PER_CHUNK;
+        const size_t chunkEnd   = std::min(chunkStart + ENCODED_TRIANGLES_PER_CHUNK, static_cast<size_t>(encoded.numTriangles));
+        const uint64_t byteEnd  = chunk + 1ULL < numChunks ? encoded.triangleChunkOffsets[chunk + 1ULL] : encoded.triangleBytes.size();
+        if (encoded.triangleChunkOffsets[chunk] > byteEnd || byteEnd > encoded.triangleBytes.size()) {
+            chunksValid = false;
+            continue;
+        }
+        const uint8_t* cursor   = encoded.triangleBytes.data() + encoded.triangleChunkOffsets[chunk];
+        const uint8_t* end      = encoded.triangleBytes.data() + byteEnd;
+        int64_t previousIndex   = 0;
+        try {
+            for (size_t triangleIdx = chunkStart; triangleIdx < chunkEnd; triangleIdx++) {
+                for (glm::length_t corner = 0; corner < 3; corner++) {
+                    previousIndex += zigzagDecode(readVarint(cursor, end));
+                    if (previousIndex < 0 || previousIndex >= static_cast<int64_t>(numVertices)) { throw std::runtime_error("Decoded index out of range"); }
+                    mesh.triangles[triangleIdx][corner] = static_cast<uint32_t>(previousIndex);
+                }
+            }
+        } catch (const std::runtime_error&) { chunksValid = false; } // Exceptions must not escape an OpenMP region
+    }
+    if (!chunksValid) { throw std::runtime_error("Encoded triangle data is corrupt"); }
+
+    return mesh;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef _MESH_ENCODING_H_
+#define _MESH_ENCODING_H_
+
+#include <framework/mesh.h>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Triangles are delta-coded in independent chunks so that they can be decoded in parallel
+constexpr size_t ENCODED_TRIANGLES_PER_CHUNK = 16384ULL;
+
+// Quantisation frame shared by all encoded vertices of a mesh
+struct EncodedBounds {
+    glm::vec3 lower;
+    glm::vec3 extent;
+    float maxDistanceInner; // Largest finite d_N, used to scale the 16-bit distances
+};
+
+// Largest differences between the attributes of a vertex before and after an encoding round trip; triangles are lossless.
+// Positions and d_N are relative to the bounds extent and bounds.maxDistanceInner respectively, texture coordinates to their own magnitude
+constexpr float ENCODED_POSITION_ERROR  = 1.0f / 65535.0f;  // One 16-bit step
+constexpr float ENCODED_NORMAL_ERROR    = 1e-4f;            // Radians
+constexpr float ENCODED_TEXCOORD_ERROR  = 1.0f / 2048.0f;   // Half float rounding
+constexpr float ENCODED_DISTANCE_ERROR  = 1.0f / 65534.0f;  // One 16-bit step
+
+// Compact representation of a mesh (roughly 16 bytes per vertex instead of 36)
+struct EncodedMesh {
+    EncodedBounds bounds;
+    std::vector<std::array<uint16_t, 3>> positions; // Fixed-point, relative to the mesh bounds
+    std::vector<uint32_t> normals;                  // Octahedral mapping, two packed 16-bit snorm components
+    std::vector<uint32_t> texCoords;                // Two packed half floats
+    std::vector<uint16_t> distances;                // Fixed-point d_N relative to bounds.maxDistanceInner; all ones marks a miss
+    std::vector<uint64_t> triangleChunkOffsets;     // Start of each chunk within triangleBytes
+    std::vector<uint8_t> triangleBytes;             // Zigzag-encoded index deltas stored as variable length integers
+    uint64_t numTriangles;
+};
+
+// Non-owning counterpart of EncodedMesh, e.g. pointing into a memory-mapped cache file
+struct EncodedMeshView {
+    EncodedBounds bounds;
+    std::span<const std::array<uint16_t, 3>> positions;
+    std::span<const uint32_t> normals;
+    std::span<const uint32_t> texCoords;
+    std::span<const uint16_t> distances;
+    std::span<const uint64_t> triangleChunkOffsets;
+    std::span<const uint8_t> triangleBytes;
+    uint64_t numTriangles;
+};
+
+EncodedMesh encodeMesh(const Mesh& mesh);
+
+// Decode vertices and triangle chunks in parallel. Material is not part of the encoding
+Mesh decodeMesh(const EncodedMeshView& encoded, const Material& material);
+
+
+#endif // _MESH_ENCODING_H_
@@ -0,0 +1,304 @@
+#include "mesh_lod.h"
+
+#include <render/mesh_optimizer.h>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/geometric.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+
+static constexpr uint32_t NO_VERTEX         = std::numeric_limits<uint32_t>::max();
+static constexpr double MIN_FLIP_COSINE     = 0.25;     // Largest rotation a collapse may inflict on a surviving triangle is about 75 degrees
+static constexpr float STALLED_REDUCTION    = 0.9f;     // A level keeping more than this fraction of its predecessor's triangles ends the chain
+
+// Area-weighted sum of squared distances to a set of planes: p^T A p + 2 b^T p + c
+struct Quadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double area;
+
+    Quadric& operator+=(const Quadric& other) {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02; a11 += other.a11; a12 += other.a12; a22 += other.a22;
+        b0  += other.b0;  b1  += other.b1;  b2  += other.b2;
+        c   += other.c;
+        area += other.area;
+        return *this;
+    }
+};
+
+// Quadric of the plane dot(normal, p) + offset = 0
+static Quadric planeQuadric(const glm::dvec3& normal, double offset, double area) {
+    return { .a00   = area * normal.x * normal.x, .a01 = area * normal.x * normal.y, .a02 = area * normal.x * normal.z,
+             .a11   = area * normal.y * normal.y, .a12 = area * normal.y * normal.z, .a22 = area * normal.z * normal.z,
+             .b0    = area * offset * normal.x, .b1 = area * offset * normal.y, .b2 = area * offset * normal.z,
+             .c     = area * offset * offset,
+             .area  = area };
+}
+
+// Root mean square distance of a point to the planes of a quadric
+static double quadricError(const Quadric& quadric, const glm::dvec3& p) {
+    if (quadric.area <= 0.0) { return 0.0; }
+    const double squaredDistances = quadric.a00 * p.x * p.x + quadric.a11 * p.y * p.y + quadric.a22 * p.z * p.z
+                                  + 2.0 * (quadric.a01 * p.x * p.y + quadric.a02 * p.x * p.z + quadric.a12 * p.y * p.z)
+                                  + 2.0 * (quadric.b0 * p.x + quadric.b1 * p.y + quadric.b2 * p.z)
+                                  + quadric.c;
+    return std::sqrt(std::max(squaredDistances, 0.0) / quadric.area);
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return (uint64_t(std::min(a, b)) << 32ULL) | uint64_t(std::max(a, b));
+}
+
+static bool isDegenerate(const glm::uvec3& triangle) {
+    return triangle.x == triangle.y || triangle.y == triangle.z || triangle.z == triangle.x;
+}
+
+// Edge collapse state which can be simplified further step by step, so that every level of a chain starts where the last one ended
+class EdgeCollapser {
+public:
+    explicit EdgeCollapser(const Mesh& mesh);
+
+    // Collapse edges until at most targetTriangles are left or no collapse is possible. Returns the largest error so far
+    float collapseTo(size_t targetTriangles);
+
+    size_t numTriangles() const { return m_triangles.size(); }
+    // Current triangles over the referenced vertices only, in the order the triangles were given in
+    Mesh extract(std::span<const Vertex> vertices) const;
+
+private:
+    void buildAdjacency();
+    bool isValidCollapse(uint32_t from, uint32_t to);
+
+    std::vector<glm::dvec3> m_positions;
+    std::vector<Quadric> m_quadrics;
+    std::vector<uint8_t> m_locked;                  // Vertices on open or non-manifold edges, which never move
+    std::vector<uint32_t> m_remap;                  // Vertex every vertex was collapsed onto (itself if it was not)
+    std::vector<glm::uvec3> m_triangles;
+    std::vector<uint32_t> m_adjacencyOffsets;       // Triangles around every vertex (CSR), rebuilt for every pass
+    std::vector<uint32_t> m_adjacency;
+    std::vector<uint32_t> m_ringFrom, m_ringTo;     // Scratch space for the link condition
+    float m_error { 0.0f };
+};
+
+EdgeCollapser::EdgeCollapser(const Mesh& mesh)
+    : m_positions(mesh.vertices.size())
+    , m_quadrics(mesh.vertices.size(), Quadric {})
+    , m_locked(mesh.vertices.size(), 0U)
+    , m_remap(mesh.vertices.size())
+    , m_triangles(mesh.triangles) {
+    std::erase_if(m_triangles, isDegenerate);
+    std::iota(m_remap.begin(), m_remap.end(), 0U);
+    for (size_t vertexIdx = 0ULL; vertexIdx < mesh.vertices.size(); vertexIdx++) { m_positions[vertexIdx] = glm::dvec3(mesh.vertices[vertexIdx].position); }
+
+    // Every vertex starts out with the planes of the triangles around it
+    for (const glm::uvec3& triangle : m_triangles) {
+        const glm::dvec3& p0        = m_positions[triangle.x];
+        const glm::dvec3 normal     = glm::cross(m_positions[triangle.y] - p0, m_positions[triangle.z] - p0);
+        const double normalLength   = glm::length(normal);
+        if (normalLength == 0.0) { continue; }
+        const glm::dvec3 unitNormal = normal / normalLength;
+        const Quadric quadric       = planeQuadric(unitNormal, -glm::dot(unitNormal, p0), 0.5 * normalLength);
+        for (glm::length_t corner = 0; corner < 3; corner++) { m_quadrics[triangle[corner]] += quadric; }
+    }
+
+    // Edges not shared by exactly two triangles lie on borders (or seams, where attributes were split) and are kept in place
+    std::vector<uint64_t> edges;
+    edges.reserve(3ULL * m_triangles.size());
+    for (const glm::uvec3& triangle : m_triangles) {
+        edges.push_back(edgeKey(triangle.x, triangle.y));
+        edges.push_back(edgeKey(triangle.y, triangle.z));
+        edges.push_back(edgeKey(triangle.z, triangle.x));
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t runStart = 0ULL, runEnd; runStart < edges.size(); runStart = runEnd) {
+        for (runEnd = runStart + 1ULL; runEnd < edges.size() && edges[runEnd] == edges[runStart]; runEnd++) {}
+        if (runEnd - runStart != 2ULL) {
+            m_locked[edges[runStart] >> 32ULL]          = 1U;
+            m_locked[edges[runStart] & 0xFFFFFFFFULL]   = 1U;
+        }
+    }
+}
+
+float EdgeCollapser::collapseTo(size_t targetTriangles) {
+    struct Collapse {
+        uint32_t from, to;
+        double error;
+    };
+    std::vector<uint64_t> edges;
+    std::vector<Collapse> collapses;
+    std::vector<uint8_t> frozen(m_positions.size());
+    while (m_triangles.size() > targetTriangles) {
+        buildAdjacency();
+
+        // Every edge is a candidate once, in the cheaper of the directions that move an unlocked vertex
+        edges.clear();
+        for (const glm::uvec3& triangle : m_triangles) {
+            edges.push_back(edgeKey(triangle.x, triangle.y));
+            edges.push_back(edgeKey(triangle.y, triangle.z));
+            edges.push_back(edgeKey(triangle.z, triangle.x));
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        collapses.clear();
+        for (uint64_t edge : edges) {
+            const uint32_t a = static_cast<uint32_t>(edge >> 32ULL), b = static_cast<uint32_t>(edge & 0xFFFFFFFFULL);
+            if (m_locked[a] && m_locked[b]) { continue; }
+            Quadric merged      = m_quadrics[a];
+            merged             += m_quadrics[b];
+            const double toB    = m_locked[a] ? std::numeric_limits<double>::infinity() : quadricError(merged, m_positions[b]);
+            const double toA    = m_locked[b] ? std::numeric_limits<double>::infinity() : quadricError(merged, m_positions[a]);
+            collapses.push_back(toB <= toA ? Collapse { a, b, toB } : Collapse { b, a, toA });
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) {
+            return lhs.error != rhs.error ? lhs.error < rhs.error : edgeKey(lhs.from, lhs.to) < edgeKey(rhs.from, rhs.to);
+        });
+
+        // Cheapest collapses first. Each one freezes the triangles around the vertex it moves for the rest of the pass,
+        // so that the flip checks of later collapses always look at up to date triangles
+        std::fill(frozen.begin(), frozen.end(), uint8_t(0U));
+        size_t removedTriangles = 0ULL;
+        for (const Collapse& collapse : collapses) {
+            if (m_triangles.size() - removedTriangles <= targetTriangles) { break; }
+            if (frozen[collapse.from] || frozen[collapse.to] || !isValidCollapse(collapse.from, collapse.to)) { continue; }
+
+            m_remap[collapse.from]       = collapse.to;
+            m_quadrics[collapse.to]     += m_quadrics[collapse.from];
+            m_error                      = std::max(m_error, static_cast<float>(collapse.error));
+            for (uint32_t adjacencyIdx = m_adjacencyOffsets[collapse.from]; adjacencyIdx < m_adjacencyOffsets[collapse.from + 1U]; adjacencyIdx++) {
+                const glm::uvec3& triangle = m_triangles[m_adjacency[adjacencyIdx]];
+                frozen[triangle.x] = frozen[triangle.y] = frozen[triangle.z] = 1U;
+                removedTriangles += triangle.x == collapse.to || triangle.y == collapse.to || triangle.z == collapse.to;
+            }
+        }
+        if (removedTriangles == 0ULL) { break; }
+
+        // Moved vertices were frozen, so they are never the target of another collapse in the same pass
+        for (glm::uvec3& triangle : m_triangles) { triangle = { m_remap[triangle.x], m_remap[triangle.y], m_remap[triangle.z] }; }
+        std::erase_if(m_triangles, isDegenerate);
+    }
+    return m_error;
+}
+
+Mesh EdgeCollapser::extract(std::span<const Vertex> vertices) const {
+    Mesh mesh;
+    mesh.triangles.reserve(m_triangles.size());
+    std::vector<uint32_t> newIndices(vertices.size(), NO_VERTEX);
+    for (const glm::uvec3& triangle : m_triangles) {
+        glm::uvec3 newTriangle;
+        for (glm::length_t corner = 0; corner < 3; corner++) {
+            if (newIndices[triangle[corner]] == NO_VERTEX) {
+                newIndices[triangle[corner]] = static_cast<uint32_t>(mesh.vertices.size());
+                mesh.vertices.push_back(vertices[triangle[corner]]);
+            }
+            newTriangle[corner] = newIndices[triangle[corner]];
+        }
+        mesh.triangles.push_back(newTriangle);
+    }
+    return mesh;
+}
+
+void EdgeCollapser::buildAdjacency() {
+    m_adjacencyOffsets.assign(m_positions.size() + 1ULL, 0U);
+    for (const glm::uvec3& triangle : m_triangles) {
+        for (glm::length_t corner = 0; corner < 3; corner++) { m_adjacencyOffsets[triangle[corner] + 1U]++; }
+    }
+    std::inclusive_scan(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end(), m_adjacencyOffsets.begin());
+    m_adjacency.resize(3ULL * m_triangles.size());
+    std::vector<uint32_t> cursors(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+    for (uint32_t triangleIdx = 0U; triangleIdx < m_triangles.size(); triangleIdx++) {
+        for (glm::length_t corner = 0; corner < 3; corner++) { m_adjacency[cursors[m_triangles[triangleIdx][corner]]++] = triangleIdx; }
+    }
+}
+
+bool EdgeCollapser::isValidCollapse(uint32_t from, uint32_t to) {
+    // Triangles around the moved vertex which do not contain the edge survive, and must not flip or degenerate
+    uint32_t sharedTriangles = 0U;
+    m_ringFrom.clear();
+    for (uint32_t adjacencyIdx = m_adjacencyOffsets[from]; adjacencyIdx < m_adjacencyOffsets[from + 1U]; adjacencyIdx++) {
+        const glm::uvec3& triangle = m_triangles[m_adjacency[adjacencyIdx]];
+        for (glm::length_t corner = 0; corner < 3; corner++) {
+            if (triangle[corner] != from && triangle[corner] != to) { m_ringFrom.push_back(triangle[corner]); }
+        }
+        if (triangle.x == to || triangle.y == to || triangle.z == to) {
+            sharedTriangles++;
+            continue;
+        }
+
+        glm::dvec3 before[3], after[3];
+        for (glm::length_t corner = 0; corner < 3; corner++) {
+            before[corner]  = m_positions[triangle[corner]];
+            after[corner]   = triangle[corner] == from ? m_positions[to] : before[corner];
+        }
+        const glm::dvec3 normalBefore   = glm::cross(before[1] - before[0], before[2] - before[0]);
+        const glm::dvec3 normalAfter    = glm::cross(after[1] - after[0], after[2] - after[0]);
+        const double lengthBefore       = glm::length(normalBefore);
+        const double lengthAfter        = glm::length(normalAfter);
+        if (lengthAfter == 0.0 || (lengthBefore > 0.0 && glm::dot(normalBefore, normalAfter) < MIN_FLIP_COSINE * lengthBefore * lengthAfter)) { return false; }
+    }
+
+    // Link condition: only the vertices opposite the edge may neighbour both ends, otherwise the surface gets pinched
+    m_ringTo.clear();
+    for (uint32_t adjacencyIdx = m_adjacencyOffsets[to]; adjacencyIdx < m_adjacencyOffsets[to + 1U]; adjacencyIdx++) {
+        const glm::uvec3& triangle = m_triangles[m_adjacency[adjacencyIdx]];
+        for (glm::length_t corner = 0; corner < 3; corner++) {
+            if (triangle[corner] != from && triangle[corner] != to) { m_ringTo.push_back(triangle[corner]); }
+        }
+    }
+    std::sort(m_ringFrom.begin(), m_ringFrom.end());
+    m_ringFrom.erase(std::unique(m_ringFrom.begin(), m_ringFrom.end()), m_ringFrom.end());
+    std::sort(m_ringTo.begin(), m_ringTo.end());
+    m_ringTo.erase(std::unique(m_ringTo.begin(), m_ringTo.end()), m_ringTo.end());
+    uint32_t sharedNeighbours = 0U;
+    for (auto fromIt = m_ringFrom.begin(), toIt = m_ringTo.begin(); fromIt != m_ringFrom.end() && toIt != m_ringTo.end();) {
+        if (*fromIt < *toIt)        { fromIt++; }
+        else if (*toIt < *fromIt)   { toIt++; }
+        else                        { sharedNeighbours++; fromIt++; toIt++; }
+    }
+    return sharedNeighbours <= sharedTriangles;
+}
+
+float simplifyMesh(Mesh& mesh, size_t targetTriangles) {
+    EdgeCollapser collapser(mesh);
+    const float error   = collapser.collapseTo(targetTriangles);
+    Mesh simplified     = collapser.extract(mesh.vertices);
+    mesh.vertices       = std::move(simplified.vertices);
+    mesh.triangles      = std::move(simplified.triangles);
+    return error;
+}
+
+std::vector<MeshLod> appendLodChain(Mesh& mesh, bool optimize) {
+    std::vector<MeshLod> lods = { { .firstTriangle = 0U, .numTriangles = static_cast<uint32_t>(mesh.triangles.size()), .error = 0.0f } };
+    const size_t numOriginalVertices = mesh.vertices.size();
+    EdgeCollapser collapser(mesh);
+    while (lods.size() < MAX_MESH_LODS) {
+        const size_t targetTriangles = static_cast<size_t>(float(lods.back().numTriangles) * LOD_TRIANGLE_RATIO);
+        if (targetTriangles < MIN_LOD_TRIANGLES) { break; }
+        const float error = collapser.collapseTo(targetTriangles);
+        if (float(collapser.numTriangles()) > STALLED_REDUCTION * float(lods.back().numTriangles)) { break; }
+
+        // Levels index into the shared vertex array, after the vertices of the levels before them
+        Mesh level = collapser.extract(std::span(mesh.vertices).first(numOriginalVertices));
+        if (optimize) { optimizeMesh(level); }
+        const uint32_t firstVertex = static_cast<uint32_t>(mesh.vertices.size());
+        lods.push_back({ .firstTriangle = static_cast<uint32_t>(mesh.triangles.size()), .numTriangles = static_cast<uint32_t>(level.triangles.size()), .error = error });
+        mesh.vertices.insert(mesh.vertices.end(), level.vertices.begin(), level.vertices.end());
+        for (const glm::uvec3& triangle : level.triangles) { mesh.triangles.push_back(triangle + firstVertex); }
+    }
+    return lods;
+}
+
+size_t selectLod(std::span<const MeshLod> lods, float pixelsPerUnit, float maxPixelError) {
+    // Errors grow with every level, so the last acceptable one is the coarsest
+    size_t selected = 0ULL;
+    for (size_t lodIdx = 1ULL; lodIdx < lods.size(); lodIdx++) {
+        if (lods[lodIdx].error * pixelsPerUnit <= maxPixelError) { selected = lodIdx; }
+    }
+    return selected;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef _MESH_LOD_H_
+#define _MESH_LOD_H_
+
+#include <framework/mesh.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+constexpr size_t MAX_MESH_LODS          = 8ULL;     // Including the full-resolution mesh
+constexpr float LOD_TRIANGLE_RATIO      = 0.5f;     // Every level aims for this fraction of the triangles of the one before it
+constexpr size_t MIN_LOD_TRIANGLES      = 256ULL;   // Coarser levels are not worth a draw range of their own
+
+// Range of a mesh's triangles which makes up one level of detail
+struct MeshLod {
+    uint32_t firstTriangle;
+    uint32_t numTriangles;
+    float error;            // Geometric deviation from the full-resolution surface, in model units
+};
+
+/**
+ * Simplify a mesh in place by quadric error metric edge collapses (Garland and Heckbert, "Surface Simplification Using
+ * Quadric Error Metrics"). Every collapse moves a vertex onto one of its neighbours, so the remaining vertices keep their
+ * original attributes. Vertices on open or non-manifold edges, which includes both sides of attribute seams, are never
+ * moved so that no cracks open up
+ *
+ * @param mesh Mesh to simplify; unreferenced vertices are removed afterwards
+ * @param targetTriangles Number of triangles to stop at. Fewer collapses are made if no more are possible without flipping triangles
+ *
+ * @return Geometric deviation from the original surface, in model units
+*/
+float simplifyMesh(Mesh& mesh, size_t targetTriangles);
+
+/**
+ * Append a chain of progressively simplified versions of a mesh to its own vertices and triangles. Levels are simplified
+ * one after another from the same collapse state, so their errors are measured against the full-resolution mesh.
+ * Vertices are copied along with their d_N, which therefore stays the one traced against the full-resolution surface
+ *
+ * @param mesh Full-resolution mesh; its triangles become the first level
+ * @param optimize Whether to optimise every simplified level for the GPU (see mesh_optimizer.h)
+ *
+ * @return Triangle ranges of all levels, from finest to coarsest
+*/
+std::vector<MeshLod> appendLodChain(Mesh& mesh, bool optimize);
+
+// Coarsest level whose error covers at most maxPixelError pixels, given the screen size of one model unit
+size_t selectLod(std::span<const MeshLod> lods, float pixelsPerUnit, float maxPixelError);
+
+
+#endif // _MESH_LOD_H_
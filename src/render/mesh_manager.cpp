@@ -1,91 +1,182 @@
 #include "mesh_manager.h"
 
 #include <framework/mesh.h>
-#include <framework/ray.h>
 
-#include <framework/disable_all_warnings.h>
-DISABLE_WARNINGS_PUSH()
-#include <cereal/archives/binary.hpp>
-DISABLE_WARNINGS_POP()
 #include <omp.h>
 
 #include <ray_tracing/bounding_volume_hierarchy.h>
+#include <ray_tracing/inner_distances.h>
+#include <render/mesh_optimizer.h>
+#include <render/meshlets.h>
+#include <render/streaming_bake.h>
 #include <utils/constants.h>
-#include <utils/progressbar.hpp>
 
-
-#include <fstream>
+#include <chrono>
+#include <format>
 #include <iostream>
 
 
 MeshManager::MeshManager(const Config& config, const std::filesystem::path& filePath)
-    : m_config(config) {
-    if (!std::filesystem::exists(utils::CACHE_PATH)) { std::filesystem::create_directory(utils::CACHE_PATH); }
+    : m_config(config)
+    , m_cacheDirectory(utils::CACHE_PATH, static_cast<uint64_t>(config.cacheBudgetMiB) << 20ULL)
+    , m_cacheWriter(m_cacheDirectory, utils::MAX_QUEUED_CACHE_WRITES) {
     loadNewMesh(filePath);
 }
 
 void MeshManager::loadNewMesh(const std::filesystem::path& filePath) {
-    // Construct file path for cache file
-    std::filesystem::path cacheFile = filePath.filename();
-    cacheFile.replace_extension("cache");
-    std::filesystem::path cachePath = utils::CACHE_PATH / cacheFile;
-
-    // Acquire mesh on the CPU from either a cache file or by doing computations on a model file
-    Mesh cpuMesh;
-    if (std::filesystem::exists(cachePath)) {
+    // Cache files picked explicitly are trusted as-is, there is no model to validate them against
+    if (filePath.extension() == ".cache") {
+        std::cout << "Loading cached file " << filePath << std::endl;
+        uploadCached(MeshCacheView(filePath));
+        m_cacheDirectory.touch(filePath);
+        m_modelPath.clear();
+        return;
+    }
+
+    // Upload straight from the mapped cache file if it is still valid for this model
+    // A write of that very cache may still be underway, in which case it is worth waiting for
+    m_modelPath                     = filePath;
+    std::filesystem::path cachePath = cachePathForModel(filePath);
+    if (m_cacheWriter.isPending(cachePath)) { m_cacheWriter.flush(); }
+    if (std::optional<MeshCacheView> cache = openValidCache(cachePath, filePath)) {
         std::cout << "Loading cached file " << cachePath << std::endl;
-        cpuMesh = loadCached(cachePath);
+        uploadCached(*cache);
+        m_cacheDirectory.touch(cachePath);
+        if (cache->header().compressed != wantsCompressedCache(m_config, cache->header().bake)) { transcodeCache(cachePath, filePath, cache); }
+        return;
     }
-    else {
-        std::cout << "Loading model file " << filePath << std::endl;
-        cpuMesh = loadAndComputeDist(filePath);
-        saveMeshCache(cpuMesh, cachePath);
+
+    // Otherwise compute inner distances from the model itself
+    // Fingerprint before loading so that edits made during the bake invalidate the cache
+    CacheHeader header = { .source = fingerprintModel(filePath), .bake = currentBakeParameters(m_config, filePath) };
+    header.compressed  = wantsCompressedCache(m_config, header.bake);
+    m_cacheDirectory.setByteBudget(static_cast<uint64_t>(m_config.cacheBudgetMiB) << 20ULL);
+
+    // Streamed bakes never hold the whole model in memory; they write the cache as they go and the GPU reads from its mapping
+    if (header.bake.streamed) {
+        std::cout << "Streaming model file " << filePath << std::endl;
+        m_cacheDirectory.store(cachePath, filePath, header.bake, [&](const std::filesystem::path& temporaryPath) { streamBake(filePath, temporaryPath, header, m_config); });
+        uploadCached(MeshCacheView(cachePath));
+        return;
     }
 
-    // Free old mesh (if it exists) and Load new mesh onto the GPU
-    m_mesh.reset(new GPUMesh(cpuMesh));
+    std::cout << "Loading model file " << filePath << std::endl;
+    Mesh mesh                       = loadAndComputeDist(filePath);
+    std::vector<MeshLod> lods       = header.bake.lods ? generateLods(mesh) : std::vector<MeshLod> {};
+    std::vector<Meshlet> meshlets   = buildMeshlets(mesh.vertices, mesh.triangles, lods);
+    auto cpuMesh                    = std::make_shared<const Mesh>(std::move(mesh));
+
+    // Free old mesh (if it exists) and Load new mesh onto the GPU, then cache it for subsequent loads in the background
+    m_mesh.reset(new GPUMesh(*cpuMesh, lods, meshlets));
+    m_meshVersion++;
+    m_cacheWriter.enqueue(cachePath, filePath, header, std::move(cpuMesh), std::move(lods), std::move(meshlets));
 }
 
 Mesh MeshManager::loadAndComputeDist(const std::filesystem::path& modelPath) {
     // Load mesh into CPU and construct BVH
-    std::vector<Mesh> allLoadedMeshes   = loadMesh(modelPath, true);
+    std::vector<Mesh> allLoadedMeshes   = loadMesh(modelPath, true, m_config.parallelObjParsing);
     Mesh& mainMeshCPU                   = allLoadedMeshes[0];
-    BoundingVolumeHierarchy bvh(mainMeshCPU, m_config);
-
-    // Compute d_N for every vertex in the mesh
-    // We have to use an index-based loop WITH A FUCKING SIGNED INT because MSVC OpenMP support is stuck in 2006
-    HitInfo dummyHit;
-    progressbar progressbar(static_cast<int32_t>(mainMeshCPU.vertices.size()));
-    std::cout << "Computing inner distances..." << std::endl;
-    #pragma omp parallel for
-    for (int32_t vertexIdx = 0; vertexIdx < mainMeshCPU.vertices.size(); vertexIdx++) {
-        Vertex& vertex          = mainMeshCPU.vertices[vertexIdx];
-        glm::vec3 reverseNormal = -vertex.normal;
-        Ray interiorRay = {
-            .origin     = vertex.position + utils::INTERIOR_RAY_OFFSET * reverseNormal,
-            .direction  = reverseNormal,
-            .t          = std::numeric_limits<float>::max()
-        };
-        bvh.intersect(interiorRay, dummyHit);
-        vertex.distanceInner = interiorRay.t;
-
-        #pragma omp critical
-        progressbar.update();
+    if (m_config.weldVertices) { weldAndSmooth(mainMeshCPU); }
+    if (m_config.optimizeMesh) { optimizeForGPU(mainMeshCPU); }
+
+    // Tracing only reads positions and normals and only writes d_N, so it streams through separate arrays of each
+    MeshSoA meshSoA = meshToSoA(mainMeshCPU);
+    {
+        BoundingVolumeHierarchy bvh(mainMeshCPU, m_config);
+        computeInnerDistances(meshSoA.positions, meshSoA.normals, meshSoA.distancesInner, bvh);
     }
-    std::cout << std::endl << "Finished computing inner distances!" << std::endl;
-    return mainMeshCPU;
+    return meshFromSoA(std::move(meshSoA));
+}
+
+void MeshManager::weldAndSmooth(Mesh& mesh) const {
+    // Split vertices at seams would otherwise send their d_N rays along diverging normals
+    const auto start                = std::chrono::steady_clock::now();
+    const size_t originalVertices   = mesh.vertices.size();
+    const size_t removedVertices    = meshWeldVertices(mesh, m_config.weldEpsilon);
+    meshComputeSmoothNormals(mesh);
+    const double milliseconds       = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::format("Welded {} of {} vertices and regenerated normals in {:.1f} ms", removedVertices, originalVertices, milliseconds) << std::endl;
+}
+
+void MeshManager::optimizeForGPU(Mesh& mesh) const {
+    // Every frame draws the mesh several times, so the reordering is baked into the cache rather than redone on load
+    const auto start                        = std::chrono::steady_clock::now();
+    const VertexCacheStatistics original    = analyzeVertexCache(mesh.triangles, mesh.vertices.size());
+    optimizeMesh(mesh);
+    const VertexCacheStatistics optimized   = analyzeVertexCache(mesh.triangles, mesh.vertices.size());
+    const double milliseconds               = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::format("Optimised mesh for the GPU in {:.1f} ms: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f} ({}-entry FIFO cache)",
+                             milliseconds, original.acmr, optimized.acmr, original.atvr, optimized.atvr, VERTEX_CACHE_SIZE) << std::endl;
+}
+
+std::vector<MeshLod> MeshManager::generateLods(Mesh& mesh) const {
+    // Simplification only ever keeps original vertices, so every level inherits the d_N traced against the full-resolution BVH
+    const auto start                = std::chrono::steady_clock::now();
+    std::vector<MeshLod> lods       = appendLodChain(mesh, m_config.optimizeMesh);
+    const double milliseconds       = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::format("Generated {} levels of detail in {:.1f} ms (triangles and error of each):", lods.size(), milliseconds);
+    for (const MeshLod& lod : lods) { std::cout << std::format(" {} ({:.2e})", lod.numTriangles, lod.error); }
+    std::cout << std::endl;
+    return lods;
+}
+
+void MeshManager::updateCacheFormat() {
+    if (m_modelPath.empty()) { return; }
+    const std::filesystem::path cachePath = cachePathForModel(m_modelPath);
+    if (m_cacheWriter.isPending(cachePath)) { m_cacheWriter.flush(); }
+    std::optional<MeshCacheView> cache = openValidCache(cachePath, m_modelPath);
+    if (cache && cache->header().compressed != wantsCompressedCache(m_config, cache->header().bake)) { transcodeCache(cachePath, m_modelPath, cache); }
+}
+
+void MeshManager::transcodeCache(const std::filesystem::path& cachePath, const std::filesystem::path& modelPath, std::optional<MeshCacheView>& cache) {
+    // Both payload formats hold the same bake, so only the storage is rewritten; d_N is never traced again
+    CacheHeader header  = cache->header();
+    header.compressed   = !header.compressed;
+    auto mesh           = std::make_shared<const Mesh>(cache->toMesh());
+    std::vector<MeshLod> lods(cache->lods().begin(), cache->lods().end());
+    std::vector<Meshlet> meshlets(cache->meshlets().begin(), cache->meshlets().end());
+
+    // The writer replaces the file, which must not be mapped any more by then
+    cache.reset();
+    std::cout << std::format("Rewriting cache file {} {}", cachePath.string(), header.compressed ? "compressed" : "uncompressed") << std::endl;
+    m_cacheDirectory.setByteBudget(static_cast<uint64_t>(m_config.cacheBudgetMiB) << 20ULL);
+    m_cacheWriter.enqueue(cachePath, modelPath, header, std::move(mesh), std::move(lods), std::move(meshlets));
 }
 
-Mesh MeshManager::loadCached(const std::filesystem::path& cachePath) {
-    Mesh cpuMesh;
-    std::ifstream fileStream(cachePath, std::ios::binary);
-    cereal::BinaryInputArchive cacheArchive(fileStream);
-    cacheArchive(cpuMesh);
-    return cpuMesh;
+void MeshManager::uploadCached(const MeshCacheView& cache) {
+    // Uncompressed data goes straight from the mapping to the GPU, compressed data needs decoding first
+    if (cache.isEncoded())  { m_mesh.reset(new GPUMesh(cache.toMesh(), cache.lods(), cache.meshlets())); }
+    else                    { m_mesh.reset(new GPUMesh(cache.vertices(), cache.triangles(), cache.material(), cache.lods(), cache.meshlets())); }
+    m_meshVersion++;
 }
 
-void MeshManager::saveMeshCache(const Mesh& mesh, const std::filesystem::path& cachePath) {
-    std::ofstream fileStream(cachePath, std::ios::binary);
-    cereal::BinaryOutputArchive cacheArchive(fileStream);
-    cacheArchive(mesh);
+std::optional<MeshCacheView> MeshManager::openValidCache(const std::filesystem::path& cachePath, const std::filesystem::path& modelPath) {
+    if (!std::filesystem::exists(cachePath)) { return std::nullopt; }
+
+    // Unreadable or outdated layouts are treated the same as stale data
+    std::optional<MeshCacheView> cache;
+    try {
+        cache.emplace(cachePath);
+    } catch (const std::runtime_error& error) {
+        std::cout << error.what() << ", rebuilding" << std::endl;
+        return std::nullopt;
+    }
+
+    CacheHeader header          = cache->header();
+    CacheValidation validation  = validateCacheHeader(header, modelPath, currentBakeParameters(m_config, modelPath));
+    if (!validation.valid) {
+        std::cout << "Cache file " << cachePath << " is out of date, rebuilding" << std::endl;
+        return std::nullopt;
+    }
+
+    // The header has a fixed size, so a refreshed timestamp can be written back in place. The contents are still valid if
+    // that fails, the check just has to be repeated on the next load
+    if (validation.headerRefreshed) {
+        try {
+            rewriteCacheSource(cachePath, header.source);
+        } catch (const MeshCacheException& error) {
+            std::cout << error.what() << ", keeping the cache" << std::endl;
+        }
+    }
+    return cache;
 }
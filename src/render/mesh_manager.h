@@ -2,26 +2,45 @@
 #ifndef _MESH_MANAGER_H_
 #define _MESH_MANAGER_H_
 
+#include <render/cache_directory.h>
+#include <render/cache_writer.h>
 #include <render/mesh.h>
+#include <render/mesh_cache.h>
+#include <render/mesh_lod.h>
 #include <utils/config.h>
 
+#include <cstdint>
 #include <filesystem>
 #include <memory>
+#include <optional>
+#include <vector>
 
 class MeshManager {
 public:
     MeshManager(const Config& config, const std::filesystem::path& filePath);
 
     GPUMesh& getMesh() { return *m_mesh; }
+    uint64_t meshVersion() const { return m_meshVersion; }   // Changes whenever a different mesh is uploaded
+    CacheDirectory& cacheDirectory() { return m_cacheDirectory; }
     void loadNewMesh(const std::filesystem::path& filePath);
+    // Rewrite the cache of the current model in the configured payload format, e.g. after Config::compressCache changed
+    void updateCacheFormat();
 
 private:
     Mesh loadAndComputeDist(const std::filesystem::path& modelPath);
-    Mesh loadCached(const std::filesystem::path& cachePath);
-    void saveMeshCache(const Mesh& mesh, const std::filesystem::path& cachePath);
+    void weldAndSmooth(Mesh& mesh) const;
+    void optimizeForGPU(Mesh& mesh) const;
+    std::vector<MeshLod> generateLods(Mesh& mesh) const;
+    void uploadCached(const MeshCacheView& cache);
+    std::optional<MeshCacheView> openValidCache(const std::filesystem::path& cachePath, const std::filesystem::path& modelPath);
+    void transcodeCache(const std::filesystem::path& cachePath, const std::filesystem::path& modelPath, std::optional<MeshCacheView>& cache);
 
     const Config& m_config;
+    CacheDirectory m_cacheDirectory;
+    CacheWriter m_cacheWriter;          // Declared after the directory it writes into, so it is flushed before the directory goes away
     std::unique_ptr<GPUMesh> m_mesh;
+    std::filesystem::path m_modelPath;  // Model the current mesh was loaded from; empty if it came from a cache file picked explicitly
+    uint64_t m_meshVersion { 0ULL };
 };
 
 
@@ -0,0 +1,268 @@
+#include "mesh_optimizer.h"
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/geometric.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+
+static constexpr uint32_t NO_TRIANGLE = std::numeric_limits<uint32_t>::max();
+static constexpr uint32_t NO_VERTEX   = std::numeric_limits<uint32_t>::max();
+
+// Scoring parameters from Forsyth's article
+static constexpr uint32_t FORSYTH_CACHE_SIZE    = 32U;
+static constexpr float CACHE_DECAY_POWER        = 1.5f;
+static constexpr float LAST_TRIANGLE_SCORE      = 0.75f;
+static constexpr float VALENCE_BOOST_SCALE      = 2.0f;
+static constexpr float VALENCE_BOOST_POWER      = 0.5f;
+static constexpr uint32_t MAX_SCORED_VALENCE    = 64U; // Valence boosts are tabulated up to here and clamped beyond
+
+// FIFO cache emulated with timestamps: a vertex is still cached if fewer than cacheSize misses happened since it was transformed
+class FifoCache {
+public:
+    FifoCache(size_t numVertices, uint32_t cacheSize)
+        : m_timestamps(numVertices, 0U)
+        , m_cacheSize(cacheSize)
+        , m_time(cacheSize + 1U) {}
+
+    // Returns the number of vertices of the triangle that had to be transformed
+    uint32_t reference(const glm::uvec3& triangle) {
+        uint32_t misses = 0U;
+        for (glm::length_t corner = 0; corner < 3; corner++) {
+            if (m_time - m_timestamps[triangle[corner]] > m_cacheSize) {
+                m_timestamps[triangle[corner]] = m_time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    void flush() { m_time += m_cacheSize + 1U; }
+
+private:
+    std::vector<uint32_t> m_timestamps;
+    const uint32_t m_cacheSize;
+    uint32_t m_time;
+};
+
+VertexCacheStatistics analyzeVertexCache(std::span<const glm::uvec3> triangles, size_t numVertices, uint32_t cacheSize) {
+    FifoCache cache(numVertices, cacheSize);
+    std::vector<uint8_t> referenced(numVertices, 0U);
+    uint64_t misses = 0ULL, numReferenced = 0ULL;
+    for (const glm::uvec3& triangle : triangles) {
+        misses += cache.reference(triangle);
+        for (glm::length_t corner = 0; corner < 3; corner++) {
+            numReferenced                  += referenced[triangle[corner]] == 0U;
+            referenced[triangle[corner]]    = 1U;
+        }
+    }
+    return { .acmr = triangles.empty()  ? 0.0f : float(misses) / float(triangles.size()),
+             .atvr = numReferenced == 0 ? 0.0f : float(misses) / float(numReferenced) };
+}
+
+void optimizeVertexCache(std::span<glm::uvec3> triangles, size_t numVertices) {
+    const size_t numTriangles = triangles.size();
+    if (numTriangles == 0ULL) { return; }
+
+    // Triangles adjacent to every vertex (CSR). Emitted triangles are swapped out of the valence[vertex] entries still in use
+    std::vector<uint32_t> valence(numVertices, 0U);
+    for (const glm::uvec3& triangle : triangles) { valence[triangle.x]++; valence[triangle.y]++; valence[triangle.z]++; }
+    std::vector<uint32_t> adjacencyOffsets(numVertices + 1ULL, 0U);
+    std::inclusive_scan(valence.begin(), valence.end(), adjacencyOffsets.begin() + 1);
+    std::vector<uint32_t> adjacency(3ULL * numTriangles);
+    {
+        std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (uint32_t triangleIdx = 0U; triangleIdx < numTriangles; triangleIdx++) {
+            for (glm::length_t corner = 0; corner < 3; corner++) { adjacency[cursors[triangles[triangleIdx][corner]]++] = triangleIdx; }
+        }
+    }
+
+    // Tabulated vertex scores; the three most recently used vertices get a fixed score so that strips are not favoured
+    std::array<float, FORSYTH_CACHE_SIZE> cacheScores;
+    for (uint32_t position = 0U; position < FORSYTH_CACHE_SIZE; position++) {
+        cacheScores[position] = position < 3U ? LAST_TRIANGLE_SCORE : std::pow(1.0f - float(position - 3U) / float(FORSYTH_CACHE_SIZE - 3U), CACHE_DECAY_POWER);
+    }
+    std::array<float, MAX_SCORED_VALENCE + 1U> valenceScores;
+    valenceScores[0] = 0.0f;
+    for (uint32_t remaining = 1U; remaining <= MAX_SCORED_VALENCE; remaining++) { valenceScores[remaining] = VALENCE_BOOST_SCALE * std::pow(float(remaining), -VALENCE_BOOST_POWER); }
+    std::vector<int32_t> cachePosition(numVertices, -1);
+    auto vertexScore = [&](uint32_t vertex) {
+        return (cachePosition[vertex] >= 0 ? cacheScores[static_cast<size_t>(cachePosition[vertex])] : 0.0f) + valenceScores[std::min(valence[vertex], MAX_SCORED_VALENCE)];
+    };
+
+    std::vector<float> vertexScores(numVertices);
+    for (uint32_t vertex = 0U; vertex < numVertices; vertex++) { vertexScores[vertex] = vertexScore(vertex); }
+    std::vector<float> triangleScores(numTriangles);
+    for (size_t triangleIdx = 0ULL; triangleIdx < numTriangles; triangleIdx++) {
+        const glm::uvec3& triangle  = triangles[triangleIdx];
+        triangleScores[triangleIdx] = vertexScores[triangle.x] + vertexScores[triangle.y] + vertexScores[triangle.z];
+    }
+
+    std::vector<glm::uvec3> output;
+    output.reserve(numTriangles);
+    std::vector<uint8_t> emitted(numTriangles, 0U);
+    std::array<uint32_t, FORSYTH_CACHE_SIZE + 3U> cache, nextCache;
+    size_t cacheSize        = 0ULL;
+    size_t deadEndCursor    = 0ULL; // Triangles before this one have all been emitted
+    uint32_t bestTriangle   = static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+    while (output.size() < numTriangles) {
+        // Nothing next to the cache is left, continue with the first remaining triangle in input order
+        if (bestTriangle == NO_TRIANGLE) {
+            while (emitted[deadEndCursor]) { deadEndCursor++; }
+            bestTriangle = static_cast<uint32_t>(deadEndCursor);
+        }
+        const glm::uvec3 triangle = triangles[bestTriangle];
+        output.push_back(triangle);
+        emitted[bestTriangle] = 1U;
+        for (glm::length_t corner = 0; corner < 3; corner++) {
+            const uint32_t vertex   = triangle[corner];
+            uint32_t* begin         = adjacency.data() + adjacencyOffsets[vertex];
+            uint32_t* end           = begin + valence[vertex];
+            std::iter_swap(std::find(begin, end, bestTriangle), end - 1);
+            valence[vertex]--;
+        }
+
+        // Move the triangle's vertices to the front of the (LRU) cache, pushing the rest back
+        size_t nextCacheSize = 0ULL;
+        for (glm::length_t corner = 0; corner < 3; corner++) {
+            if (std::find(nextCache.begin(), nextCache.begin() + nextCacheSize, triangle[corner]) == nextCache.begin() + nextCacheSize) { nextCache[nextCacheSize++] = triangle[corner]; }
+        }
+        for (size_t cacheIdx = 0ULL; cacheIdx < cacheSize; cacheIdx++) {
+            if (cache[cacheIdx] != triangle.x && cache[cacheIdx] != triangle.y && cache[cacheIdx] != triangle.z) { nextCache[nextCacheSize++] = cache[cacheIdx]; }
+        }
+
+        // Rescore the vertices whose cache position changed, and the remaining triangles around them.
+        // Only triangles next to vertices that are still cached are candidates for the next step
+        for (size_t cacheIdx = 0ULL; cacheIdx < nextCacheSize; cacheIdx++) {
+            const uint32_t vertex   = nextCache[cacheIdx];
+            cachePosition[vertex]   = cacheIdx < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(cacheIdx) : -1;
+            vertexScores[vertex]    = vertexScore(vertex);
+        }
+        bestTriangle    = NO_TRIANGLE;
+        float bestScore = -1.0f;
+        for (size_t cacheIdx = 0ULL; cacheIdx < nextCacheSize; cacheIdx++) {
+            const uint32_t vertex = nextCache[cacheIdx];
+            for (uint32_t adjacencyIdx = adjacencyOffsets[vertex]; adjacencyIdx < adjacencyOffsets[vertex] + valence[vertex]; adjacencyIdx++) {
+                const uint32_t triangleIdx      = adjacency[adjacencyIdx];
+                const glm::uvec3& neighbour     = triangles[triangleIdx];
+                triangleScores[triangleIdx]     = vertexScores[neighbour.x] + vertexScores[neighbour.y] + vertexScores[neighbour.z];
+                if (cacheIdx < FORSYTH_CACHE_SIZE && triangleScores[triangleIdx] > bestScore) {
+                    bestScore       = triangleScores[triangleIdx];
+                    bestTriangle    = triangleIdx;
+                }
+            }
+        }
+        cacheSize = std::min(nextCacheSize, size_t(FORSYTH_CACHE_SIZE));
+        std::copy(nextCache.begin(), nextCache.begin() + cacheSize, cache.begin());
+    }
+    std::copy(output.begin(), output.end(), triangles.begin());
+}
+
+void optimizeOverdraw(std::span<glm::uvec3> triangles, std::span<const Vertex> vertices, float threshold) {
+    const size_t numTriangles = triangles.size();
+    if (numTriangles < 2ULL) { return; }
+
+    // Hard boundaries lie where the cache was effectively flushed anyway (all three vertices missed),
+    // so clusters can be moved around without any extra vertex transforms
+    FifoCache cache(vertices.size(), VERTEX_CACHE_SIZE);
+    std::vector<uint32_t> hardBoundaries = { 0U };
+    for (uint32_t triangleIdx = 0U; triangleIdx < numTriangles; triangleIdx++) {
+        if (cache.reference(triangles[triangleIdx]) == 3U && triangleIdx > 0U) { hardBoundaries.push_back(triangleIdx); }
+    }
+    hardBoundaries.push_back(static_cast<uint32_t>(numTriangles));
+
+    // Soft boundaries split hard clusters further wherever the ACMR so far is within the threshold of the cluster's own
+    std::vector<uint32_t> clusterStarts;
+    for (size_t hardIdx = 0ULL; hardIdx + 1ULL < hardBoundaries.size(); hardIdx++) {
+        const uint32_t start = hardBoundaries[hardIdx], end = hardBoundaries[hardIdx + 1ULL];
+        cache.flush();
+        uint32_t clusterMisses = 0U;
+        for (uint32_t triangleIdx = start; triangleIdx < end; triangleIdx++) { clusterMisses += cache.reference(triangles[triangleIdx]); }
+        const float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+        cache.flush();
+        clusterStarts.push_back(start);
+        uint32_t runningMisses = 0U, runningTriangles = 0U;
+        for (uint32_t triangleIdx = start; triangleIdx + 1U < end; triangleIdx++) {
+            runningMisses += cache.reference(triangles[triangleIdx]);
+            runningTriangles++;
+            if (float(runningMisses) / float(runningTriangles) <= clusterThreshold) {
+                clusterStarts.push_back(triangleIdx + 1U);
+                cache.flush();
+                runningMisses = runningTriangles = 0U;
+            }
+        }
+    }
+    clusterStarts.push_back(static_cast<uint32_t>(numTriangles));
+    const size_t numClusters = clusterStarts.size() - 1ULL;
+
+    // Area-weighted centroid and normal of every cluster and of the mesh as a whole
+    std::vector<glm::vec3> clusterCentroids(numClusters), clusterNormals(numClusters);
+    glm::dvec3 meshCentroid(0.0);
+    double meshArea = 0.0;
+    for (size_t clusterIdx = 0ULL; clusterIdx < numClusters; clusterIdx++) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (uint32_t triangleIdx = clusterStarts[clusterIdx]; triangleIdx < clusterStarts[clusterIdx + 1ULL]; triangleIdx++) {
+            const glm::vec3& v0             = vertices[triangles[triangleIdx].x].position;
+            const glm::vec3& v1             = vertices[triangles[triangleIdx].y].position;
+            const glm::vec3& v2             = vertices[triangles[triangleIdx].z].position;
+            const glm::vec3 scaledNormal    = glm::cross(v1 - v0, v2 - v0);
+            const float triangleArea        = glm::length(scaledNormal);
+            centroid                       += (v0 + v1 + v2) * (triangleArea / 3.0f);
+            normal                         += scaledNormal;
+            area                           += triangleArea;
+        }
+        meshCentroid                   += glm::dvec3(centroid);
+        meshArea                       += static_cast<double>(area);
+        clusterCentroids[clusterIdx]    = area > 0.0f ? centroid / area : centroid;
+        clusterNormals[clusterIdx]      = normal;
+    }
+    if (meshArea > 0.0) { meshCentroid /= meshArea; }
+
+    // Clusters far out along their own normal are likely to occlude the others, so they go first
+    std::vector<float> sortKeys(numClusters);
+    for (size_t clusterIdx = 0ULL; clusterIdx < numClusters; clusterIdx++) {
+        const float normalLength    = glm::length(clusterNormals[clusterIdx]);
+        sortKeys[clusterIdx]        = normalLength > 0.0f ? glm::dot(clusterCentroids[clusterIdx] - glm::vec3(meshCentroid), clusterNormals[clusterIdx] / normalLength) : 0.0f;
+    }
+    std::vector<uint32_t> clusterOrder(numClusters);
+    std::iota(clusterOrder.begin(), clusterOrder.end(), 0U);
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t lhs, uint32_t rhs) { return sortKeys[lhs] > sortKeys[rhs]; });
+
+    std::vector<glm::uvec3> output;
+    output.reserve(numTriangles);
+    for (uint32_t clusterIdx : clusterOrder) { output.insert(output.end(), triangles.begin() + clusterStarts[clusterIdx], triangles.begin() + clusterStarts[clusterIdx + 1ULL]); }
+    std::copy(output.begin(), output.end(), triangles.begin());
+}
+
+void optimizeVertexFetch(Mesh& mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), NO_VERTEX);
+    uint32_t numRemapped = 0U;
+    for (glm::uvec3& triangle : mesh.triangles) {
+        for (glm::length_t corner = 0; corner < 3; corner++) {
+            if (remap[triangle[corner]] == NO_VERTEX) { remap[triangle[corner]] = numRemapped++; }
+            triangle[corner] = remap[triangle[corner]];
+        }
+    }
+    for (uint32_t& newIndex : remap) {
+        if (newIndex == NO_VERTEX) { newIndex = numRemapped++; }
+    }
+
+    std::vector<Vertex> vertices(mesh.vertices.size());
+    for (size_t vertexIdx = 0ULL; vertexIdx < mesh.vertices.size(); vertexIdx++) { vertices[remap[vertexIdx]] = mesh.vertices[vertexIdx]; }
+    mesh.vertices = std::move(vertices);
+}
+
+void optimizeMesh(Mesh& mesh) {
+    optimizeVertexCache(mesh.triangles, mesh.vertices.size());
+    optimizeOverdraw(mesh.triangles, mesh.vertices);
+    optimizeVertexFetch(mesh);
+}
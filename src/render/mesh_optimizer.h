@@ -0,0 +1,45 @@
+#pragma once
+#ifndef _MESH_OPTIMIZER_H_
+#define _MESH_OPTIMIZER_H_
+
+#include <framework/mesh.h>
+
+#include <cstdint>
+#include <span>
+
+// FIFO size of the post-transform cache modelled when analysing and reordering. Small enough to be
+// pessimistic for current GPUs, whose effective reuse window depends on their batching of vertices
+constexpr uint32_t VERTEX_CACHE_SIZE = 16U;
+// Largest increase in ACMR the overdraw optimisation may trade for a better drawing order
+constexpr float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+struct VertexCacheStatistics {
+    float acmr; // Average cache miss ratio: transformed vertices per triangle (0.5 at best, 3 at worst)
+    float atvr; // Average transformed vertex ratio: transformed vertices per referenced vertex (1 at best)
+};
+
+// Simulate a FIFO post-transform vertex cache over the triangles in drawing order
+VertexCacheStatistics analyzeVertexCache(std::span<const glm::uvec3> triangles, size_t numVertices, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorder triangles for vertex cache locality (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+void optimizeVertexCache(std::span<glm::uvec3> triangles, size_t numVertices);
+
+/**
+ * Reorder clusters of a vertex cache optimised triangle sequence so that outward facing, outer clusters are drawn first,
+ * which reduces overdraw from any viewpoint (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+ *
+ * @param triangles Triangles as produced by optimizeVertexCache()
+ * @param vertices Vertices the triangles refer to
+ * @param threshold Largest factor by which the ACMR of a cluster may grow when it is split into smaller clusters
+*/
+void optimizeOverdraw(std::span<glm::uvec3> triangles, std::span<const Vertex> vertices, float threshold = OVERDRAW_ACMR_THRESHOLD);
+
+// Renumber vertices in the order in which the triangles first reference them, so that vertex fetches are sequential.
+// Vertices no triangle refers to are moved to the end
+void optimizeVertexFetch(Mesh& mesh);
+
+// All of the above, in order
+void optimizeMesh(Mesh& mesh);
+
+
+#endif // _MESH_OPTIMIZER_H_
@@ -0,0 +1,120 @@
+#include "meshlets.h"
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_access.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+static constexpr uint32_t NO_MESHLET        = std::numeric_limits<uint32_t>::max();
+static constexpr float MIN_CONE_COSINE      = 0.1f; // Clusters with normals spread further than ~84 degrees from the axis are never cone culled
+
+static Meshlet meshletBounds(std::span<const Vertex> vertices, std::span<const glm::uvec3> triangles, uint32_t firstTriangle, uint32_t numTriangles) {
+    // Sphere around the centre of the bounding box
+    glm::vec3 lower(std::numeric_limits<float>::max()), upper(std::numeric_limits<float>::lowest());
+    glm::vec3 normalSum(0.0f);
+    for (uint32_t triangleIdx = firstTriangle; triangleIdx < firstTriangle + numTriangles; triangleIdx++) {
+        const glm::uvec3& triangle = triangles[triangleIdx];
+        for (glm::length_t corner = 0; corner < 3; corner++) {
+            lower = glm::min(lower, vertices[triangle[corner]].position);
+            upper = glm::max(upper, vertices[triangle[corner]].position);
+        }
+        const glm::vec3 normal  = glm::cross(vertices[triangle.y].position - vertices[triangle.x].position, vertices[triangle.z].position - vertices[triangle.x].position);
+        const float length      = glm::length(normal);
+        if (length > 0.0f) { normalSum += normal / length; }
+    }
+    const glm::vec3 center  = 0.5f * (lower + upper);
+    float radius            = 0.0f;
+    for (uint32_t triangleIdx = firstTriangle; triangleIdx < firstTriangle + numTriangles; triangleIdx++) {
+        for (glm::length_t corner = 0; corner < 3; corner++) { radius = std::max(radius, glm::length(vertices[triangles[triangleIdx][corner]].position - center)); }
+    }
+
+    // Cone around the average geometric normal, which is what decides the facing of a triangle
+    Meshlet meshlet = { .firstTriangle = firstTriangle, .numTriangles = numTriangles, .center = center, .radius = radius, .coneAxis = glm::vec3(0.0f), .coneCutoff = 1.0f };
+    const float axisLength = glm::length(normalSum);
+    if (axisLength == 0.0f) { return meshlet; }
+    meshlet.coneAxis    = normalSum / axisLength;
+    float minCosine     = 1.0f;
+    for (uint32_t triangleIdx = firstTriangle; triangleIdx < firstTriangle + numTriangles; triangleIdx++) {
+        const glm::uvec3& triangle  = triangles[triangleIdx];
+        const glm::vec3 normal      = glm::cross(vertices[triangle.y].position - vertices[triangle.x].position, vertices[triangle.z].position - vertices[triangle.x].position);
+        const float length          = glm::length(normal);
+        if (length > 0.0f) { minCosine = std::min(minCosine, glm::dot(normal / length, meshlet.coneAxis)); }
+    }
+    if (minCosine > MIN_CONE_COSINE) { meshlet.coneCutoff = std::sqrt(1.0f - minCosine * minCosine); }
+    return meshlet;
+}
+
+std::vector<Meshlet> buildMeshlets(std::span<const Vertex> vertices, std::span<const glm::uvec3> triangles, std::span<const MeshLod> lods) {
+    const MeshLod allTriangles  = { .firstTriangle = 0U, .numTriangles = static_cast<uint32_t>(triangles.size()), .error = 0.0f };
+    if (lods.empty()) { lods = std::span(&allTriangles, 1ULL); }
+
+    // Vertices are marked with the meshlet that last used them, which makes membership tests free
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertexMeshlet(vertices.size(), NO_MESHLET);
+    uint32_t meshletId = 0U;
+    for (const MeshLod& lod : lods) {
+        uint32_t firstTriangle = lod.firstTriangle, numVertices = 0U;
+        for (uint32_t triangleIdx = lod.firstTriangle; triangleIdx < lod.firstTriangle + lod.numTriangles; triangleIdx++) {
+            const glm::uvec3& triangle  = triangles[triangleIdx];
+            const uint32_t newVertices  = uint32_t(vertexMeshlet[triangle.x] != meshletId)
+                                        + uint32_t(vertexMeshlet[triangle.y] != meshletId && triangle.y != triangle.x)
+                                        + uint32_t(vertexMeshlet[triangle.z] != meshletId && triangle.z != triangle.x && triangle.z != triangle.y);
+            if (numVertices + newVertices > MESHLET_MAX_VERTICES || triangleIdx - firstTriangle == MESHLET_MAX_TRIANGLES) {
+                meshlets.push_back(meshletBounds(vertices, triangles, firstTriangle, triangleIdx - firstTriangle));
+                firstTriangle   = triangleIdx;
+                numVertices     = 0U;
+                meshletId++;
+            }
+            for (glm::length_t corner = 0; corner < 3; corner++) {
+                if (vertexMeshlet[triangle[corner]] != meshletId) {
+                    vertexMeshlet[triangle[corner]] = meshletId;
+                    numVertices++;
+                }
+            }
+        }
+        if (firstTriangle < lod.firstTriangle + lod.numTriangles) { meshlets.push_back(meshletBounds(vertices, triangles, firstTriangle, lod.firstTriangle + lod.numTriangles - firstTriangle)); }
+        meshletId++;
+    }
+    return meshlets;
+}
+
+CullingView CullingView::everything() {
+    CullingView view;
+    view.frustumPlanes.fill(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    view.cameraPosition = glm::vec3(0.0f);
+    return view;
+}
+
+CullingView makeCullingView(const glm::mat4& model, const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition) {
+    // Planes of the clip volume -w <= x, y, z <= w, pulled back into model space (Gribb and Hartmann)
+    CullingView view;
+    const glm::vec4 rowW = glm::row(modelViewProjection, 3);
+    for (int axis = 0; axis < 3; axis++) {
+        const glm::vec4 row                                     = glm::row(modelViewProjection, axis);
+        view.frustumPlanes[static_cast<size_t>(2 * axis)]       = rowW + row;
+        view.frustumPlanes[static_cast<size_t>(2 * axis + 1)]   = rowW - row;
+    }
+    for (glm::vec4& plane : view.frustumPlanes) { plane /= glm::length(glm::vec3(plane)); }
+    view.cameraPosition = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+    return view;
+}
+
+bool isMeshletVisible(const Meshlet& meshlet, const CullingView& view, FaceCulling faceCulling) {
+    for (const glm::vec4& plane : view.frustumPlanes) {
+        if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius) { return false; }
+    }
+
+    // Every triangle faces away from every point of the bounding sphere if the view direction lies within the cone,
+    // widened by the sphere's angular size (see meshoptimizer's meshopt_computeMeshletBounds())
+    if (faceCulling == FaceCulling::None) { return true; }
+    const glm::vec3 toCenter    = meshlet.center - view.cameraPosition;
+    const float facing          = glm::dot(toCenter, faceCulling == FaceCulling::BackFacing ? meshlet.coneAxis : -meshlet.coneAxis);
+    return facing < meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef _MESHLETS_H_
+#define _MESHLETS_H_
+
+#include <framework/mesh.h>
+#include <render/mesh_lod.h>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+constexpr uint32_t MESHLET_MAX_VERTICES     = 64U;
+constexpr uint32_t MESHLET_MAX_TRIANGLES    = 124U;
+
+// Contiguous range of triangles with the bounds needed to cull it as a whole
+struct Meshlet {
+    uint32_t firstTriangle;
+    uint32_t numTriangles;
+    glm::vec3 center;       // Bounding sphere
+    float radius;
+    glm::vec3 coneAxis;     // Average direction of the triangles' normals
+    float coneCutoff;       // Sine of the largest angle between a normal and the axis; 1 if the cluster can face any direction
+};
+
+/**
+ * Split the triangles of every level of detail into meshlets, in drawing order. A meshlet ends as soon as its next
+ * triangle would take it past MESHLET_MAX_VERTICES unique vertices or MESHLET_MAX_TRIANGLES triangles, so that
+ * vertex cache optimised triangles keep both their order and compact clusters
+ *
+ * @param vertices Vertices of all levels
+ * @param triangles Triangles of all levels
+ * @param lods Triangle ranges of the levels; meshlets never cross them. If empty, all triangles form a single level
+*/
+std::vector<Meshlet> buildMeshlets(std::span<const Vertex> vertices, std::span<const glm::uvec3> triangles, std::span<const MeshLod> lods);
+
+// Clusters whose triangles all face one way can be skipped by passes that only ever see the other side
+enum class FaceCulling {
+    None = 0,
+    BackFacing,     // Skip clusters facing away from the camera
+    FrontFacing     // Skip clusters facing the camera
+};
+
+// Camera frustum and position in model space
+struct CullingView {
+    std::array<glm::vec4, 6> frustumPlanes;
+    glm::vec3 cameraPosition;
+
+    // Unbounded frustum, which keeps every meshlet
+    static CullingView everything();
+};
+
+CullingView makeCullingView(const glm::mat4& model, const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition);
+
+// Conservative: a culled meshlet has no visible triangles, but a visible one may still have none
+bool isMeshletVisible(const Meshlet& meshlet, const CullingView& view, FaceCulling faceCulling);
+
+
+#endif // _MESHLETS_H_
@@ -2,97 +2,225 @@
 
 DISABLE_WARNINGS_PUSH()
 #include <glm/gtc/matrix_inverse.hpp>
-#include <glm/gtc/type_ptr.hpp>
 DISABLE_WARNINGS_POP()
 
+#include <framework/gl_state.h>
 #include <framework/trackball.h>
 
 #include <utils/constants.h>
 #include <utils/render_utils.hpp>
 #include <utils/magic_enum.hpp>
 
+#include <algorithm>
 #include <array>
 
 
-RefractionRender::RefractionRender(Config& config, glm::ivec2 windowDims)
+// Packed normals are snorms, which never use the most negative integer; uncovered pixels are cleared to it so that
+// they decode to a zero normal and distance, as in the standard layout. Keep in sync with COMPACT_*CLEAR_NORMAL in gbuffer.glsl
+static constexpr std::array<GLuint, 4> COMPACT_CLEAR        = { 0x80008000U, 0U, 0U, 0U };
+static constexpr std::array<GLuint, 4> COMPACT_LOW_CLEAR    = { 0x00008080U, 0U, 0U, 0U };
+
+// Mirrors the std140 layout of the Frame uniform block, which every pass reads and which is written once per frame.
+// Transforms and materials of the instances are in the Instances storage block instead
+struct FrameUniforms {
+    glm::mat4 viewProjection, inverseViewProjection, previousViewProjection;
+    glm::vec3 cameraPosition;
+    float nearPlaneDist;
+    float farPlaneDist;
+    GLint gbufferLayout;
+    GLint dispersion;
+    float dispersionSpread;
+};
+static_assert(sizeof(FrameUniforms) == 224ULL, "FrameUniforms must match the std140 layout of the Frame block");
+static_assert(sizeof(GPUInstance) == 144ULL, "GPUInstance must match the std430 layout of the Instances block");
+static constexpr GLuint FRAME_UNIFORMS_BINDING  = 1U; // Binding 0 is taken by the material of GPUMesh
+static constexpr GLuint INSTANCES_BINDING       = 0U; // Storage block bindings are separate from uniform block ones
+
+// Instance IDs are 16 bits wide
+static constexpr size_t MAX_INSTANCES = 1ULL << 16ULL;
+
+// Texture units of the combined pass. Sampler uniforms keep them for the program's lifetime, so they are only assigned in initShaders()
+static constexpr GLuint UNIT_FRONT_DEPTH        = 0U;
+static constexpr GLuint UNIT_BACK_DEPTH         = 1U;
+static constexpr GLuint UNIT_FRONT_NORMALS      = 2U;
+static constexpr GLuint UNIT_BACK_NORMALS       = 3U;
+static constexpr GLuint UNIT_INNER_DISTANCE     = 4U;
+static constexpr GLuint UNIT_ENVIRONMENT_MAP    = 5U;
+static constexpr GLuint UNIT_FRONT_COMPACT      = 6U; // Samplers of different types may not share a unit
+static constexpr GLuint UNIT_BACK_COMPACT       = 7U;
+static constexpr GLuint UNIT_LOW_RES_COLOR      = 8U;
+static constexpr GLuint UNIT_LOW_RES_GUIDE      = 9U;
+static constexpr GLuint UNIT_HISTORY_COLOR      = 10U;
+static constexpr GLuint UNIT_HISTORY_GUIDE      = 11U;
+static constexpr GLuint UNIT_FRONT_INSTANCE     = 12U;
+
+// Passes of refract-resolve.frag
+static constexpr GLint RESOLVE_FULL_RATE    = 0;
+static constexpr GLint RESOLVE_LOW_RES      = 1;
+static constexpr GLint RESOLVE_UPSAMPLE     = 2;
+
+
+RefractionRender::RefractionRender(Config& config, glm::ivec2 renderDims)
     : m_config(config)
-    , m_windowDims(windowDims) {
+    , m_renderDims(renderDims) {
     initShaders();
     initTexturesAndFramebuffers();
+    glCreateBuffers(NUM_SHADING_COUNTERS, m_shadingCounters.data());
+    for (GLuint counters : m_shadingCounters) { glNamedBufferStorage(counters, sizeof(RefractionShading), nullptr, GL_DYNAMIC_STORAGE_BIT); }
+    glCreateBuffers(1, &m_frameUniforms);
+    glNamedBufferStorage(m_frameUniforms, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &m_instanceBuffer);
 }
 
 RefractionRender::~RefractionRender() {
-    std::array<GLuint, 2> framebuffers  = { m_framebufferFront, m_framebufferBack };
+    freeTexturesAndFramebuffers();
+    glDeleteBuffers(NUM_SHADING_COUNTERS, m_shadingCounters.data());
+    glDeleteBuffers(1, &m_frameUniforms);
+    glDeleteBuffers(1, &m_instanceBuffer);
+}
+
+void RefractionRender::resize(glm::ivec2 renderDims) {
+    if (renderDims == m_renderDims) { return; }
+    freeTexturesAndFramebuffers();
+    m_renderDims = renderDims;
+    initTexturesAndFramebuffers();
+}
+
+void RefractionRender::freeTexturesAndFramebuffers() {
+    std::array<GLuint, 4> framebuffers  = { m_framebufferFront, m_framebufferBack, m_framebufferLayered, m_framebufferLowRes };
     glDeleteFramebuffers(framebuffers.size(), framebuffers.data());
-    std::array<GLuint, 6> textures      = { m_normalsTexFront, m_normalsTexBack,
-                                            m_depthTexFront, m_depthTexBack,
-                                            m_innerDistTexFront, m_innerDistTexBack };
+    std::array<GLuint, 24> textures     = { m_normalsTexFront, m_normalsTexBack, m_normalsTexArray,
+                                            m_depthTexFront, m_depthTexBack, m_depthTexArray,
+                                            m_innerDistTexFront, m_innerDistTexBack, m_innerDistTexArray,
+                                            m_compactTexFront, m_compactTexBack, m_compactTexArray,
+                                            m_compactLowTexFront, m_compactLowTexBack, m_compactLowTexArray,
+                                            m_instanceTexFront, m_instanceTexBack, m_instanceTexArray,
+                                            m_lowResColorTex, m_lowResGuideTex,
+                                            m_historyColorTex[0], m_historyColorTex[1], m_historyGuideTex[0], m_historyGuideTex[1] };
     glDeleteTextures(textures.size(), textures.data());
+    m_framebufferLowRes = m_lowResColorTex = m_lowResGuideTex = 0U;
+    m_lowResDims        = glm::ivec2(0);
+    gl_state::invalidate(); // Deleted names may be handed out again
 }
 
 void RefractionRender::initShaders() {
     m_renderGeometry    = ShaderBuilder().addStage(GL_VERTEX_SHADER, utils::SHADERS_PATH / "write-geometric.vert")
                                          .addStage(GL_FRAGMENT_SHADER, utils::SHADERS_PATH / "write-geometric.frag").build();
+    m_renderGeometryLayered = ShaderBuilder().addStage(GL_VERTEX_SHADER, utils::SHADERS_PATH / "write-geometric.vert")
+                                             .addStage(GL_GEOMETRY_SHADER, utils::SHADERS_PATH / "write-geometric-layered.geom")
+                                             .addStage(GL_FRAGMENT_SHADER, utils::SHADERS_PATH / "write-geometric.frag").build();
     m_screenQuad        = ShaderBuilder().addStage(GL_VERTEX_SHADER, utils::SHADERS_PATH / "screen-quad.vert")
                                          .addStage(GL_FRAGMENT_SHADER, utils::SHADERS_PATH / "screen-quad.frag").build();
+    m_compactView       = ShaderBuilder().addStage(GL_VERTEX_SHADER, utils::SHADERS_PATH / "screen-quad.vert")
+                                         .addStage(GL_FRAGMENT_SHADER, utils::SHADERS_PATH / "compact-gbuffer-view.frag").build();
     m_renderCombined    = ShaderBuilder().addStage(GL_VERTEX_SHADER, utils::SHADERS_PATH / "refract-render.vert")
                                          .addStage(GL_FRAGMENT_SHADER, utils::SHADERS_PATH / "refract-render.frag").build();
+    m_resolveCombined   = ShaderBuilder().addStage(GL_VERTEX_SHADER, utils::SHADERS_PATH / "screen-quad.vert")
+                                         .addStage(GL_FRAGMENT_SHADER, utils::SHADERS_PATH / "refract-resolve.frag").build();
+
+    // Uniform block bindings and sampler units are program state, so they are set once here rather than every frame
+    for (const Shader* shader : { &m_renderGeometry, &m_renderGeometryLayered, &m_renderCombined, &m_resolveCombined }) { shader->bindUniformBlock("Frame", FRAME_UNIFORMS_BINDING); }
+    for (const Shader* shader : { &m_renderCombined, &m_resolveCombined }) {
+        shader->bind();
+        glUniform1i(2, UNIT_FRONT_DEPTH);
+        glUniform1i(3, UNIT_BACK_DEPTH);
+        glUniform1i(4, UNIT_FRONT_NORMALS);
+        glUniform1i(5, UNIT_BACK_NORMALS);
+        glUniform1i(6, UNIT_INNER_DISTANCE);
+        glUniform1i(7, UNIT_ENVIRONMENT_MAP);
+        glUniform1i(15, UNIT_FRONT_COMPACT);
+        glUniform1i(16, UNIT_BACK_COMPACT);
+    }
+    glUniform1i(19, UNIT_LOW_RES_COLOR); // The resolve pass is still bound, and the only one reading these
+    glUniform1i(20, UNIT_LOW_RES_GUIDE);
+    glUniform1i(22, UNIT_HISTORY_COLOR);
+    glUniform1i(23, UNIT_HISTORY_GUIDE);
+    glUniform1i(27, UNIT_FRONT_INSTANCE);
+    for (const Shader* shader : { &m_screenQuad, &m_compactView }) {
+        shader->bind();
+        glUniform1i(0, 0);
+    }
 }
 
 void RefractionRender::initTexturesAndFramebuffers() {
     // Define specifications to be reused
     std::array<GLint, 4> swizzleAllAccessRed = {GL_RED, GL_RED, GL_RED, GL_RED};        // RGBA accesses will all access the R channel
-    std::array<GLuint, 2> attachments { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };   // Framebuffer will render to two color attachments
-
-    // Depth textures
-    std::array<GLuint*, 2> depthTexPtrs = { &m_depthTexFront, &m_depthTexBack };
-    for (GLuint* texPtr : depthTexPtrs) {
-        glCreateTextures(GL_TEXTURE_2D, 1, texPtr);
-        glTextureStorage2D(*texPtr, 1, GL_DEPTH_COMPONENT32F, m_windowDims.x, m_windowDims.y);
-        glTextureParameteri(*texPtr, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTextureParameteri(*texPtr, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTextureParameteriv(*texPtr, GL_TEXTURE_SWIZZLE_RGBA, swizzleAllAccessRed.data());
-    }
-
-    // Normal textures
-    std::array<GLuint*, 2> normalTexPtrs = { &m_normalsTexFront, &m_normalsTexBack };
-    for (GLuint* texPtr : normalTexPtrs) {
-        glCreateTextures(GL_TEXTURE_2D, 1, texPtr);
-        glTextureStorage2D(*texPtr, 1, GL_RGB16F, m_windowDims.x, m_windowDims.y);
-        glTextureParameteri(*texPtr, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTextureParameteri(*texPtr, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    }
-
-    // Inner distance textures
-    std::array<GLuint*, 2> innerDistTexPtrs = { &m_innerDistTexFront, &m_innerDistTexBack };
-    for (GLuint* texPtr : innerDistTexPtrs) {
-        glCreateTextures(GL_TEXTURE_2D, 1, texPtr);
-        glTextureStorage2D(*texPtr, 1, GL_R32F, m_windowDims.x, m_windowDims.y);
-        glTextureParameteri(*texPtr, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTextureParameteri(*texPtr, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTextureParameteriv(*texPtr, GL_TEXTURE_SWIZZLE_RGBA, swizzleAllAccessRed.data());
-    }
-
-    // Front face framebuffer. Create and attach textures as render targets
+
+    // Every render target is a two-layer array holding the front faces in layer 0 and the back faces in layer 1, so that
+    // both can be rendered in a single layered pass. Each layer is also viewed as a regular texture for the two-pass path and for sampling
+    struct RenderTarget { GLuint* array; GLuint* front; GLuint* back; GLenum format; bool singleChannel; };
+    std::array<RenderTarget, 6> renderTargets = {{ { &m_depthTexArray, &m_depthTexFront, &m_depthTexBack, GL_DEPTH_COMPONENT32F, true },
+                                                   { &m_normalsTexArray, &m_normalsTexFront, &m_normalsTexBack, GL_RGB16F, false },
+                                                   { &m_innerDistTexArray, &m_innerDistTexFront, &m_innerDistTexBack, GL_R32F, true },
+                                                   { &m_compactTexArray, &m_compactTexFront, &m_compactTexBack, GL_RG32UI, false },
+                                                   { &m_compactLowTexArray, &m_compactLowTexFront, &m_compactLowTexBack, GL_R32UI, false },
+                                                   { &m_instanceTexArray, &m_instanceTexFront, &m_instanceTexBack, GL_R16UI, false } }};
+    for (const RenderTarget& target : renderTargets) {
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, target.array);
+        glTextureStorage3D(*target.array, 1, target.format, m_renderDims.x, m_renderDims.y, 2);
+
+        // Views must be made from names that have never been bound, hence glGenTextures()
+        std::array<GLuint*, 2> layerTexPtrs = { target.front, target.back };
+        glGenTextures(1, target.front);
+        glGenTextures(1, target.back);
+        for (GLuint layer = 0U; layer < 2U; layer++) {
+            GLuint* texPtr = layerTexPtrs[layer];
+            glTextureView(*texPtr, GL_TEXTURE_2D, *target.array, target.format, 0, 1, layer, 1);
+            glTextureParameteri(*texPtr, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTextureParameteri(*texPtr, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            if (target.singleChannel) { glTextureParameteriv(*texPtr, GL_TEXTURE_SWIZZLE_RGBA, swizzleAllAccessRed.data()); }
+        }
+    }
+
+    // Front face framebuffer. Create and attach textures as render targets; the G-buffer layout picks the draw buffers of every frame
     glCreateFramebuffers(1, &m_framebufferFront);
     glNamedFramebufferTexture(m_framebufferFront, GL_DEPTH_ATTACHMENT, m_depthTexFront, 0);
     glNamedFramebufferTexture(m_framebufferFront, GL_COLOR_ATTACHMENT0, m_normalsTexFront, 0);
     glNamedFramebufferTexture(m_framebufferFront, GL_COLOR_ATTACHMENT1, m_innerDistTexFront, 0);
-    glNamedFramebufferDrawBuffers(m_framebufferFront, attachments.size(), attachments.data());
+    glNamedFramebufferTexture(m_framebufferFront, GL_COLOR_ATTACHMENT2, m_compactTexFront, 0);
+    glNamedFramebufferTexture(m_framebufferFront, GL_COLOR_ATTACHMENT3, m_compactLowTexFront, 0);
+    glNamedFramebufferTexture(m_framebufferFront, GL_COLOR_ATTACHMENT4, m_instanceTexFront, 0);
 
     // Back face framebuffer. Create and attach textures as render targets
     glCreateFramebuffers(1, &m_framebufferBack);
     glNamedFramebufferTexture(m_framebufferBack, GL_DEPTH_ATTACHMENT, m_depthTexBack, 0);
     glNamedFramebufferTexture(m_framebufferBack, GL_COLOR_ATTACHMENT0, m_normalsTexBack, 0);
     glNamedFramebufferTexture(m_framebufferBack, GL_COLOR_ATTACHMENT1, m_innerDistTexBack, 0);
-    glNamedFramebufferDrawBuffers(m_framebufferBack, attachments.size(), attachments.data());
+    glNamedFramebufferTexture(m_framebufferBack, GL_COLOR_ATTACHMENT2, m_compactTexBack, 0);
+    glNamedFramebufferTexture(m_framebufferBack, GL_COLOR_ATTACHMENT3, m_compactLowTexBack, 0);
+    glNamedFramebufferTexture(m_framebufferBack, GL_COLOR_ATTACHMENT4, m_instanceTexBack, 0);
+
+    // Layered framebuffer. Attaching whole arrays lets the geometry shader pick the layer of every primitive
+    glCreateFramebuffers(1, &m_framebufferLayered);
+    glNamedFramebufferTexture(m_framebufferLayered, GL_DEPTH_ATTACHMENT, m_depthTexArray, 0);
+    glNamedFramebufferTexture(m_framebufferLayered, GL_COLOR_ATTACHMENT0, m_normalsTexArray, 0);
+    glNamedFramebufferTexture(m_framebufferLayered, GL_COLOR_ATTACHMENT1, m_innerDistTexArray, 0);
+    glNamedFramebufferTexture(m_framebufferLayered, GL_COLOR_ATTACHMENT2, m_compactTexArray, 0);
+    glNamedFramebufferTexture(m_framebufferLayered, GL_COLOR_ATTACHMENT3, m_compactLowTexArray, 0);
+    glNamedFramebufferTexture(m_framebufferLayered, GL_COLOR_ATTACHMENT4, m_instanceTexArray, 0);
+
+    // History of the combined result, written as images and read with texelFetch()
+    glCreateTextures(GL_TEXTURE_2D, 2, m_historyColorTex.data());
+    glCreateTextures(GL_TEXTURE_2D, 2, m_historyGuideTex.data());
+    for (size_t historyIdx = 0ULL; historyIdx < 2ULL; historyIdx++) {
+        glTextureStorage2D(m_historyColorTex[historyIdx], 1, GL_RGBA16F, m_renderDims.x, m_renderDims.y);
+        glTextureStorage2D(m_historyGuideTex[historyIdx], 1, GL_RGBA32F, m_renderDims.x, m_renderDims.y);
+    }
+    invalidateHistory();
 }
 
-void RefractionRender::draw(const GPUMesh& mesh,
-                            const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
-                            const glm::vec3& cameraPosition, const GLuint environmentMapTex) {
+void RefractionRender::draw(const GPUMesh& mesh, std::span<const MeshInstance> instances,
+                            const glm::mat4& view, const glm::mat4& projection,
+                            const glm::vec3& cameraPosition, const GLuint environmentMapTex, GLuint outputFramebuffer) {
     // Render geometry info so we can draw whatever we want
-    renderGeometry(mesh, model, view, projection);
+    gl_state::takeCallCounts();
+    m_gpuTimer.begin();
+    m_outputFramebuffer             = outputFramebuffer;
+    const glm::mat4 viewProjection  = projection * view;
+    prepareInstances(mesh, instances, viewProjection, projection, cameraPosition);
+    m_stats.gbufferBytes            = estimateGBufferBytes();
+    writeFrameUniforms(viewProjection, cameraPosition);
+    renderGeometry(mesh);
 
     // Use rendered data to display the actual requested thing
     switch (m_config.currentRender) {
@@ -100,113 +228,411 @@ void RefractionRender::draw(const GPUMesh& mesh,
             drawQuad(m_depthTexFront);
         } break;
         case RenderOption::DepthBackFace: {
-            drawQuad(m_depthTexBack);
+            drawQuad(m_depthTexBack, true);
         } break;
         case RenderOption::NormalsFrontFace: {
-            drawQuad(m_normalsTexFront);
+            drawGBufferQuad(false, false);
         } break;
         case RenderOption::NormalsBackFace: {
-            drawQuad(m_normalsTexBack);
+            drawGBufferQuad(true, false);
         } break;
         case RenderOption::InnerObjectDistancesFrontFace: {
-            drawQuad(m_innerDistTexFront);
+            drawGBufferQuad(false, true);
         } break;
         case RenderOption::InnerObjectDistancesBackFace: {
-            drawQuad(m_innerDistTexBack);
+            drawGBufferQuad(true, true);
         } break;
         case RenderOption::Combined: {
-            renderCombined(mesh, model, view, projection, cameraPosition, environmentMapTex);
+            renderCombined(mesh, viewProjection, environmentMapTex);
         } break;
     }
+    m_gpuTimer.end();
+    m_stats.renderDims          = m_renderDims;
+    m_stats.newGpuMilliseconds  = m_gpuTimer.takeNewMilliseconds();
+    m_stats.gpuMilliseconds     = m_gpuTimer.lastMilliseconds();
+    m_stats.stateCalls          = gl_state::takeCallCounts();
+}
+
+void RefractionRender::writeFrameUniforms(const glm::mat4& viewProjection, const glm::vec3& cameraPosition) {
+    // Matrices and camera parameters are uploaded once, instead of as loose uniforms of every pass
+    const FrameUniforms uniforms    = { .viewProjection         = viewProjection,
+                                        .inverseViewProjection  = glm::inverse(viewProjection),
+                                        .previousViewProjection = m_historyViewProjection,
+                                        .cameraPosition         = cameraPosition,
+                                        .nearPlaneDist          = Trackball::NEAR_PLANE,
+                                        .farPlaneDist           = Trackball::FAR_PLANE,
+                                        .gbufferLayout          = static_cast<GLint>(m_config.gbufferLayout),
+                                        .dispersion             = static_cast<GLint>(m_config.dispersion),
+                                        .dispersionSpread       = m_config.dispersionSpread };
+    glNamedBufferSubData(m_frameUniforms, 0, sizeof(uniforms), &uniforms);
+    gl_state::bindUniformBuffer(FRAME_UNIFORMS_BINDING, m_frameUniforms);
+}
+
+void RefractionRender::prepareInstances(const GPUMesh& mesh, std::span<const MeshInstance> instances, const glm::mat4& viewProjection,
+                                        const glm::mat4& projection, const glm::vec3& cameraPosition) {
+    // Transforms and materials are read by every pass, with the instance found from gl_BaseInstance or the G-buffer
+    instances = instances.first(std::min(instances.size(), MAX_INSTANCES));
+    m_instances.assign(instances.begin(), instances.end());
+    m_gpuInstances.clear();
+    m_instanceLods.clear();
+    m_cullingViews.clear();
+    m_stats.lod = mesh.lods().size() - 1ULL;
+    for (const MeshInstance& instance : m_instances) {
+        m_gpuInstances.push_back(toGPUInstance(instance));
+        m_instanceLods.push_back(selectMeshLod(mesh, instance.model, projection, cameraPosition));
+        m_cullingViews.push_back(makeCullingView(instance.model, viewProjection * instance.model, cameraPosition));
+        m_stats.lod = std::min(m_stats.lod, m_instanceLods.back());
+    }
+    glNamedBufferData(m_instanceBuffer, static_cast<GLsizeiptr>(m_gpuInstances.size() * sizeof(GPUInstance)), m_gpuInstances.data(), GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCES_BINDING, m_instanceBuffer);
 }
 
-void RefractionRender::renderGeometry(const GPUMesh& mesh, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection) {
+size_t RefractionRender::selectMeshLod(const GPUMesh& mesh, const glm::mat4& model, const glm::mat4& projection, const glm::vec3& cameraPosition) const {
+    if (m_config.forcedLod >= 0) { return std::min(static_cast<size_t>(m_config.forcedLod), mesh.lods().size() - 1); }
+
+    // Loaded models are scaled to fit the unit sphere around their origin. Its nearest point to the camera
+    // is where one model unit covers the most pixels
+    const glm::vec3 center      = glm::vec3(model[3]);
+    const float scale           = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+    const float distance        = std::max(glm::length(cameraPosition - center) - scale, Trackball::NEAR_PLANE);
+    const float pixelsPerUnit   = scale * projection[1][1] * 0.5f * static_cast<float>(m_renderDims.y) / distance;
+    return selectLod(mesh.lods(), pixelsPerUnit, m_config.lodPixelError);
+}
+
+void RefractionRender::renderGeometry(const GPUMesh& mesh) {
     // Get original depth function
     GLint originalDepthFunction;
     glGetIntegerv(GL_DEPTH_FUNC, &originalDepthFunction);
 
-    // Set viewport and compute needed matrices
-    glViewport(0, 0, m_windowDims.x, m_windowDims.y);
-    const glm::mat3 normalModel = glm::inverseTranspose(glm::mat3(model));
-    const glm::mat4 mvp         = projection * view * model;
+    // Set viewport
+    glViewport(0, 0, m_renderDims.x, m_renderDims.y);
 
-    // Render front faces
+    // Back faces are rendered with reversed depth, so that both layers keep the nearest value they see
     glClearDepth(1.0f);
     glDepthFunc(GL_LESS);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferFront);
-    renderGeometrySingle(mesh, model, normalModel, mvp);
 
-    // Render back faces
-    glClearDepth(0.0f);
-    glDepthFunc(GL_GREATER);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferBack);
-    renderGeometrySingle(mesh, model, normalModel, mvp);
+    // Render both layers at once. Meshlets only need to be in the frustum, as each one is drawn to both
+    // Back face d_N is only ever shown, never used for refraction
+    const bool backDistanceInner = m_config.currentRender == RenderOption::InnerObjectDistancesBackFace;
+    if (m_config.layeredGeometry) {
+        selectDrawBuffers(m_framebufferLayered, true);
+        gl_state::bindFramebuffer(m_framebufferLayered);
+        renderGeometrySingle(mesh, m_renderGeometryLayered, false, FaceCulling::None, m_stats.front);
+        m_stats.back = {};
+    }
+
+    // Render front faces, then back faces. The nearest surface of a closed mesh always faces the camera, the farthest one faces away from it
+    else {
+        selectDrawBuffers(m_framebufferFront, true);
+        selectDrawBuffers(m_framebufferBack, backDistanceInner);
+        gl_state::bindFramebuffer(m_framebufferFront);
+        renderGeometrySingle(mesh, m_renderGeometry, false, FaceCulling::BackFacing, m_stats.front);
+        gl_state::bindFramebuffer(m_framebufferBack);
+        renderGeometrySingle(mesh, m_renderGeometry, true, FaceCulling::FrontFacing, m_stats.back);
+    }
 
     // Restore original OpenGL state
-    glClearDepth(1.0f);
     glDepthFunc(originalDepthFunction);
 }
 
-void RefractionRender::renderGeometrySingle(const GPUMesh& mesh,
-                                            const glm::mat4& model, const glm::mat3& normalModel, const glm::mat4& mvp) {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    m_renderGeometry.bind();
-    glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(mvp));
-    glUniformMatrix4fv(1, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix3fv(2, 1, GL_FALSE, glm::value_ptr(normalModel));
-    mesh.draw(m_renderGeometry);
+void RefractionRender::selectDrawBuffers(GLuint framebuffer, bool distanceInner) const {
+    // Outputs of write-geometric.frag without a draw buffer are never written. Instance IDs are needed by every layout
+    std::array<GLenum, 5> drawBuffers = { GL_NONE, GL_NONE, GL_NONE, GL_NONE, GL_COLOR_ATTACHMENT4 };
+    switch (m_config.gbufferLayout) {
+        case GBufferLayout::Standard: {
+            drawBuffers[0] = GL_COLOR_ATTACHMENT0;
+            if (distanceInner) { drawBuffers[1] = GL_COLOR_ATTACHMENT1; }
+        } break;
+        case GBufferLayout::Compact: {
+            drawBuffers[2] = GL_COLOR_ATTACHMENT2;
+        } break;
+        case GBufferLayout::CompactLowPrecision: {
+            drawBuffers[3] = GL_COLOR_ATTACHMENT3;
+        } break;
+    }
+    glNamedFramebufferDrawBuffers(framebuffer, drawBuffers.size(), drawBuffers.data());
+}
+
+void RefractionRender::clearGBuffer() const {
+    // Integer targets cannot be cleared by glClear(). Uncovered pixels are told apart by their depth, so any instance ID will do for them
+    constexpr std::array<GLuint, 4> noInstance = { 0U, 0U, 0U, 0U };
+    glClearBufferuiv(GL_COLOR, 4, noInstance.data());
+    switch (m_config.gbufferLayout) {
+        case GBufferLayout::Standard: {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        } break;
+        case GBufferLayout::Compact: {
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glClearBufferuiv(GL_COLOR, 2, COMPACT_CLEAR.data());
+        } break;
+        case GBufferLayout::CompactLowPrecision: {
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glClearBufferuiv(GL_COLOR, 3, COMPACT_LOW_CLEAR.data());
+        } break;
+    }
+}
+
+uint64_t RefractionRender::estimateGBufferBytes() const {
+    // Every target is counted as written once per layer and read once per sampled texel, across the whole window.
+    // Overdraw, clears, texture caches and framebuffer compression are not accounted for
+    constexpr uint64_t DEPTH_BYTES      = 4ULL;
+    constexpr uint64_t NORMAL_BYTES     = 8ULL;     // RGB16F is padded to four channels by most drivers
+    constexpr uint64_t DISTANCE_BYTES   = 4ULL;
+    constexpr uint64_t INSTANCE_BYTES   = 2ULL;
+    const bool standard                 = m_config.gbufferLayout == GBufferLayout::Standard;
+    const uint64_t compactBytes         = m_config.gbufferLayout == GBufferLayout::Compact ? 8ULL : 4ULL;
+    const auto layerBytes               = [&](bool distanceInner) { return standard ? NORMAL_BYTES + (distanceInner ? DISTANCE_BYTES : 0ULL) : compactBytes; };
+    const bool backDistanceInner        = m_config.layeredGeometry || m_config.currentRender == RenderOption::InnerObjectDistancesBackFace;
+
+    const uint64_t written  = 2ULL * (DEPTH_BYTES + INSTANCE_BYTES) + layerBytes(true) + layerBytes(backDistanceInner);
+    uint64_t read           = 0ULL;
+    switch (m_config.currentRender) {
+        case RenderOption::DepthFrontFace:
+        case RenderOption::DepthBackFace: {
+            read = DEPTH_BYTES;
+        } break;
+        case RenderOption::NormalsFrontFace:
+        case RenderOption::NormalsBackFace: {
+            read = layerBytes(false);
+        } break;
+        case RenderOption::InnerObjectDistancesFrontFace:
+        case RenderOption::InnerObjectDistancesBackFace: {
+            read = standard ? DISTANCE_BYTES : compactBytes;
+        } break;
+        case RenderOption::Combined: {
+            read = 2ULL * DEPTH_BYTES + layerBytes(true) + layerBytes(false) + (m_config.deferredCombined ? INSTANCE_BYTES : 0ULL);
+        } break;
+    }
+    return static_cast<uint64_t>(m_renderDims.x) * static_cast<uint64_t>(m_renderDims.y) * (written + read);
+}
+
+void RefractionRender::renderGeometrySingle(const GPUMesh& mesh, const Shader& shader, bool reverseDepth, FaceCulling faceCulling, MeshletDrawList& drawList) {
+    clearGBuffer();
+    shader.bind();
+    glUniform1i(3, reverseDepth);
+    drawMesh(mesh, shader, faceCulling, drawList);
 }
 
-void RefractionRender::renderCombined(const GPUMesh& mesh,
-                                      const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
-                                      const glm::vec3& cameraPosition, const GLuint environmentMapTex) {
-    // Set screen buffer, clear it, set viewport, and bind combined render shader program
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, m_windowDims.x, m_windowDims.y);
+void RefractionRender::drawMesh(const GPUMesh& mesh, const Shader& shader, FaceCulling faceCulling, MeshletDrawList& drawList) {
+    // The ranges of all instances go into one list, each at its own level of detail and culled in its own model space.
+    // Without culling every meshlet is still listed, so that the statistics stay meaningful.
+    // Normal cones trust the winding of the model, which is often inconsistent, so they only cull when asked to
+    drawList.clear();
+    if (!m_config.coneCulling) { faceCulling = FaceCulling::None; }
+    for (uint32_t instanceIdx = 0U; instanceIdx < m_instances.size(); instanceIdx++) {
+        if (m_config.meshletCulling)    { mesh.cullMeshlets(m_instanceLods[instanceIdx], m_cullingViews[instanceIdx], faceCulling, instanceIdx, drawList); }
+        else                            { mesh.cullMeshlets(m_instanceLods[instanceIdx], CullingView::everything(), FaceCulling::None, instanceIdx, drawList); }
+    }
+    mesh.draw(shader, drawList);
+}
+
+void RefractionRender::renderCombined(const GPUMesh& mesh, const glm::mat4& viewProjection, const GLuint environmentMapTex) {
+    // Set output buffer and viewport
+    gl_state::bindFramebuffer(m_outputFramebuffer);
+    glViewport(0, 0, m_renderDims.x, m_renderDims.y);
+
+    // Deferred: everything the rasterised pass would interpolate can be rebuilt from the front face depth,
+    // so the refraction is resolved per covered pixel instead of drawing the mesh a third time
+    if (m_config.deferredCombined) {
+        const glm::ivec4 rect = instancesScreenRect(viewProjection);
+        m_resolveCombined.bind();
+        bindCombinedTextures(environmentMapTex);
+        gl_state::bindTextureUnit(UNIT_FRONT_INSTANCE, m_instanceTexFront);
+        bindShadingCounters();
+        bindHistory(viewProjection);
+
+        // Reduced rate: refract once per block of pixels, then upsample guided by the depth and normal of every pixel
+        if (m_config.refractionDownsample > 1) {
+            resolveLowRes(rect);
+            glUniform1i(17, RESOLVE_UPSAMPLE);
+        } else {
+            glUniform1i(17, RESOLVE_FULL_RATE);
+        }
+
+        gl_state::bindFramebuffer(m_outputFramebuffer);
+        glViewport(0, 0, m_renderDims.x, m_renderDims.y);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(rect.x, rect.y, rect.z, rect.w);
+        utils::renderQuad();
+        glDisable(GL_SCISSOR_TEST);
+        advanceHistory(viewProjection);
+        m_stats.combined = {};
+        return;
+    }
+    invalidateHistory();
+
+    // Draw the mesh. Like the front face pass, this only ever shows the surface nearest to the camera
     m_renderCombined.bind();
-    
-    // Uniforms: Transformation matrices
-    const glm::mat4 mvp = projection * view * model;
-    glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(mvp));
-    glUniformMatrix4fv(1, 1, GL_FALSE, glm::value_ptr(model));
-
-    // Uniforms: Textures
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_depthTexFront);
-    glUniform1i(2, 0);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_depthTexBack);
-    glUniform1i(3, 1);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, m_normalsTexFront);
-    glUniform1i(4, 2);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, m_normalsTexBack);
-    glUniform1i(5, 3);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, m_innerDistTexFront);
-    glUniform1i(6, 4);
-    glActiveTexture(GL_TEXTURE5);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, environmentMapTex);
-    glUniform1i(7, 5);
-
-    // Uniforms: Miscellaneous
-    glUniform3fv(8, 1, glm::value_ptr(cameraPosition));
-    glUniform1f(9, m_config.refractiveIndexRatio);
-    glUniform1f(10, Trackball::NEAR_PLANE);
-    glUniform1f(11, Trackball::FAR_PLANE);
-    glUniform3fv(12, 1, glm::value_ptr(m_config.transparency));
-
-    // Draw the mesh
-    mesh.draw(m_renderCombined);
-}
-
-void RefractionRender::drawQuad(GLuint texture) {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, m_windowDims.x, m_windowDims.y);
+    bindCombinedTextures(environmentMapTex);
+    drawMesh(mesh, m_renderCombined, FaceCulling::BackFacing, m_stats.combined);
+}
+
+void RefractionRender::resolveLowRes(const glm::ivec4& screenRect) {
+    allocateLowResTargets();
+
+    // Zero alpha marks blocks without a single covered pixel, which the upsample never blends in
+    constexpr std::array<GLfloat, 4> zero = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearNamedFramebufferfv(m_framebufferLowRes, GL_COLOR, 0, zero.data());
+    glClearNamedFramebufferfv(m_framebufferLowRes, GL_COLOR, 1, zero.data());
+
+    // Every block touching the model's screen rectangle
+    const int factor        = m_config.refractionDownsample;
+    const glm::ivec2 first  = glm::ivec2(screenRect.x, screenRect.y) / factor;
+    const glm::ivec2 last   = (glm::ivec2(screenRect.x + screenRect.z, screenRect.y + screenRect.w) + factor - 1) / factor;
+    gl_state::bindFramebuffer(m_framebufferLowRes);
+    glViewport(0, 0, m_lowResDims.x, m_lowResDims.y);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(first.x, first.y, last.x - first.x, last.y - first.y);
+    glUniform1i(17, RESOLVE_LOW_RES);
+    glUniform1i(18, factor);
+    utils::renderQuad();
+    glDisable(GL_SCISSOR_TEST);
+
+    // Blocks for the upsample, bound only now as they were render targets above
+    gl_state::bindTextureUnit(UNIT_LOW_RES_COLOR, m_lowResColorTex);
+    gl_state::bindTextureUnit(UNIT_LOW_RES_GUIDE, m_lowResGuideTex);
+}
+
+void RefractionRender::allocateLowResTargets() {
+    const int factor                = m_config.refractionDownsample;
+    const glm::ivec2 lowResDims     = (m_renderDims + factor - 1) / factor;
+    if (lowResDims == m_lowResDims) { return; }
+    std::array<GLuint, 2> textures  = { m_lowResColorTex, m_lowResGuideTex };
+    glDeleteTextures(textures.size(), textures.data());
+    glDeleteFramebuffers(1, &m_framebufferLowRes);
+    gl_state::invalidate();
+    m_lowResDims = lowResDims;
+
+    // Color of each block, and the normal (RGB) and depth (A) of the pixel it was computed for
+    struct LowResTarget { GLuint* texture; GLenum format; };
+    std::array<LowResTarget, 2> targets = {{ { &m_lowResColorTex, GL_RGBA16F }, { &m_lowResGuideTex, GL_RGBA32F } }};
+    for (const LowResTarget& target : targets) {
+        glCreateTextures(GL_TEXTURE_2D, 1, target.texture);
+        glTextureStorage2D(*target.texture, 1, target.format, m_lowResDims.x, m_lowResDims.y);
+        glTextureParameteri(*target.texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(*target.texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    glCreateFramebuffers(1, &m_framebufferLowRes);
+    glNamedFramebufferTexture(m_framebufferLowRes, GL_COLOR_ATTACHMENT0, m_lowResColorTex, 0);
+    glNamedFramebufferTexture(m_framebufferLowRes, GL_COLOR_ATTACHMENT1, m_lowResGuideTex, 0);
+    constexpr std::array<GLenum, 2> drawBuffers = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glNamedFramebufferDrawBuffers(m_framebufferLowRes, drawBuffers.size(), drawBuffers.data());
+}
+
+void RefractionRender::bindShadingCounters() {
+    // A set of counters is only read back when its turn comes round again, by which time the GPU is long done with it
+    const GLuint counters = m_shadingCounters[m_nextShadingCounter];
+    if (m_shadingCountersPending[m_nextShadingCounter]) {
+        RefractionShading shading;
+        glGetNamedBufferSubData(counters, 0, sizeof(shading), &shading);
+        m_stats.refractionShading = shading;
+    }
+    constexpr GLuint zero = 0U;
+    glClearNamedBufferData(counters, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, counters);
+    m_shadingCountersPending[m_nextShadingCounter]  = true;
+    m_nextShadingCounter                            = (m_nextShadingCounter + 1ULL) % NUM_SHADING_COUNTERS;
+}
+
+void RefractionRender::invalidateHistory() {
+    m_historyValid  = false;
+    m_staleFrames   = 0;
+}
+
+void RefractionRender::bindHistory(const glm::mat4& viewProjection) {
+    const int interval = m_config.temporalInterval;
+    glUniform1i(24, interval);
+    if (interval <= 1) {
+        invalidateHistory();
+        return;
+    }
+
+    // Once the camera stops, pixels reused from where it was before are refreshed within the interval.
+    // Without history, every pixel is refracted anew in this frame
+    if (!m_historyValid)                                    { m_staleFrames = 0; }
+    else if (viewProjection != m_historyViewProjection)     { m_staleFrames = interval - 1; }
+    else if (m_staleFrames > 0)                             { m_staleFrames--; }
+
+    // Uncovered pixels are never written, so this frame's history starts out showing no model anywhere
+    constexpr std::array<GLfloat, 4> uncovered = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const size_t historyRead = 1ULL - m_historyWrite;
+    glClearTexImage(m_historyGuideTex[m_historyWrite], 0, GL_RGBA, GL_FLOAT, uncovered.data());
+    glBindImageTexture(0, m_historyColorTex[m_historyWrite], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glBindImageTexture(1, m_historyGuideTex[m_historyWrite], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    gl_state::bindTextureUnit(UNIT_HISTORY_COLOR, m_historyColorTex[historyRead]);
+    gl_state::bindTextureUnit(UNIT_HISTORY_GUIDE, m_historyGuideTex[historyRead]);
+    glUniform1i(25, static_cast<GLint>(m_frameIndex % static_cast<uint32_t>(interval)));
+    glUniform1i(26, m_historyValid);
+}
+
+void RefractionRender::advanceHistory(const glm::mat4& viewProjection) {
+    // Counters are read back with glGetNamedBufferSubData(), and the history images by the next frame's texelFetch()
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    if (m_config.temporalInterval <= 1) { return; }
+    m_historyWrite          = 1ULL - m_historyWrite;
+    m_historyValid          = true;
+    m_historyViewProjection = viewProjection;
+    m_frameIndex++;
+}
+
+void RefractionRender::bindCombinedTextures(const GLuint environmentMapTex) {
+    // Compact G-buffer textures of the current layout; the others are never sampled
+    const bool lowPrecision = m_config.gbufferLayout == GBufferLayout::CompactLowPrecision;
+    gl_state::bindTextureUnit(UNIT_FRONT_DEPTH, m_depthTexFront);
+    gl_state::bindTextureUnit(UNIT_BACK_DEPTH, m_depthTexBack);
+    gl_state::bindTextureUnit(UNIT_FRONT_NORMALS, m_normalsTexFront);
+    gl_state::bindTextureUnit(UNIT_BACK_NORMALS, m_normalsTexBack);
+    gl_state::bindTextureUnit(UNIT_INNER_DISTANCE, m_innerDistTexFront);
+    gl_state::bindTextureUnit(UNIT_ENVIRONMENT_MAP, environmentMapTex);
+    gl_state::bindTextureUnit(UNIT_FRONT_COMPACT, lowPrecision ? m_compactLowTexFront : m_compactTexFront);
+    gl_state::bindTextureUnit(UNIT_BACK_COMPACT, lowPrecision ? m_compactLowTexBack : m_compactTexBack);
+}
+
+glm::ivec4 RefractionRender::instancesScreenRect(const glm::mat4& viewProjection) const {
+    // Loaded models fit the unit sphere around their origin (see selectMeshLod()), and hence the cube around it.
+    // A corner behind the camera can project anywhere, in which case the whole target is covered
+    const glm::ivec4 wholeTarget = { 0, 0, m_renderDims.x, m_renderDims.y };
+    glm::vec2 lower(1.0f), upper(-1.0f);
+    for (const MeshInstance& instance : m_instances) {
+        const glm::mat4 mvp = viewProjection * instance.model;
+        for (int corner = 0; corner < 8; corner++) {
+            const glm::vec4 cornerClip = mvp * glm::vec4((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f, 1.0f);
+            if (cornerClip.w <= Trackball::NEAR_PLANE) { return wholeTarget; }
+            lower = glm::min(lower, glm::vec2(cornerClip) / cornerClip.w);
+            upper = glm::max(upper, glm::vec2(cornerClip) / cornerClip.w);
+        }
+    }
+    const glm::vec2 renderDims  = glm::vec2(m_renderDims);
+    const glm::ivec2 first      = glm::clamp(glm::ivec2(glm::floor((glm::clamp(lower, -1.0f, 1.0f) * 0.5f + 0.5f) * renderDims)), glm::ivec2(0), m_renderDims);
+    const glm::ivec2 last       = glm::clamp(glm::ivec2(glm::ceil((glm::clamp(upper, -1.0f, 1.0f) * 0.5f + 0.5f) * renderDims)), glm::ivec2(0), m_renderDims);
+    return { first, glm::max(last - first, glm::ivec2(0)) };
+}
+
+void RefractionRender::drawQuad(GLuint texture, bool invert) {
+    gl_state::bindFramebuffer(m_outputFramebuffer);
+    glViewport(0, 0, m_renderDims.x, m_renderDims.y);
     m_screenQuad.bind();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glUniform1i(0, 0);
+    gl_state::bindTextureUnit(0, texture);
+    glUniform1i(1, invert);
+    utils::renderQuad();
+}
+
+void RefractionRender::drawGBufferQuad(bool backFaces, bool showDistance) {
+    if (m_config.gbufferLayout == GBufferLayout::Standard) {
+        if (showDistance)   { drawQuad(backFaces ? m_innerDistTexBack : m_innerDistTexFront); }
+        else                { drawQuad(backFaces ? m_normalsTexBack : m_normalsTexFront); }
+        return;
+    }
+
+    // Compact textures need decoding first
+    const bool lowPrecision = m_config.gbufferLayout == GBufferLayout::CompactLowPrecision;
+    const GLuint texture    = lowPrecision ? (backFaces ? m_compactLowTexBack : m_compactLowTexFront) : (backFaces ? m_compactTexBack : m_compactTexFront);
+    gl_state::bindFramebuffer(m_outputFramebuffer);
+    glViewport(0, 0, m_renderDims.x, m_renderDims.y);
+    m_compactView.bind();
+    gl_state::bindTextureUnit(0, texture);
+    glUniform1i(1, static_cast<GLint>(m_config.gbufferLayout));
+    glUniform1i(2, showDistance);
     utils::renderQuad();
 }
@@ -7,40 +7,128 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 DISABLE_WARNINGS_POP()
 
+#include <framework/gl_state.h>
+
+#include <render/gpu_timer.h>
+#include <render/instances.h>
 #include <render/mesh.h>
 #include <utils/config.h>
 
+#include <array>
+#include <optional>
+#include <span>
+#include <vector>
+
+
+// Pixel shader work of the deferred combined pass
+struct RefractionShading {
+    GLuint lowResEvaluations;   // Refraction computed once per block of pixels
+    GLuint coveredPixels;       // Each of which the full rate pass refracts
+    GLuint fullRateEvaluations; // Covered pixels refracted at full rate, including those whose blocks disagreed with them
+    GLuint reusedPixels;        // Covered pixels that reprojected the previous frame's result instead
+};
+
+// Culling results, traffic and timing of the passes of the last frame
+struct RenderStats {
+    size_t lod;                                 // Finest level of detail any instance was drawn at
+    MeshletDrawList front, back, combined;
+    uint64_t gbufferBytes;                      // Estimated G-buffer bytes written and read
+    glm::ivec2 renderDims;
+    std::optional<double> gpuMilliseconds;      // GPU time of all passes, from a few frames ago
+    std::optional<double> newGpuMilliseconds;   // Same, if that measurement completed during the last frame
+    std::optional<RefractionShading> refractionShading; // Only when the combined result is resolved per pixel, from a few frames ago
+    gl_state::CallCounts stateCalls;            // Program, texture, framebuffer, vertex array and uniform buffer binds of all passes
+};
 
 class RefractionRender {
 public:
-    RefractionRender(Config& config, glm::ivec2 windowDims);
+    RefractionRender(Config& config, glm::ivec2 renderDims);
     ~RefractionRender();
 
-    void draw(const GPUMesh& mesh,
-              const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
-              const glm::vec3& cameraPosition, const GLuint environmentMapTex);
+    // Reallocate the render targets, e.g. after the window or the resolution scale changed
+    void resize(glm::ivec2 renderDims);
+
+    // Every instance of the mesh is drawn by a single indirect draw per pass
+    void draw(const GPUMesh& mesh, std::span<const MeshInstance> instances,
+              const glm::mat4& view, const glm::mat4& projection,
+              const glm::vec3& cameraPosition, const GLuint environmentMapTex, GLuint outputFramebuffer = 0);
+
+    const RenderStats& stats() const { return m_stats; }
+
+    // Forget the combined results of earlier frames, e.g. once the model or the settings changed
+    void invalidateHistory();
+    // Whether the last frame still reused results resolved for another camera, which the next few frames refresh
+    bool hasStalePixels() const { return m_staleFrames > 0; }
 
 private:
     void initShaders();
     void initTexturesAndFramebuffers();
-    void renderGeometry(const GPUMesh& mesh, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
-    void renderGeometrySingle(const GPUMesh& mesh, const glm::mat4& model, const glm::mat3& normalModel, const glm::mat4& mvp);
-    void renderCombined(const GPUMesh& mesh,
-                        const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
-                        const glm::vec3& cameraPosition, const GLuint environmentMapTex);
-    void drawQuad(GLuint texture);
+    void freeTexturesAndFramebuffers();
+    void writeFrameUniforms(const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+    void prepareInstances(const GPUMesh& mesh, std::span<const MeshInstance> instances, const glm::mat4& viewProjection,
+                          const glm::mat4& projection, const glm::vec3& cameraPosition);
+    size_t selectMeshLod(const GPUMesh& mesh, const glm::mat4& model, const glm::mat4& projection, const glm::vec3& cameraPosition) const;
+    void renderGeometry(const GPUMesh& mesh);
+    void selectDrawBuffers(GLuint framebuffer, bool distanceInner) const;
+    void clearGBuffer() const;
+    uint64_t estimateGBufferBytes() const;
+    void renderGeometrySingle(const GPUMesh& mesh, const Shader& shader, bool reverseDepth, FaceCulling faceCulling, MeshletDrawList& drawList);
+    void drawMesh(const GPUMesh& mesh, const Shader& shader, FaceCulling faceCulling, MeshletDrawList& drawList);
+    void renderCombined(const GPUMesh& mesh, const glm::mat4& viewProjection, const GLuint environmentMapTex);
+    void resolveLowRes(const glm::ivec4& screenRect);
+    void allocateLowResTargets();
+    void bindShadingCounters();
+    void bindHistory(const glm::mat4& viewProjection);
+    void advanceHistory(const glm::mat4& viewProjection);
+    void bindCombinedTextures(const GLuint environmentMapTex);
+    glm::ivec4 instancesScreenRect(const glm::mat4& viewProjection) const;
+    void drawQuad(GLuint texture, bool invert = false);
+    void drawGBufferQuad(bool backFaces, bool showDistance);
 
     Config& m_config;
 
-    glm::ivec2 m_windowDims;
-    Shader m_renderGeometry, m_renderCombined, m_screenQuad;
+    glm::ivec2 m_renderDims;            // Resolution of the render targets and the output, which may be below that of the window
+    GLuint m_outputFramebuffer { 0 };   // Where the requested result of the current frame goes
+    GpuTimer m_gpuTimer;
+    GLuint m_frameUniforms;             // Frame uniform block of every pass
+    GLuint m_instanceBuffer;            // Instances storage block of every pass, indexed by gl_BaseInstance and the G-buffer's instance IDs
+    RenderStats m_stats {};
+    Shader m_renderGeometry, m_renderGeometryLayered, m_renderCombined, m_resolveCombined, m_screenQuad, m_compactView;
+
+    GLuint m_depthTexArray, m_depthTexFront, m_depthTexBack;   // Back face depth is stored reversed, as 1 - depth
+    GLuint m_normalsTexArray, m_normalsTexFront, m_normalsTexBack;
+    GLuint m_innerDistTexArray, m_innerDistTexFront, m_innerDistTexBack;
+    GLuint m_compactTexArray, m_compactTexFront, m_compactTexBack;
+    GLuint m_compactLowTexArray, m_compactLowTexFront, m_compactLowTexBack;
+    GLuint m_instanceTexArray, m_instanceTexFront, m_instanceTexBack;      // Instance each pixel shows
+    GLuint m_framebufferFront, m_framebufferBack, m_framebufferLayered;
+
+    // Instances of the current frame, with the level of detail and culling view picked for each
+    std::vector<MeshInstance> m_instances;
+    std::vector<GPUInstance> m_gpuInstances;
+    std::vector<size_t> m_instanceLods;    // Picked once per frame, so that every pass rasterises the same triangles
+    std::vector<CullingView> m_cullingViews;
+
+    // Reduced rate refraction. Allocated on first use, and again whenever the downsampling factor or resolution change
+    glm::ivec2 m_lowResDims { 0 };
+    GLuint m_lowResColorTex { 0 }, m_lowResGuideTex { 0 }, m_framebufferLowRes { 0 };
+
+    // Counters of RefractionShading, in a ring so that reading one back never waits for the frame that wrote it
+    static constexpr size_t NUM_SHADING_COUNTERS = 3ULL;
+    std::array<GLuint, NUM_SHADING_COUNTERS> m_shadingCounters;
+    std::array<bool, NUM_SHADING_COUNTERS> m_shadingCountersPending {};
+    size_t m_nextShadingCounter { 0ULL };
 
-    GLuint m_depthTexFront, m_depthTexBack;
-    GLuint m_normalsTexFront, m_normalsTexBack;
-    GLuint m_innerDistTexFront, m_innerDistTexBack;
-    GLuint m_framebufferFront, m_framebufferBack;
+    // Temporal reuse. Ping-pongs between two sets of images: one is written by the current frame, the other read as its history
+    std::array<GLuint, 2> m_historyColorTex, m_historyGuideTex;
+    size_t m_historyWrite { 0ULL };
+    bool m_historyValid { false };
+    glm::mat4 m_historyViewProjection { 1.0f };
+    uint32_t m_frameIndex { 0U };
+    int m_staleFrames { 0 };
 };
 
 
@@ -0,0 +1,379 @@
+#include "streaming_bake.h"
+
+#include <framework/ray.h>
+
+#include <omp.h>
+
+#include <ray_tracing/chunked_bvh.h>
+#include <render/mesh_optimizer.h>
+#include <utils/constants.h>
+#include <utils/memory_usage.h>
+#include <utils/paged_file.hpp>
+#include <utils/progressbar.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+
+static constexpr uint32_t NO_INDEX                  = std::numeric_limits<uint32_t>::max();
+static constexpr uint32_t MORTON_BITS_PER_AXIS      = 7U;               // 2^21 spatial bins to group triangles into chunks with
+static constexpr uint64_t CHUNK_BYTES_PER_TRIANGLE  = 512ULL;           // Upper estimate of the memory a chunk needs per triangle while it is built
+static constexpr uint64_t MIN_CHUNK_TRIANGLES       = 4096ULL;
+static constexpr uint64_t MIN_MEMORY_BUDGET         = 64ULL << 20ULL;
+static constexpr size_t STREAM_BLOCK_TRIANGLES      = 1ULL << 14ULL;    // Triangles per read in the sequential passes
+
+// Corner of an OBJ face; indices are zero-based, NO_INDEX if absent
+struct ObjCorner {
+    uint32_t position;
+    uint32_t texCoord;
+    uint32_t normal;
+
+    [[nodiscard]] constexpr auto operator<=>(const ObjCorner&) const noexcept = default;
+};
+using ObjTriangle = std::array<ObjCorner, 3>;
+static_assert(sizeof(ObjTriangle) == 36ULL);
+
+// Totals gathered while scanning the OBJ file
+struct ObjSummary {
+    uint64_t numPositions   { 0ULL };
+    uint64_t numNormals     { 0ULL };
+    uint64_t numTexCoords   { 0ULL };
+    uint64_t numTriangles   { 0ULL };
+    glm::dvec3 positionSum  { 0.0 };
+    AxisAlignedBox bounds   { .lower = glm::vec3(std::numeric_limits<float>::max()), .upper = glm::vec3(std::numeric_limits<float>::lowest()) };
+};
+
+// Scratch files live next to the cache file rather than in a (possibly memory-backed) temporary directory
+struct ScratchDirectory {
+    explicit ScratchDirectory(const std::filesystem::path& directory) : path(directory) { std::filesystem::create_directories(path); }
+    ~ScratchDirectory() {
+        std::error_code error;
+        std::filesystem::remove_all(path, error);
+    }
+
+    const std::filesystem::path path;
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string_view nextToken(std::string_view& line) {
+    const size_t start  = std::min(line.find_first_not_of(" \t\r"), line.size());
+    const size_t end    = std::min(line.find_first_of(" \t\r", start), line.size());
+    std::string_view token = line.substr(start, end - start);
+    line.remove_prefix(end);
+    return token;
+}
+
+static float parseFloat(std::string_view token, uint64_t lineNumber) {
+    float value;
+    const auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (error != std::errc() || token.empty()) { throw StreamingBakeException(std::format("Malformed number '{}' on line {}", token, lineNumber)); }
+    return value;
+}
+
+// Resolve a one-based (or negative, relative) OBJ index against the number of elements defined so far
+static uint32_t resolveIndex(std::string_view token, uint64_t numDefined, uint64_t lineNumber) {
+    if (token.empty()) { return NO_INDEX; }
+    int64_t index;
+    const auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), index);
+    const int64_t resolved  = index < 0 ? int64_t(numDefined) + index : index - 1;
+    if (error != std::errc() || index == 0 || resolved < 0 || resolved >= int64_t(numDefined) || resolved >= int64_t(NO_INDEX)) {
+        throw StreamingBakeException(std::format("Invalid index '{}' on line {}", token, lineNumber));
+    }
+    return static_cast<uint32_t>(resolved);
+}
+
+// Attributes go to flat binary files in the order they are defined, faces are fan-triangulated into a file of corner triplets
+static ObjSummary scanObj(const std::filesystem::path& modelPath, const std::filesystem::path& scratchPath) {
+    std::ifstream objFile(modelPath);
+    std::ofstream positions(scratchPath / "positions.bin", std::ios::binary);
+    std::ofstream normals(scratchPath / "normals.bin", std::ios::binary);
+    std::ofstream texCoords(scratchPath / "texcoords.bin", std::ios::binary);
+    std::ofstream triangles(scratchPath / "triangles.bin", std::ios::binary);
+    if (!objFile) { throw StreamingBakeException(std::format("Could not open {}", modelPath.string())); }
+
+    ObjSummary summary;
+    std::string lineBuffer;
+    std::vector<ObjCorner> face;
+    for (uint64_t lineNumber = 1ULL; std::getline(objFile, lineBuffer); lineNumber++) {
+        std::string_view line       = lineBuffer;
+        const std::string_view type = nextToken(line);
+        if (type == "v") {
+            glm::vec3 position;
+            for (int axis = 0; axis < 3; axis++) { position[axis] = parseFloat(nextToken(line), lineNumber); }
+            positions.write(reinterpret_cast<const char*>(&position), sizeof(glm::vec3));
+            summary.positionSum     += glm::dvec3(position);
+            summary.bounds.lower     = glm::min(summary.bounds.lower, position);
+            summary.bounds.upper     = glm::max(summary.bounds.upper, position);
+            summary.numPositions++;
+        } else if (type == "vn") {
+            glm::vec3 normal;
+            for (int axis = 0; axis < 3; axis++) { normal[axis] = parseFloat(nextToken(line), lineNumber); }
+            normals.write(reinterpret_cast<const char*>(&normal), sizeof(glm::vec3));
+            summary.numNormals++;
+        } else if (type == "vt") {
+            glm::vec2 texCoord;
+            for (int axis = 0; axis < 2; axis++) { texCoord[axis] = parseFloat(nextToken(line), lineNumber); }
+            texCoords.write(reinterpret_cast<const char*>(&texCoord), sizeof(glm::vec2));
+            summary.numTexCoords++;
+        } else if (type == "f") {
+            face.clear();
+            for (std::string_view corner = nextToken(line); !corner.empty(); corner = nextToken(line)) {
+                // v, v/vt, v//vn or v/vt/vn
+                const size_t firstSlash     = std::min(corner.find('/'), corner.size());
+                const size_t secondSlash    = std::min(corner.find('/', firstSlash + 1ULL), corner.size());
+                const std::string_view texCoordToken = firstSlash < corner.size() ? corner.substr(firstSlash + 1ULL, secondSlash - firstSlash - 1ULL) : std::string_view();
+                const std::string_view normalToken   = secondSlash < corner.size() ? corner.substr(secondSlash + 1ULL) : std::string_view();
+                face.push_back({ .position  = resolveIndex(corner.substr(0ULL, firstSlash), summary.numPositions, lineNumber),
+                                 .texCoord  = resolveIndex(texCoordToken, summary.numTexCoords, lineNumber),
+                                 .normal    = resolveIndex(normalToken, summary.numNormals, lineNumber) });
+                if (face.back().position == NO_INDEX) { throw StreamingBakeException(std::format("Face corner without a position on line {}", lineNumber)); }
+            }
+            for (size_t cornerIdx = 2ULL; cornerIdx < face.size(); cornerIdx++) {
+                const ObjTriangle triangle = { face[0], face[cornerIdx - 1ULL], face[cornerIdx] };
+                triangles.write(reinterpret_cast<const char*>(&triangle), sizeof(ObjTriangle));
+                summary.numTriangles++;
+            }
+        }
+    }
+    if (!positions || !normals || !texCoords || !triangles) { throw StreamingBakeException("Failed writing streaming bake scratch files"); }
+    return summary;
+}
+
+// Same normalisation as loadMesh(): centre on the mean position and scale the furthest position to unit distance
+static float maxDistanceFrom(const std::filesystem::path& positionsPath, const glm::vec3& center) {
+    std::ifstream positions(positionsPath, std::ios::binary);
+    std::vector<glm::vec3> block(STREAM_BLOCK_TRIANGLES);
+    float maxDistance = 0.0f;
+    while (positions.read(reinterpret_cast<char*>(block.data()), static_cast<std::streamsize>(block.size() * sizeof(glm::vec3))) || positions.gcount() > 0) {
+        const size_t numRead = static_cast<size_t>(positions.gcount()) / sizeof(glm::vec3);
+        for (size_t positionIdx = 0ULL; positionIdx < numRead; positionIdx++) { maxDistance = std::max(maxDistance, glm::length(block[positionIdx] - center)); }
+    }
+    return maxDistance;
+}
+
+static uint32_t mortonCode(const glm::vec3& point, const AxisAlignedBox& bounds) {
+    constexpr uint32_t cellsPerAxis = 1U << MORTON_BITS_PER_AXIS;
+    const glm::vec3 relative        = (point - bounds.lower) / glm::max(bounds.upper - bounds.lower, glm::vec3(std::numeric_limits<float>::min()));
+    const glm::uvec3 cell           = glm::min(glm::uvec3(glm::max(relative, 0.0f) * float(cellsPerAxis)), glm::uvec3(cellsPerAxis - 1U));
+    uint32_t code = 0U;
+    for (uint32_t bit = 0U; bit < MORTON_BITS_PER_AXIS; bit++) {
+        for (uint32_t axis = 0U; axis < 3U; axis++) { code |= ((cell[static_cast<glm::length_t>(axis)] >> bit) & 1U) << (3U * bit + axis); }
+    }
+    return code;
+}
+
+// Calls processBlock for consecutive blocks of the triangle file
+template<typename F>
+static void forEachTriangleBlock(const std::filesystem::path& trianglesPath, F&& processBlock) {
+    std::ifstream triangles(trianglesPath, std::ios::binary);
+    std::vector<ObjTriangle> block(STREAM_BLOCK_TRIANGLES);
+    while (triangles.read(reinterpret_cast<char*>(block.data()), static_cast<std::streamsize>(block.size() * sizeof(ObjTriangle))) || triangles.gcount() > 0) {
+        processBlock(std::span<const ObjTriangle>(block.data(), static_cast<size_t>(triangles.gcount()) / sizeof(ObjTriangle)));
+    }
+}
+
+bool supportsStreamingBake(const std::filesystem::path& modelPath) {
+    std::string extension = modelPath.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".obj";
+}
+
+void streamBake(const std::filesystem::path& modelPath, const std::filesystem::path& cachePath, const CacheHeader& header, const Config& config) {
+    // Split the memory budget between the chunk being built, the resident chunk BVHs, attribute page caches and scatter buffers
+    const uint64_t memoryBudget         = std::max<uint64_t>(static_cast<uint64_t>(std::max(config.streamingMemoryMiB, 0)) << 20ULL, MIN_MEMORY_BUDGET);
+    const uint64_t maxChunkTriangles    = std::max<uint64_t>(memoryBudget / 4ULL / CHUNK_BYTES_PER_TRIANGLE, MIN_CHUNK_TRIANGLES);
+    const uint64_t residentChunkBudget  = memoryBudget / 2ULL;
+    const uint64_t scatterBudget        = memoryBudget / 8ULL;
+    const uint64_t positionPageBudget   = memoryBudget / 16ULL;
+    const uint64_t attributePageBudget  = memoryBudget / 32ULL;
+    utils::resetPeakResidentBytes();
+    const auto start = std::chrono::steady_clock::now();
+    const ScratchDirectory scratch(std::filesystem::path(cachePath.string() + ".work"));
+
+    // Pass 1: scan the OBJ file
+    const ObjSummary summary = scanObj(modelPath, scratch.path);
+    if (summary.numTriangles == 0ULL) { throw StreamingBakeException(std::format("{} contains no faces", modelPath.string())); }
+    const glm::vec3 center      = glm::vec3(summary.positionSum / double(summary.numPositions));
+    const float maxDistance     = maxDistanceFrom(scratch.path / "positions.bin", center);
+    std::cout << std::format("Scanned {} positions and {} triangles in {:.1f} s", summary.numPositions, summary.numTriangles, secondsSince(start)) << std::endl;
+
+    // Pass 2: histogram triangle centroids along a Morton curve and cut it into chunks of bounded size.
+    // A single overfull bin still becomes one (larger) chunk
+    utils::PagedFile<glm::vec3> positions(scratch.path / "positions.bin", positionPageBudget);
+    std::vector<uint32_t> binToChunk(1ULL << (3U * MORTON_BITS_PER_AXIS), 0U); // Holds triangle counts until chunks are assigned
+    {
+        std::ofstream bins(scratch.path / "bins.bin", std::ios::binary);
+        std::vector<uint32_t> blockBins;
+        forEachTriangleBlock(scratch.path / "triangles.bin", [&](std::span<const ObjTriangle> block) {
+            blockBins.clear();
+            for (const ObjTriangle& triangle : block) {
+                const glm::vec3 centroid = (positions[triangle[0].position] + positions[triangle[1].position] + positions[triangle[2].position]) / 3.0f;
+                blockBins.push_back(mortonCode(centroid, summary.bounds));
+                binToChunk[blockBins.back()]++;
+            }
+            bins.write(reinterpret_cast<const char*>(blockBins.data()), static_cast<std::streamsize>(blockBins.size() * sizeof(uint32_t)));
+        });
+    }
+    std::vector<uint64_t> chunkSizes;
+    for (uint32_t& bin : binToChunk) {
+        const uint32_t binTriangles = bin;
+        if (binTriangles == 0U) { continue; }
+        if (chunkSizes.empty() || chunkSizes.back() + binTriangles > maxChunkTriangles) { chunkSizes.push_back(0ULL); }
+        chunkSizes.back() += binTriangles;
+        bin = static_cast<uint32_t>(chunkSizes.size() - 1ULL);
+    }
+    std::vector<uint64_t> chunkFirstTriangle(chunkSizes.size());
+    std::exclusive_scan(chunkSizes.begin(), chunkSizes.end(), chunkFirstTriangle.begin(), 0ULL);
+
+    // Pass 3: scatter the triangles into one contiguous range per chunk, through small per-chunk buffers
+    {
+        std::ofstream buckets(scratch.path / "buckets.bin", std::ios::binary);
+        std::ifstream bins(scratch.path / "bins.bin", std::ios::binary);
+        const size_t bufferTriangles = std::max<size_t>(scatterBudget / (chunkSizes.size() * sizeof(ObjTriangle)), 64ULL);
+        std::vector<std::vector<ObjTriangle>> buffers(chunkSizes.size());
+        std::vector<uint64_t> chunkCursors = chunkFirstTriangle;
+        auto flush = [&](uint32_t chunkIdx) {
+            std::vector<ObjTriangle>& buffer = buffers[chunkIdx];
+            buckets.seekp(static_cast<std::streamoff>(chunkCursors[chunkIdx] * sizeof(ObjTriangle)));
+            buckets.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(ObjTriangle)));
+            chunkCursors[chunkIdx] += buffer.size();
+            buffer.clear();
+        };
+        std::vector<uint32_t> blockBins(STREAM_BLOCK_TRIANGLES);
+        forEachTriangleBlock(scratch.path / "triangles.bin", [&](std::span<const ObjTriangle> block) {
+            bins.read(reinterpret_cast<char*>(blockBins.data()), static_cast<std::streamsize>(block.size() * sizeof(uint32_t)));
+            for (size_t triangleIdx = 0ULL; triangleIdx < block.size(); triangleIdx++) {
+                const uint32_t chunkIdx = binToChunk[blockBins[triangleIdx]];
+                buffers[chunkIdx].push_back(block[triangleIdx]);
+                if (buffers[chunkIdx].size() >= bufferTriangles) { flush(chunkIdx); }
+            }
+        });
+        for (uint32_t chunkIdx = 0U; chunkIdx < buffers.size(); chunkIdx++) { flush(chunkIdx); }
+        if (!buckets || !bins) { throw StreamingBakeException("Failed writing streaming bake scratch files"); }
+    }
+    binToChunk = {};
+    std::filesystem::remove(scratch.path / "triangles.bin");
+    std::filesystem::remove(scratch.path / "bins.bin");
+    std::cout << std::format("Grouped triangles into {} chunks of at most {} triangles in {:.1f} s", chunkSizes.size(), maxChunkTriangles, secondsSince(start)) << std::endl;
+
+    // Pass 4: turn every chunk into vertices and triangles, append those to the cache and move the chunk's BVH to the node store
+    ChunkedBVH bvh(scratch.path / "nodes.bin", residentChunkBudget, config);
+    MeshCacheStreamWriter writer(cachePath, header, Material {}, summary.numTriangles);
+    std::vector<uint64_t> chunkFirstVertex;
+    {
+        utils::PagedFile<glm::vec3> normals(scratch.path / "normals.bin", attributePageBudget);
+        utils::PagedFile<glm::vec2> texCoords(scratch.path / "texcoords.bin", attributePageBudget);
+        std::ifstream buckets(scratch.path / "buckets.bin", std::ios::binary);
+        std::vector<ObjTriangle> chunkTriangles;
+        std::vector<uint32_t> cornerOrder, cornerToVertex, firstCorner;
+        std::vector<glm::uvec3> cacheTriangles;
+        Mesh chunkMesh;
+        for (uint64_t chunkSize : chunkSizes) {
+            chunkTriangles.resize(chunkSize);
+            buckets.read(reinterpret_cast<char*>(chunkTriangles.data()), static_cast<std::streamsize>(chunkSize * sizeof(ObjTriangle)));
+            if (!buckets) { throw StreamingBakeException("Failed reading streaming bake scratch files"); }
+
+            // Deduplicate corners by their full index triple; sorting keeps this free of hash maps and yields a deterministic order
+            const ObjCorner* corners = chunkTriangles.front().data();
+            cornerOrder.resize(chunkSize * 3ULL);
+            cornerToVertex.resize(chunkSize * 3ULL);
+            std::iota(cornerOrder.begin(), cornerOrder.end(), 0U);
+            std::sort(cornerOrder.begin(), cornerOrder.end(), [&](uint32_t lhs, uint32_t rhs) { return std::tie(corners[lhs], lhs) < std::tie(corners[rhs], rhs); });
+            firstCorner.clear();
+            for (size_t orderIdx = 0ULL; orderIdx < cornerOrder.size(); orderIdx++) {
+                const uint32_t cornerIdx = cornerOrder[orderIdx];
+                if (orderIdx == 0ULL || corners[cornerIdx] != corners[cornerOrder[orderIdx - 1ULL]]) { firstCorner.push_back(cornerIdx); }
+                cornerToVertex[cornerIdx] = static_cast<uint32_t>(firstCorner.size() - 1ULL);
+            }
+
+            chunkMesh.vertices.resize(firstCorner.size());
+            chunkMesh.triangles.resize(chunkSize);
+            for (size_t vertexIdx = 0ULL; vertexIdx < firstCorner.size(); vertexIdx++) {
+                const ObjCorner& corner = corners[firstCorner[vertexIdx]];
+                Vertex& vertex          = chunkMesh.vertices[vertexIdx];
+                vertex.position         = (positions[corner.position] - center) / maxDistance;
+                vertex.texCoord         = corner.texCoord != NO_INDEX ? texCoords[corner.texCoord] : glm::vec2(0.0f);
+                vertex.distanceInner    = std::numeric_limits<float>::max();
+            }
+            for (size_t triangleIdx = 0ULL; triangleIdx < chunkSize; triangleIdx++) {
+                chunkMesh.triangles[triangleIdx] = { cornerToVertex[3ULL * triangleIdx], cornerToVertex[3ULL * triangleIdx + 1ULL], cornerToVertex[3ULL * triangleIdx + 2ULL] };
+            }
+            for (size_t vertexIdx = 0ULL; vertexIdx < firstCorner.size(); vertexIdx++) {
+                // Vertices without a normal take the geometric normal of the triangle that first referenced them, as in loadMesh()
+                const ObjCorner& corner     = corners[firstCorner[vertexIdx]];
+                const glm::uvec3& triangle  = chunkMesh.triangles[firstCorner[vertexIdx] / 3U];
+                const glm::vec3 v0          = chunkMesh.vertices[triangle.x].position;
+                const glm::vec3 v1          = chunkMesh.vertices[triangle.y].position;
+                const glm::vec3 v2          = chunkMesh.vertices[triangle.z].position;
+                chunkMesh.vertices[vertexIdx].normal = corner.normal != NO_INDEX ? normals[corner.normal] : glm::normalize(glm::cross(v1 - v0, v2 - v0));
+            }
+
+            // The GPU optimisations only need locality, so chunks are optimised on their own
+            if (header.bake.optimized) { optimizeMesh(chunkMesh); }
+
+            // Cached triangles index into the vertices of all chunks
+            const uint64_t firstVertex = chunkFirstVertex.empty() ? 0ULL : chunkFirstVertex.back();
+            if (firstVertex + chunkMesh.vertices.size() > uint64_t(NO_INDEX)) { throw StreamingBakeException("Model has too many vertices for 32-bit indices"); }
+            cacheTriangles.resize(chunkSize);
+            for (size_t triangleIdx = 0ULL; triangleIdx < chunkSize; triangleIdx++) { cacheTriangles[triangleIdx] = chunkMesh.triangles[triangleIdx] + glm::uvec3(static_cast<uint32_t>(firstVertex)); }
+            writer.appendTriangles(cacheTriangles);
+            writer.appendVertices(chunkMesh.vertices);
+            if (chunkFirstVertex.empty()) { chunkFirstVertex.push_back(0ULL); }
+            chunkFirstVertex.push_back(firstVertex + chunkMesh.vertices.size());
+            bvh.addChunk(chunkMesh);
+        }
+    }
+    std::filesystem::remove(scratch.path / "buckets.bin");
+    bvh.finalize();
+    std::cout << std::format("Built {} chunk BVHs ({:.1f} MiB node store) in {:.1f} s", bvh.numChunks(), double(bvh.storeBytes()) / double(1ULL << 20ULL), secondsSince(start)) << std::endl;
+
+    // Pass 5: trace d_N chunk by chunk, reading the chunk's vertices back from the cache and patching them in place.
+    // Chunks follow the Morton curve, so consecutive chunks mostly trace against the same resident BVHs
+    std::cout << "Computing inner distances..." << std::endl;
+    progressbar progressbar(static_cast<int32_t>(chunkSizes.size()));
+    std::vector<Vertex> vertices;
+    for (size_t chunkIdx = 0ULL; chunkIdx < chunkSizes.size(); chunkIdx++) {
+        vertices.resize(chunkFirstVertex[chunkIdx + 1ULL] - chunkFirstVertex[chunkIdx]);
+        writer.readVertices(chunkFirstVertex[chunkIdx], vertices);
+
+        // Signed loop index for MSVC's OpenMP, as in MeshManager::loadAndComputeDist()
+        #pragma omp parallel for
+        for (int32_t vertexIdx = 0; vertexIdx < static_cast<int32_t>(vertices.size()); vertexIdx++) {
+            Vertex& vertex          = vertices[static_cast<size_t>(vertexIdx)];
+            glm::vec3 reverseNormal = -vertex.normal;
+            Ray interiorRay = {
+                .origin     = vertex.position + utils::INTERIOR_RAY_OFFSET * reverseNormal,
+                .direction  = reverseNormal,
+                .t          = std::numeric_limits<float>::max()
+            };
+            HitInfo hitInfo;
+            bvh.intersect(interiorRay, hitInfo);
+            vertex.distanceInner = interiorRay.t;
+        }
+
+        writer.writeVertices(chunkFirstVertex[chunkIdx], vertices);
+        progressbar.update();
+    }
+    writer.finish();
+    std::cout << std::endl << "Finished computing inner distances!" << std::endl;
+
+    std::cout << std::format("Streamed bake of {} vertices and {} triangles took {:.1f} s: {} chunk loads, peak resident memory {:.1f} MiB (budget {} MiB)",
+                             chunkFirstVertex.back(), summary.numTriangles, secondsSince(start), bvh.chunkLoads(),
+                             double(utils::peakResidentBytes()) / double(1ULL << 20ULL), memoryBudget >> 20ULL) << std::endl;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef _STREAMING_BAKE_H_
+#define _STREAMING_BAKE_H_
+
+#include <render/mesh_cache.h>
+#include <utils/config.h>
+
+#include <filesystem>
+#include <stdexcept>
+
+struct StreamingBakeException : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Whether streamBake() can handle the given model; only OBJ files are streamed
+bool supportsStreamingBake(const std::filesystem::path& modelPath);
+
+/**
+ * Compute d_N for a model without ever holding it in memory as a whole, and write the result as an uncompressed cache file.
+ * The OBJ file is read sequentially into attribute files, its triangles are grouped into spatial chunks along a Morton curve
+ * and every chunk is deduplicated, normalised and written to the cache. Each chunk's BVH is built and moved to an on-disk
+ * node store (see chunked_bvh.h), after which d_N is traced chunk by chunk and patched into the cache in place.
+ *
+ * Every face of the file becomes part of a single mesh with the default material. Vertices are only deduplicated within
+ * a chunk, so those on chunk borders are duplicated; their d_N is unaffected. Scratch files are kept next to the cache file
+ *
+ * @param modelPath OBJ file to bake
+ * @param cachePath File to write the cache to
+ * @param header Header of the cache file
+ * @param config Config to bake with; streamingMemoryMiB bounds the memory used by chunks, page caches and buffers
+*/
+void streamBake(const std::filesystem::path& modelPath, const std::filesystem::path& cachePath, const CacheHeader& header, const Config& config);
+
+
+#endif // _STREAMING_BAKE_H_
@@ -1,5 +1,6 @@
 #include "texture.h"
 
+#include <framework/gl_state.h>
 #include <framework/image.h>
 
 #include <iostream>
@@ -58,6 +59,5 @@ Texture::~Texture()
 
 void Texture::bind(GLint textureSlot)
 {
-    glActiveTexture(textureSlot);
-    glBindTexture(GL_TEXTURE_2D, m_texture);
+    gl_state::bindTextureUnit(static_cast<GLuint>(textureSlot - GL_TEXTURE0), m_texture);
 }
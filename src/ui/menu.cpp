@@ -10,24 +10,53 @@ DISABLE_WARNINGS_POP()
 #include <utils/magic_enum.hpp>
 
 #include <algorithm>
+#include <array>
 #include <iterator>
+#include <string_view>
+#include <utility>
 
 
-Menu::Menu(Config& config, MeshManager& meshManager)
+Menu::Menu(Config& config, MeshManager& meshManager, DispersionBenchmark& dispersionBenchmark)
     : m_config(config)
-    , m_meshManager(meshManager) {}
+    , m_meshManager(meshManager)
+    , m_dispersionBenchmark(dispersionBenchmark) {}
 
-void Menu::draw() {
+void Menu::draw(const RenderStats& renderStats) {
     ImGui::Begin("Controls");
 
     // Button to select model
     if (ImGui::Button("Change model")) {
         nfdchar_t *outPath  = nullptr;
-        nfdresult_t result  = NFD_OpenDialog("obj;cache", nullptr, &outPath);
+        nfdresult_t result  = NFD_OpenDialog("obj,ply,gltf,glb;cache", nullptr, &outPath);
         if (result == NFD_OKAY)         { m_meshManager.loadNewMesh(outPath); }
         else if (result == NFD_ERROR)   { throw std::runtime_error("NFD encountered an error"); }
         free(outPath);
     }
+    ImGui::Checkbox("Parallel OBJ parsing", &m_config.parallelObjParsing);
+    ImGui::Checkbox("Weld vertices", &m_config.weldVertices);
+    if (m_config.weldVertices) {
+        ImGui::InputFloat("Weld distance", &m_config.weldEpsilon, 0.0f, 0.0f, "%.1e");
+        m_config.weldEpsilon = std::max(m_config.weldEpsilon, 0.0f);
+    }
+    ImGui::Checkbox("Optimize mesh for GPU", &m_config.optimizeMesh);
+    ImGui::Checkbox("Generate LODs", &m_config.generateLods);
+    ImGui::Checkbox("Streaming bake", &m_config.streamingBake);
+    if (m_config.streamingBake && ImGui::InputInt("Streaming memory (MiB)", &m_config.streamingMemoryMiB, 64, 256)) {
+        m_config.streamingMemoryMiB = std::max(m_config.streamingMemoryMiB, 64);
+    }
+
+    // Cache directory maintenance
+    CacheDirectory& cacheDirectory = m_meshManager.cacheDirectory();
+    if (ImGui::Checkbox("Compress mesh cache", &m_config.compressCache)) { m_meshManager.updateCacheFormat(); }
+    if (ImGui::InputInt("Cache budget (MiB)", &m_config.cacheBudgetMiB, 256, 1024)) {
+        m_config.cacheBudgetMiB = std::max(m_config.cacheBudgetMiB, 0);
+        cacheDirectory.setByteBudget(static_cast<uint64_t>(m_config.cacheBudgetMiB) << 20ULL);
+    }
+    ImGui::Text("Cache usage: %.1f MiB", static_cast<double>(cacheDirectory.totalBytes()) / static_cast<double>(1ULL << 20ULL));
+    if (ImGui::Button("Prune cache"))   { cacheDirectory.prune(); }
+    ImGui::SameLine();
+    if (ImGui::Button("Verify cache"))  { cacheDirectory.verify(); }
+    ImGui::Separator();
 
     // Selection controls for which thing to draw
     constexpr auto renderOptions = magic_enum::enum_names<RenderOption>();
@@ -36,12 +65,105 @@ void Menu::draw() {
         [](const auto& str) { return str.data(); });
     ImGui::Combo("Render mode", (int*) &m_config.currentRender, renderOptionsPointers.data(), static_cast<int>(renderOptionsPointers.size()));
 
+    // Level of detail selection
+    const int numLods = static_cast<int>(m_meshManager.getMesh().lods().size());
+    ImGui::SliderFloat("LOD error (pixels)", &m_config.lodPixelError, 0.1f, 8.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+    ImGui::SliderInt("Forced LOD", &m_config.forcedLod, -1, numLods - 1, m_config.forcedLod < 0 ? "Automatic" : "%d");
+    ImGui::Checkbox("Meshlet culling", &m_config.meshletCulling);
+    if (m_config.meshletCulling) {
+        ImGui::Checkbox("Normal cone culling", &m_config.coneCulling);
+    }
+    ImGui::SliderInt("Instances", &m_config.numInstances, 1, 64, "%d", ImGuiSliderFlags_Logarithmic);
+    ImGui::Checkbox("Render only on change", &m_config.onDemandRendering);
+    ImGui::Checkbox("Wait for input", &m_config.waitForInput);
+    ImGui::Checkbox("Dynamic resolution", &m_config.dynamicResolution);
+    if (m_config.dynamicResolution) {
+        ImGui::SliderFloat("GPU budget (ms)", &m_config.frameBudgetMs, 1.0f, 50.0f, "%.1f");
+        ImGui::SliderFloat("Minimum resolution scale", &m_config.minResolutionScale, 0.25f, 1.0f, "%.2f");
+    }
+    ImGui::Checkbox("Single-pass front and back faces", &m_config.layeredGeometry);
+    constexpr auto gbufferLayouts = magic_enum::enum_names<GBufferLayout>();
+    std::vector<const char*> gbufferLayoutsPointers;
+    std::transform(std::begin(gbufferLayouts), std::end(gbufferLayouts), std::back_inserter(gbufferLayoutsPointers),
+        [](const auto& str) { return str.data(); });
+    ImGui::Combo("G-buffer layout", (int*) &m_config.gbufferLayout, gbufferLayoutsPointers.data(), static_cast<int>(gbufferLayoutsPointers.size()));
+    drawRenderStats(renderStats);
+
     // Draw combined rendering controls only if the combined result is being viewed
     if (m_config.currentRender == RenderOption::Combined) {
         ImGui::Checkbox("Show environment map", &m_config.showEnvironmentMap);
+        ImGui::Checkbox("Deferred combined pass", &m_config.deferredCombined);
+        if (m_config.deferredCombined) {
+            ImGui::Text("Refraction rate");
+            ImGui::RadioButton("Full", &m_config.refractionDownsample, 1);
+            ImGui::SameLine();
+            ImGui::RadioButton("Half", &m_config.refractionDownsample, 2);
+            ImGui::SameLine();
+            ImGui::RadioButton("Quarter", &m_config.refractionDownsample, 4);
+            ImGui::SliderInt("Temporal reuse interval", &m_config.temporalInterval, 1, 4);
+        }
         ImGui::SliderFloat("Refractive index ratio", &m_config.refractiveIndexRatio, 1.0f, 2.0f);
         ImGui::ColorEdit3("Per-color transparency", glm::value_ptr(m_config.transparency));
+        drawDispersionControls();
     }
 
     ImGui::End();
 }
+
+void Menu::drawDispersionControls() {
+    // The mode is under the benchmark's control while it runs
+    if (m_dispersionBenchmark.running()) {
+        ImGui::Text("Benchmarking dispersion...");
+    } else {
+        constexpr auto dispersionModes = magic_enum::enum_names<Dispersion>();
+        std::vector<const char*> dispersionModesPointers;
+        std::transform(std::begin(dispersionModes), std::end(dispersionModes), std::back_inserter(dispersionModesPointers),
+            [](const auto& str) { return str.data(); });
+        ImGui::Combo("Dispersion", (int*) &m_config.dispersion, dispersionModesPointers.data(), static_cast<int>(dispersionModesPointers.size()));
+        if (ImGui::Button("Benchmark dispersion")) { m_dispersionBenchmark.start(); }
+    }
+    if (m_config.dispersion != Dispersion::None || m_dispersionBenchmark.running()) {
+        ImGui::SliderFloat("Dispersion spread", &m_config.dispersionSpread, 0.0f, 0.2f, "%.3f");
+    }
+
+    // Relative to the monochrome path
+    const auto& results = m_dispersionBenchmark.results();
+    for (size_t mode = 0ULL; mode < results.size(); mode++) {
+        if (!results[mode]) { continue; }
+        const std::string_view name = magic_enum::enum_name(static_cast<Dispersion>(mode));
+        if (results[0])     { ImGui::Text("  %.*s: %.3f ms (%.2fx)", static_cast<int>(name.size()), name.data(), *results[mode], *results[mode] / *results[0]); }
+        else                { ImGui::Text("  %.*s: %.3f ms", static_cast<int>(name.size()), name.data(), *results[mode]); }
+    }
+}
+
+void Menu::drawRenderStats(const RenderStats& renderStats) {
+    ImGui::Text("LOD %zu of %d", renderStats.lod, static_cast<int>(m_meshManager.getMesh().lods().size()));
+    ImGui::Text("G-buffer traffic: ~%.1f MiB per frame", static_cast<double>(renderStats.gbufferBytes) / static_cast<double>(1ULL << 20ULL));
+    if (renderStats.gpuMilliseconds)    { ImGui::Text("Rendering at %dx%d in %.2f ms of GPU time", renderStats.renderDims.x, renderStats.renderDims.y, *renderStats.gpuMilliseconds); }
+    else                                { ImGui::Text("Rendering at %dx%d", renderStats.renderDims.x, renderStats.renderDims.y); }
+    ImGui::Text("GL binds: %u issued, %u skipped as redundant", renderStats.stateCalls.issued, renderStats.stateCalls.skipped);
+    const std::array<std::pair<const char*, const MeshletDrawList*>, 3> passes = {{ { "Front faces", &renderStats.front },
+                                                                                     { "Back faces", &renderStats.back },
+                                                                                     { "Combined", &renderStats.combined } }};
+    for (const auto& [name, drawList] : passes) {
+        if (drawList == &renderStats.combined && m_config.deferredCombined) {
+            ImGui::Text("%s: resolved per pixel from the front faces", name);
+            if (const auto& shading = renderStats.refractionShading; shading && shading->coveredPixels > 0U) {
+                // Relative to refracting every covered pixel at full rate. This counts evaluations, not GPU time: upsampling and
+                // reprojection cost time of their own, which the GPU time above includes
+                const GLuint refracted  = shading->lowResEvaluations + shading->fullRateEvaluations;
+                const float saved       = 100.0f * (1.0f - float(refracted) / float(shading->coveredPixels));
+                ImGui::Text("  %u of %u pixels refracted, %u at full rate, %u reused (%.1f%% of refraction evaluations saved)",
+                            refracted, shading->coveredPixels, shading->fullRateEvaluations, shading->reusedPixels, static_cast<double>(saved));
+            }
+            continue;
+        }
+        if (drawList == &renderStats.back && m_config.layeredGeometry) {
+            ImGui::Text("%s: rendered in the same pass as the front faces", name);
+            continue;
+        }
+        const float culled = drawList->totalMeshlets == 0U ? 0.0f : 100.0f * float(drawList->totalMeshlets - drawList->visibleMeshlets) / float(drawList->totalMeshlets);
+        ImGui::Text("%s: %u/%u meshlets, %llu triangles in %zu commands of one draw (%.1f%% culled)", name, drawList->visibleMeshlets, drawList->totalMeshlets,
+                    static_cast<unsigned long long>(drawList->visibleTriangles), drawList->commands.size(), static_cast<double>(culled));
+    }
+}
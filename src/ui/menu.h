@@ -2,19 +2,25 @@
 #ifndef _MENU_H_
 #define _MENU_H_
 
+#include <render/dispersion_benchmark.h>
 #include <render/mesh_manager.h>
+#include <render/refraction.h>
 #include <utils/config.h>
 
 
 class Menu {
 public:
-    Menu(Config& config, MeshManager& meshManager);
+    Menu(Config& config, MeshManager& meshManager, DispersionBenchmark& dispersionBenchmark);
 
-    void draw();
+    void draw(const RenderStats& renderStats);
 
 private:
+    void drawRenderStats(const RenderStats& renderStats);
+    void drawDispersionControls();
+
     Config& m_config;
     MeshManager& m_meshManager;
+    DispersionBenchmark& m_dispersionBenchmark;
 };
 
 #endif
\ No newline at end of file
@@ -17,15 +17,61 @@ enum class RenderOption {
     Combined
 };
 
+// Storage of the G-buffer's normals and inner distances, see write-geometric.frag
+enum class GBufferLayout {
+    Standard = 0,           // RGB16F normals and R32F distances, in separate textures
+    Compact,                // Octahedral normals as 16-bit snorms and float distances, in one RG32UI texture
+    CompactLowPrecision     // Octahedral normals as 8-bit snorms and half float distances, in one R32UI texture
+};
+
+// Splitting of refracted light into its colors, see refract-resolve.frag
+enum class Dispersion {
+    None = 0,
+    ThreeWavelengths,       // Red, green and blue each take a path of their own through the interior
+    ExitOffset              // Only green is traced through the interior; the colors part where it leaves the back faces
+};
+
 struct Config {
     // Refraction rendering
     RenderOption currentRender  { RenderOption::Combined }; // The thing to be currently rendered
     bool showEnvironmentMap     { true };
     float refractiveIndexRatio  { 1.1f };
     glm::vec3 transparency      { 1.0f };
+    Dispersion dispersion       { Dispersion::None };
+    float dispersionSpread      { 0.04f };  // Difference between the refractive index ratios of blue and red light
+    int numInstances            { 1 };      // Copies of the model, laid out on a grid with varying materials (see makeInstanceGrid())
+    float lodPixelError         { 1.0f };   // Largest simplification error, in pixels, a level of detail may show on screen
+    int forcedLod               { -1 };     // Level of detail to draw regardless of screen size, or -1 to pick it automatically
+    bool onDemandRendering      { true };   // Only render the scene again when the camera, model or config changed
+    bool waitForInput           { false };  // Sleep until an input event arrives, rather than presenting frames continuously
+    bool dynamicResolution      { false };  // Render the scene below the window's resolution whenever it would exceed the frame budget
+    float frameBudgetMs         { 16.0f };  // GPU time the refraction passes may take per frame
+    float minResolutionScale    { 0.5f };   // Lowest fraction of the window's width and height dynamic resolution may go down to
+    bool meshletCulling         { true };   // Skip meshlets outside of the frustum
+    bool coneCulling            { false };  // Also skip meshlets facing away from what a pass renders. Assumes counter-clockwise front faces
+    bool layeredGeometry        { true };   // Render front and back faces in a single pass into two-layer targets
+    GBufferLayout gbufferLayout { GBufferLayout::Compact };
+    bool deferredCombined       { true };   // Resolve the combined result per pixel from the front faces instead of drawing the mesh again
+    int refractionDownsample    { 1 };      // Resolve it once per block of this many pixels along each axis (1, 2 or 4) and upsample the result
+    int temporalInterval        { 1 };      // Resolve every pixel at least once per this many frames, reprojecting the previous frame in between
+
+    // Model loading
+    bool parallelObjParsing     { true };   // Parse OBJ files on all cores instead of with tinyobjloader
+    bool weldVertices           { false };  // Merge nearby vertices and regenerate smooth normals before baking
+    float weldEpsilon           { 1e-5f };  // Welding distance, relative to the unit-sized model
+    bool optimizeMesh           { true };   // Reorder triangles and vertices for the vertex cache, overdraw and vertex fetches
+    bool generateLods           { true };   // Bake a chain of simplified meshes to draw distant models with
+    bool streamingBake          { false };  // Bake OBJ files out of core, in spatial chunks, for models that do not fit in memory
+    int streamingMemoryMiB      { 1024 };   // Memory a streamed bake may hold on to at any one time
 
     // Inner object distance ray-tracing
     bool useBVH                 { true };
+
+    // Mesh caching
+    bool compressCache          { false }; // Quantise vertex attributes and code indices in newly written caches
+    int cacheBudgetMiB          { 4096 };  // Least recently used caches are evicted beyond this size
+
+    [[nodiscard]] bool operator==(const Config&) const = default;
 };
 
 
@@ -22,6 +22,9 @@ namespace utils {
     // Numerical constants
     constexpr float ZERO_EPSILON        = 1e-5f;
     constexpr float INTERIOR_RAY_OFFSET = 1e-3f;
+
+    // Mesh caching
+    constexpr size_t MAX_QUEUED_CACHE_WRITES = 2ULL; // Further bakes block until a background write finishes
 }
 
 #endif 
@@ -0,0 +1,107 @@
+#include "hash.h"
+
+#include <bit>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+static constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+static constexpr size_t FILE_BLOCK_SIZE = 1ULL << 20ULL; // Read files 1MiB at a time
+
+static uint64_t readWord(const std::byte* data) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+static uint64_t round(uint64_t lane, uint64_t input) {
+    lane += input * PRIME_2;
+    lane  = std::rotl(lane, 31);
+    return lane * PRIME_1;
+}
+
+static uint64_t mergeRound(uint64_t accumulator, uint64_t lane) {
+    accumulator ^= round(0ULL, lane);
+    return accumulator * PRIME_1 + PRIME_4;
+}
+
+utils::Hasher::Hasher(uint64_t seed)
+    : m_seed(seed)
+    , m_lanes { seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1 } {}
+
+void utils::Hasher::update(std::span<const std::byte> bytes) {
+    m_totalLength += bytes.size();
+
+    // Top up partially filled stripe from a previous update first
+    if (m_bufferSize > 0ULL) {
+        size_t toCopy = std::min(bytes.size(), m_buffer.size() - m_bufferSize);
+        std::memcpy(m_buffer.data() + m_bufferSize, bytes.data(), toCopy);
+        m_bufferSize += toCopy;
+        bytes         = bytes.subspan(toCopy);
+        if (m_bufferSize < m_buffer.size()) { return; }
+        for (size_t lane = 0ULL; lane < 4ULL; lane++) { m_lanes[lane] = round(m_lanes[lane], readWord(m_buffer.data() + 8ULL * lane)); }
+        m_bufferSize = 0ULL;
+    }
+
+    // Consume full 32-byte stripes; the four lanes are independent so this pipelines well
+    while (bytes.size() >= m_buffer.size()) {
+        for (size_t lane = 0ULL; lane < 4ULL; lane++) { m_lanes[lane] = round(m_lanes[lane], readWord(bytes.data() + 8ULL * lane)); }
+        bytes = bytes.subspan(m_buffer.size());
+    }
+
+    // Stash the tail for the next update (or the final digest)
+    std::memcpy(m_buffer.data(), bytes.data(), bytes.size());
+    m_bufferSize = bytes.size();
+}
+
+uint64_t utils::Hasher::digest() const {
+    uint64_t hash;
+    if (m_totalLength >= m_buffer.size()) {
+        hash = std::rotl(m_lanes[0], 1) + std::rotl(m_lanes[1], 7) + std::rotl(m_lanes[2], 12) + std::rotl(m_lanes[3], 18);
+        for (uint64_t lane : m_lanes) { hash = mergeRound(hash, lane); }
+    } else {
+        hash = m_seed + PRIME_5;
+    }
+    hash += m_totalLength;
+
+    // Fold in remaining tail bytes
+    size_t offset = 0ULL;
+    for (; offset + 8ULL <= m_bufferSize; offset += 8ULL) {
+        hash ^= round(0ULL, readWord(m_buffer.data() + offset));
+        hash  = std::rotl(hash, 27) * PRIME_1 + PRIME_4;
+    }
+    for (; offset < m_bufferSize; offset++) {
+        hash ^= static_cast<uint64_t>(m_buffer[offset]) * PRIME_5;
+        hash  = std::rotl(hash, 11) * PRIME_1;
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t utils::hashFile(const std::filesystem::path& filePath) {
+    std::ifstream fileStream(filePath, std::ios::binary);
+    if (!fileStream) { throw std::runtime_error(std::format("Could not open {} for hashing", filePath.string())); }
+
+    Hasher hasher;
+    std::vector<char> block(FILE_BLOCK_SIZE);
+    while (fileStream) {
+        fileStream.read(block.data(), static_cast<std::streamsize>(block.size()));
+        std::streamsize bytesRead = fileStream.gcount();
+        if (bytesRead <= 0) { break; }
+        hasher.update(std::as_bytes(std::span(block.data(), static_cast<size_t>(bytesRead))));
+    }
+    return hasher.digest();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <type_traits>
+
+namespace utils {
+    // Streaming 64-bit non-cryptographic hash (xxHash64-style, four independent lanes)
+    // Fast enough to fingerprint multi-gigabyte model files without dominating load times
+    class Hasher {
+    public:
+        explicit Hasher(uint64_t seed = 0ULL);
+
+        void update(std::span<const std::byte> bytes);
+        template<typename T>
+        void updateValue(const T& value) requires std::is_trivially_copyable_v<T> { update(std::as_bytes(std::span(&value, 1))); }
+
+        [[nodiscard]] uint64_t digest() const;
+
+    private:
+        uint64_t m_seed;
+        std::array<uint64_t, 4> m_lanes;
+        std::array<std::byte, 32> m_buffer;
+        size_t m_bufferSize     { 0ULL };
+        uint64_t m_totalLength  { 0ULL };
+    };
+
+    // Hash the full contents of a file, reading it in large blocks
+    uint64_t hashFile(const std::filesystem::path& filePath);
+}
+
+
+#endif // _HASH_H_
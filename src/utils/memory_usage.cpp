@@ -0,0 +1,37 @@
+#include "memory_usage.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fstream>
+#include <string>
+#endif
+
+namespace utils {
+    uint64_t peakResidentBytes() {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) { return 0ULL; }
+        return static_cast<uint64_t>(counters.PeakWorkingSetSize);
+#else
+        // Reported in kB as "VmHWM:    123456 kB"
+        std::ifstream status("/proc/self/status");
+        std::string key;
+        uint64_t kiloBytes;
+        while (status >> key) {
+            if (key == "VmHWM:" && status >> kiloBytes) { return kiloBytes << 10ULL; }
+        }
+        return 0ULL;
+#endif
+    }
+
+    void resetPeakResidentBytes() {
+#if defined(__linux__)
+        // See proc(5): writing 5 to clear_refs resets the VmHWM counter
+        std::ofstream clearRefs("/proc/self/clear_refs");
+        clearRefs << "5";
+#endif
+    }
+}
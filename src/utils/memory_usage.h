@@ -0,0 +1,17 @@
+#pragma once
+#ifndef _MEMORY_USAGE_H_
+#define _MEMORY_USAGE_H_
+
+#include <cstdint>
+
+namespace utils {
+    // Highest resident set size (working set on Windows) of this process so far, zero if it cannot be queried
+    uint64_t peakResidentBytes();
+
+    // Start measuring the peak resident set size afresh, so that a single phase of the program can be measured.
+    // Only supported on Linux; elsewhere the peak keeps covering the whole lifetime of the process
+    void resetPeakResidentBytes();
+}
+
+
+#endif // _MEMORY_USAGE_H_
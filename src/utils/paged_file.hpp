@@ -0,0 +1,75 @@
+#pragma once
+#ifndef _PAGED_FILE_HPP_
+#define _PAGED_FILE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <list>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace utils {
+    // Random read access to a binary file of T records through a least recently used set of fixed-size pages.
+    // Unlike a memory mapping, the amount of the file held in memory is bounded by the given byte budget.
+    // Not thread-safe; every reader needs its own instance
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    class PagedFile {
+    public:
+        PagedFile(const std::filesystem::path& filePath, uint64_t byteBudget, uint64_t pageBytes = 64ULL << 10ULL)
+            : m_file(filePath, std::ios::binary)
+            , m_numElements(std::filesystem::file_size(filePath) / sizeof(T))
+            , m_elementsPerPage(std::max(pageBytes / sizeof(T), uint64_t(1ULL)))
+            , m_maxPages(std::max(byteBudget / (m_elementsPerPage * sizeof(T)), uint64_t(1ULL))) {
+            if (!m_file) { throw std::runtime_error(std::format("Could not open {} for reading", filePath.string())); }
+        }
+
+        uint64_t size() const { return m_numElements; }
+
+        T operator[](uint64_t index) {
+            if (index >= m_numElements) { throw std::out_of_range(std::format("Element {} lies beyond the end of a paged file of {} elements", index, m_numElements)); }
+            const uint64_t pageIdx = index / m_elementsPerPage;
+            auto lookup = m_lookup.find(pageIdx);
+            if (lookup != m_lookup.end()) {
+                m_pages.splice(m_pages.begin(), m_pages, lookup->second);
+            } else {
+                // Recycle the least recently used page once the budget is exhausted
+                if (m_pages.size() < m_maxPages) {
+                    m_pages.emplace_front();
+                } else {
+                    m_lookup.erase(m_pages.back().pageIdx);
+                    m_pages.splice(m_pages.begin(), m_pages, std::prev(m_pages.end()));
+                }
+                Page& page              = m_pages.front();
+                page.pageIdx            = pageIdx;
+                const uint64_t first    = pageIdx * m_elementsPerPage;
+                page.elements.resize(std::min(m_elementsPerPage, m_numElements - first));
+                m_file.seekg(static_cast<std::streamoff>(first * sizeof(T)));
+                m_file.read(reinterpret_cast<char*>(page.elements.data()), static_cast<std::streamsize>(page.elements.size() * sizeof(T)));
+                if (!m_file) { throw std::runtime_error("Failed reading from paged file"); }
+                m_lookup[pageIdx] = m_pages.begin();
+            }
+            return m_pages.front().elements[index % m_elementsPerPage];
+        }
+
+    private:
+        struct Page {
+            uint64_t pageIdx;
+            std::vector<T> elements;
+        };
+
+        std::ifstream m_file;
+        const uint64_t m_numElements;
+        const uint64_t m_elementsPerPage;
+        const uint64_t m_maxPages;
+        std::list<Page> m_pages; // Most recently used first
+        std::unordered_map<uint64_t, typename std::list<Page>::iterator> m_lookup;
+    };
+}
+
+
+#endif // _PAGED_FILE_HPP_
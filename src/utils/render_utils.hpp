@@ -6,6 +6,7 @@
 DISABLE_WARNINGS_PUSH()
 #include <glad/glad.h>
 DISABLE_WARNINGS_POP()
+#include <framework/gl_state.h>
 
 #include <array>
 
@@ -26,7 +27,7 @@ namespace utils {
             // Set up plane VAO
             glCreateVertexArrays(1, &quadVAO);
             glCreateBuffers(1, &quadVBO);
-            glBindVertexArray(quadVAO);
+            gl_state::bindVertexArray(quadVAO);
             glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
             glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices.data(), GL_STATIC_DRAW);
             glEnableVertexAttribArray(0);
@@ -34,7 +35,7 @@ namespace utils {
             glEnableVertexAttribArray(1);
             glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
         }
-        glBindVertexArray(quadVAO);
+        gl_state::bindVertexArray(quadVAO);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     }
 }
@@ -0,0 +1,104 @@
+// Feeds the glTF loader truncated and malformed variants of a valid document. Every one of them has to be rejected with
+// the loader's exception rather than reaching rapidjson's unchecked getters or reading outside of the buffers.
+#include <framework/mesh.h>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+static int g_numFailures = 0;
+
+static void check(bool condition, std::string_view description)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        g_numFailures++;
+    }
+}
+
+static bool loads(const std::filesystem::path& file, const std::string& document)
+{
+    std::ofstream(file, std::ios::binary) << document;
+
+    // The loader reports why it rejects a file on std::cerr, which would drown out the test output
+    std::ostringstream discarded;
+    std::streambuf* cerrBuffer = std::cerr.rdbuf(discarded.rdbuf());
+    bool loaded = true;
+    try {
+        (void)loadGLTF(file);
+    } catch (const std::exception&) {
+        loaded = false;
+    }
+    std::cerr.rdbuf(cerrBuffer);
+    return loaded;
+}
+
+int main()
+{
+    std::ifstream fixture(FIXTURES_DIR "triangle.gltf", std::ios::binary);
+    const std::string valid { std::istreambuf_iterator<char>(fixture), std::istreambuf_iterator<char>() };
+    check(!valid.empty(), "fixture can be read");
+
+    const std::vector<Mesh> meshes = loadGLTF(FIXTURES_DIR "triangle.gltf");
+    check(meshes.size() == 1, "valid document loads one mesh");
+    if (!meshes.empty()) {
+        check(meshes[0].vertices.size() == 3 && meshes[0].triangles.size() == 1, "valid document loads one triangle");
+        check(meshes[0].material.transparency == 0.75f, "base color alpha becomes the transparency");
+    }
+
+    const std::filesystem::path file = std::filesystem::temp_directory_path() / "gltf_loading_test.gltf";
+
+    // Every prefix that stops before the closing brace of the document is invalid JSON
+    for (size_t length = 0; length <= valid.rfind('}'); length++)
+        check(!loads(file, valid.substr(0, length)), "document truncated to " + std::to_string(length) + " bytes is rejected");
+
+    // Members that are missing, of the wrong type, of the wrong length or that reference something that does not exist
+    const struct {
+        std::string_view original;
+        std::string_view replacement;
+    } malformations[] = {
+        { "\"matrix\": [ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 ]", "\"matrix\": [ 1, 0, 0 ]" },
+        { "0, 0, 0, 1 ]", "0, 0, \"0\", 1 ]" },
+        { "\"baseColorFactor\": [ 1.0, 0.5, 0.25, 0.75 ]", "\"baseColorFactor\": [ 1.0, 0.5, 0.25 ]" },
+        { "\"material\": 0", "\"material\": 3" },
+        { "\"pbrMetallicRoughness\": {", "\"pbrMetallicRoughness\": 1, \"x\": {" },
+        { "\"type\": \"VEC3\"", "\"type\": 3" },
+        { ", \"type\": \"VEC3\"", "" },
+        { "\"componentType\": 5126", "\"componentType\": \"5126\"" },
+        { "\"componentType\": 5126", "\"componentType\": 5127" },
+        { "\"componentType\": 5123", "\"componentType\": 5126" },
+        { "\"count\": 3, \"type\": \"SCALAR\"", "\"count\": 4611686018427387904, \"type\": \"SCALAR\"" },
+        { "{ \"buffer\": 0, \"byteOffset\": 0,", "{ \"byteOffset\": 0," },
+        { "\"byteOffset\": 36, \"byteLength\": 6", "\"byteOffset\": 36, \"byteLength\": 600" },
+        { "\"byteOffset\": 36", "\"byteOffset\": 18446744073709551615" },
+        { "\"buffers\": [ {", "\"buffers\": [ 1, {" },
+        { "\"attributes\": { \"POSITION\": 0 }", "\"attributes\": [ 0 ]" },
+        { "\"POSITION\": 0", "\"POSITION\": -1" },
+        { "\"indices\": 1", "\"indices\": 7" },
+        { "\"mesh\": 0,", "\"mesh\": \"0\"," },
+        { "\"primitives\": [ {", "\"primitives\": 2, \"x\": [ {" },
+        { "\"nodes\": [ 0 ]", "\"nodes\": 0" },
+        { "\"nodes\": [ 0 ]", "\"nodes\": [ 1 ]" },
+        { "\"scene\": 0", "\"scene\": 4" },
+        { "\"accessors\": [", "\"accessors\": {}, \"x\": [" },
+    };
+    for (const auto& [original, replacement] : malformations) {
+        std::string document = valid;
+        const size_t position = document.find(original);
+        check(position != std::string::npos, "fixture contains " + std::string(original));
+        if (position == std::string::npos)
+            continue;
+        document.replace(position, original.size(), replacement);
+        check(!loads(file, document), "document with " + std::string(replacement) + " is rejected");
+    }
+    std::filesystem::remove(file);
+
+    if (g_numFailures == 0)
+        std::cout << "All checks passed" << std::endl;
+    return g_numFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,128 @@
+// Round trip of the compressed mesh cache encoding (see mesh_encoding.h): triangles have to survive exactly, vertex
+// attributes within the error bounds documented for EncodedMesh. Also feeds the decoder a few corrupt index streams.
+#include <render/mesh_encoding.h>
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/geometric.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+
+static int g_numFailures = 0;
+
+static void check(bool condition, std::string_view description)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        g_numFailures++;
+    }
+}
+
+static EncodedMeshView view(const EncodedMesh& encoded)
+{
+    return { .bounds = encoded.bounds, .positions = encoded.positions, .normals = encoded.normals, .texCoords = encoded.texCoords,
+             .distances = encoded.distances, .triangleChunkOffsets = encoded.triangleChunkOffsets, .triangleBytes = encoded.triangleBytes,
+             .numTriangles = encoded.numTriangles };
+}
+
+// Random vertices in an off-centre box, and triangles that reference them in random order so that the index deltas
+// cover every varint length. Enough triangles for several independently coded chunks
+static Mesh makeRandomMesh()
+{
+    constexpr size_t numVertices = 100000, numTriangles = 3 * ENCODED_TRIANGLES_PER_CHUNK + 123;
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> coordinate(-3.0f, 5.0f), unit(-1.0f, 1.0f), distance(0.0f, 2.5f);
+    std::uniform_int_distribution<uint32_t> index(0, numVertices - 1);
+
+    Mesh mesh;
+    mesh.vertices.resize(numVertices);
+    for (size_t vertexIdx = 0; vertexIdx < numVertices; vertexIdx++) {
+        Vertex& vertex      = mesh.vertices[vertexIdx];
+        vertex.position     = glm::vec3(coordinate(random), coordinate(random), 0.1f * coordinate(random));
+        do {
+            vertex.normal   = glm::vec3(unit(random), unit(random), unit(random));
+        } while (glm::length(vertex.normal) < 0.1f);
+        vertex.normal       = glm::normalize(vertex.normal);
+        vertex.texCoord     = glm::vec2(unit(random), unit(random));
+        vertex.distanceInner = vertexIdx % 17 == 0 ? std::numeric_limits<float>::max() : distance(random);
+    }
+    mesh.triangles.resize(numTriangles);
+    for (glm::uvec3& triangle : mesh.triangles)
+        triangle = glm::uvec3(index(random), index(random), index(random));
+    mesh.triangles.front() = glm::uvec3(0, numVertices - 1, 0); // Largest possible deltas in both directions
+    return mesh;
+}
+
+static void testRoundTrip()
+{
+    const Mesh mesh = makeRandomMesh();
+    const EncodedMesh encoded = encodeMesh(mesh);
+    const Mesh decoded = decodeMesh(view(encoded), mesh.material);
+
+    check(decoded.triangles == mesh.triangles, "triangles decode exactly");
+    check(decoded.vertices.size() == mesh.vertices.size(), "vertex count is kept");
+    if (decoded.vertices.size() != mesh.vertices.size())
+        return;
+
+    const glm::vec3 maxPositionError = encoded.bounds.extent * ENCODED_POSITION_ERROR;
+    const float maxDistanceError = encoded.bounds.maxDistanceInner * ENCODED_DISTANCE_ERROR;
+    bool positionsValid = true, normalsValid = true, texCoordsValid = true, distancesValid = true;
+    for (size_t vertexIdx = 0; vertexIdx < mesh.vertices.size(); vertexIdx++) {
+        const Vertex& original = mesh.vertices[vertexIdx];
+        const Vertex& result = decoded.vertices[vertexIdx];
+        positionsValid = positionsValid && glm::all(glm::lessThanEqual(glm::abs(result.position - original.position), maxPositionError));
+        normalsValid = normalsValid && std::atan2(glm::length(glm::cross(result.normal, original.normal)), glm::dot(result.normal, original.normal)) <= ENCODED_NORMAL_ERROR;
+        texCoordsValid = texCoordsValid && glm::all(glm::lessThanEqual(glm::abs(result.texCoord - original.texCoord), glm::abs(original.texCoord) * ENCODED_TEXCOORD_ERROR + std::numeric_limits<float>::min()));
+        if (original.distanceInner == std::numeric_limits<float>::max())
+            distancesValid = distancesValid && result.distanceInner == original.distanceInner;
+        else
+            distancesValid = distancesValid && std::abs(result.distanceInner - original.distanceInner) <= maxDistanceError;
+    }
+    check(positionsValid, "positions stay within ENCODED_POSITION_ERROR of the bounds");
+    check(normalsValid, "normals stay within ENCODED_NORMAL_ERROR radians");
+    check(texCoordsValid, "texture coordinates stay within ENCODED_TEXCOORD_ERROR");
+    check(distancesValid, "d_N stays within ENCODED_DISTANCE_ERROR of the largest distance, and misses stay misses");
+}
+
+static bool decodes(const std::vector<uint8_t>& triangleBytes, uint64_t numTriangles)
+{
+    const std::vector<std::array<uint16_t, 3>> positions(4);
+    const std::vector<uint32_t> normals(4), texCoords(4);
+    const std::vector<uint16_t> distances(4);
+    const std::vector<uint64_t> chunkOffsets = { 0 };
+    const EncodedMeshView encoded { .bounds = { glm::vec3(0.0f), glm::vec3(1.0f), 1.0f }, .positions = positions, .normals = normals,
+                                    .texCoords = texCoords, .distances = distances, .triangleChunkOffsets = chunkOffsets,
+                                    .triangleBytes = triangleBytes, .numTriangles = numTriangles };
+    try {
+        (void)decodeMesh(encoded, Material {});
+        return true;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+static void testCorruptTriangles()
+{
+    check(decodes({ 0x00, 0x02, 0x02 }, 1), "valid index stream decodes");
+    check(!decodes({ 0x00, 0x02 }, 1), "truncated index stream is rejected");
+    check(!decodes({ 0x00, 0x02, 0x80 }, 1), "index stream ending in a continuation byte is rejected");
+    check(!decodes({ 0x00, 0x02, 0x08 }, 1), "out of range index is rejected");
+    check(!decodes({ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00 }, 1), "varint longer than 64 bits is rejected");
+}
+
+int main()
+{
+    testRoundTrip();
+    testCorruptTriangles();
+
+    if (g_numFailures == 0)
+        std::cout << "All checks passed" << std::endl;
+    return g_numFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
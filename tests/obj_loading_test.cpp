@@ -0,0 +1,125 @@
+// Checks the vertex deduplication of the OBJ loader: vertices are identified by their full (position, normal, texture coordinate)
+// index triple, the scratch tables are flat arrays rather than node-based maps, and every sub mesh is allocated exactly once.
+#include <framework/mesh.h>
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <omp.h>
+DISABLE_WARNINGS_POP()
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string_view>
+
+// Count every allocation made through the global operator new (the array and nothrow forms forward to it)
+static std::atomic<size_t> g_numAllocations { 0 };
+
+void* operator new(size_t size)
+{
+    g_numAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+static int g_numFailures = 0;
+
+static void check(bool condition, std::string_view description)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        g_numFailures++;
+    }
+}
+
+// Flat grid of size x size vertices in which every vertex has its own texture coordinate and all share one normal,
+// so that neighbouring triangles reference the same index triples and the loader has to merge them
+static void writeGrid(const std::filesystem::path& file, int size)
+{
+    std::ofstream out(file);
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++)
+            out << "v " << x << " " << y << " 0\n";
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++)
+            out << "vt " << static_cast<float>(x) / static_cast<float>(size - 1) << " " << static_cast<float>(y) / static_cast<float>(size - 1) << "\n";
+    out << "vn 0 0 1\n";
+    for (int y = 0; y + 1 < size; y++) {
+        for (int x = 0; x + 1 < size; x++) {
+            const int v0 = y * size + x + 1, v1 = v0 + 1, v2 = v0 + size + 1, v3 = v0 + size;
+            out << "f " << v0 << "/" << v0 << "/1 " << v1 << "/" << v1 << "/1 " << v2 << "/" << v2 << "/1\n";
+            out << "f " << v0 << "/" << v0 << "/1 " << v2 << "/" << v2 << "/1 " << v3 << "/" << v3 << "/1\n";
+        }
+    }
+}
+
+static size_t countLoadAllocations(const std::filesystem::path& file)
+{
+    const size_t before = g_numAllocations.load();
+    const std::vector<Mesh> meshes = loadMesh(file);
+    const size_t after = g_numAllocations.load();
+
+    check(meshes.size() == 1, "grid loads as a single mesh");
+    for (const Mesh& mesh : meshes) {
+        check(mesh.vertices.capacity() == mesh.vertices.size(), "vertices are allocated once at their final size");
+        check(mesh.triangles.capacity() == mesh.triangles.size(), "triangles are allocated once at their final size");
+    }
+    return after - before;
+}
+
+static void testSplitAttributes(bool parallelParse)
+{
+    const std::string parser = parallelParse ? " (parallel parser)" : " (tinyobjloader)";
+
+    // Each corner of the cube is shared by three faces with different normals
+    const std::vector<Mesh> cube = loadMesh(FIXTURES_DIR "split_cube.obj", false, parallelParse);
+    check(cube.size() == 1, "cube loads as a single mesh" + parser);
+    if (!cube.empty()) {
+        check(cube[0].vertices.size() == 24, "cube corners with different normals are kept apart" + parser);
+        check(cube[0].triangles.size() == 12, "cube quads are split into two triangles each" + parser);
+    }
+
+    // Two triangles share an edge whose corners only differ in texture coordinate
+    const std::vector<Mesh> seam = loadMesh(FIXTURES_DIR "uv_seam.obj", false, parallelParse);
+    check(seam.size() == 1, "UV seam loads as a single mesh" + parser);
+    if (!seam.empty()) {
+        check(seam[0].vertices.size() == 6, "corners with different texture coordinates are kept apart" + parser);
+        for (const Vertex& vertex : seam[0].vertices)
+            check(vertex.normal == glm::vec3(0, 0, 1), "UV seam vertices keep their normal" + parser);
+    }
+}
+
+int main()
+{
+    testSplitAttributes(true);
+    testSplitAttributes(false);
+
+    // A node-based map from index triple to vertex allocates once per unique vertex. The flat tables only grow the
+    // number of allocations with the number of parser chunks, so fix the thread count to make that independent of the machine.
+    omp_set_num_threads(1);
+    const std::filesystem::path smallGrid = std::filesystem::temp_directory_path() / "obj_loading_test_small.obj";
+    const std::filesystem::path largeGrid = std::filesystem::temp_directory_path() / "obj_loading_test_large.obj";
+    constexpr int smallSize = 17, largeSize = 257;
+    writeGrid(smallGrid, smallSize);
+    writeGrid(largeGrid, largeSize);
+
+    countLoadAllocations(smallGrid); // Warm up any lazily allocated runtime state
+    const size_t smallAllocations = countLoadAllocations(smallGrid);
+    const size_t largeAllocations = countLoadAllocations(largeGrid);
+    const size_t extraVertices = largeSize * largeSize - smallSize * smallSize;
+    std::cout << "Allocations while loading " << smallSize * smallSize << " vertices: " << smallAllocations << ", "
+              << largeSize * largeSize << " vertices: " << largeAllocations << std::endl;
+    check(largeAllocations < smallAllocations + extraVertices / 64, "allocations do not scale with the number of vertices");
+
+    std::filesystem::remove(smallGrid);
+    std::filesystem::remove(largeGrid);
+
+    if (g_numFailures == 0)
+        std::cout << "All checks passed" << std::endl;
+    return g_numFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,112 @@
+// Compares the parallel OBJ parser against tinyobj::LoadObj, whose output it promises to reproduce exactly: attributes,
+// triangle indices, shape boundaries and material IDs. Runs on a small fixture and on a generated file large enough to
+// be split into many chunks, so that negative indices and statements also cross chunk boundaries.
+#include <framework/obj_parser.h>
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <omp.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+static int g_numFailures = 0;
+
+static void check(bool condition, std::string_view description)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        g_numFailures++;
+    }
+}
+
+static bool sameIndices(const std::vector<tinyobj::index_t>& lhs, const std::vector<tinyobj::index_t>& rhs)
+{
+    return std::equal(std::begin(lhs), std::end(lhs), std::begin(rhs), std::end(rhs), [](const tinyobj::index_t& a, const tinyobj::index_t& b) {
+        return a.vertex_index == b.vertex_index && a.normal_index == b.normal_index && a.texcoord_index == b.texcoord_index;
+    });
+}
+
+static void compareWithTinyObj(const std::filesystem::path& file, std::string_view name)
+{
+    const std::string suffix = " (" + std::string(name) + ")";
+
+    ObjData expected;
+    std::string warning, error;
+    const bool loaded = tinyobj::LoadObj(&expected.attrib, &expected.shapes, &expected.materials, &warning, &error,
+                                         file.string().c_str(), file.parent_path().string().c_str());
+    check(loaded, "tinyobjloader loads the file" + suffix);
+
+    const std::optional<ObjData> parsed = parseObjParallel(file, file.parent_path());
+    check(parsed.has_value(), "parallel parser supports the file" + suffix);
+    if (!loaded || !parsed)
+        return;
+
+    check(parsed->attrib.vertices == expected.attrib.vertices, "positions match" + suffix);
+    check(parsed->attrib.normals == expected.attrib.normals, "normals match" + suffix);
+    check(parsed->attrib.texcoords == expected.attrib.texcoords, "texture coordinates match" + suffix);
+
+    check(parsed->materials.size() == expected.materials.size(), "material count matches" + suffix);
+    for (size_t materialIdx = 0; materialIdx < std::min(parsed->materials.size(), expected.materials.size()); materialIdx++)
+        check(parsed->materials[materialIdx].name == expected.materials[materialIdx].name, "material names match" + suffix);
+
+    check(parsed->shapes.size() == expected.shapes.size(), "shape count matches" + suffix);
+    for (size_t shapeIdx = 0; shapeIdx < std::min(parsed->shapes.size(), expected.shapes.size()); shapeIdx++) {
+        const tinyobj::mesh_t& parsedMesh = parsed->shapes[shapeIdx].mesh;
+        const tinyobj::mesh_t& expectedMesh = expected.shapes[shapeIdx].mesh;
+        const std::string shape = " of shape " + std::to_string(shapeIdx) + suffix;
+        check(sameIndices(parsedMesh.indices, expectedMesh.indices), "indices match" + shape);
+        check(parsedMesh.num_face_vertices == expectedMesh.num_face_vertices, "faces are triangles" + shape);
+        check(parsedMesh.material_ids == expectedMesh.material_ids, "material IDs match" + shape);
+    }
+}
+
+// Repeats the constructs of groups.obj, with attributes declared late and referenced both ways, until the file spans
+// several chunks of the parser
+static void writeLargeFile(const std::filesystem::path& file)
+{
+    std::ofstream out(file);
+    out << "mtllib groups.mtl\n";
+    constexpr int numBlocks = 60000;
+    for (int block = 0; block < numBlocks; block++) {
+        if (block % 1000 == 0)
+            out << "o object" << block << "\n";
+        if (block % 97 == 0)
+            out << "g group" << block << "\n";
+        if (block % 13 == 0)
+            out << "usemtl " << (block % 3 == 0 ? "red" : (block % 3 == 1 ? "glass" : "missing")) << "\n";
+
+        const float z = 0.001f * static_cast<float>(block);
+        out << "v 0 0 " << z << "\nv 1.5 0 " << z << "\nv 1 1 " << z + 0.25f << "\nv 0 1.25 " << z << "\n";
+        out << "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 0 1\n";
+        const int first = 4 * block + 1, normal = block + 1;
+        out << "f -4/-4/-1 -3/-3/-1 -2/-2/-1 -1/-1/-1\n";
+        out << "f " << first << "//" << normal << " " << first + 2 << "//" << normal << " " << first + 3 << "//" << normal << "\n";
+        if (block > 0)
+            out << "f " << first - 4 << "/1 " << first << "/2 " << first + 1 << "/3 -5/4\n";
+    }
+}
+
+int main()
+{
+    compareWithTinyObj(FIXTURES_DIR "groups.obj", "groups.obj");
+
+    // Chunk boundaries depend on the thread count, so pin it
+    omp_set_num_threads(4);
+    const std::filesystem::path largeFile = std::filesystem::temp_directory_path() / "obj_parser_test.obj";
+    std::filesystem::copy_file(FIXTURES_DIR "groups.mtl", largeFile.parent_path() / "groups.mtl", std::filesystem::copy_options::overwrite_existing);
+    writeLargeFile(largeFile);
+    check(std::filesystem::file_size(largeFile) > (4ULL << 20), "generated file spans several chunks");
+    compareWithTinyObj(largeFile, "generated");
+    std::filesystem::remove(largeFile);
+    std::filesystem::remove(largeFile.parent_path() / "groups.mtl");
+
+    if (g_numFailures == 0)
+        std::cout << "All checks passed" << std::endl;
+    return g_numFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,57 @@
+// Loads the same small PLY model from an ASCII and from a binary little endian file. Both have to produce the same
+// positions and normals, and the quad has to be fan-triangulated, while the properties and elements the loader does
+// not use are skipped.
+#include <framework/mesh.h>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static int g_numFailures = 0;
+
+static void check(bool condition, std::string_view description)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        g_numFailures++;
+    }
+}
+
+static void testQuad(const std::filesystem::path& file)
+{
+    const std::string suffix = " (" + file.filename().string() + ")";
+    std::vector<Mesh> meshes;
+    try {
+        meshes = loadPLY(file);
+    } catch (const std::exception&) {
+        check(false, "file loads" + suffix);
+        return;
+    }
+    check(meshes.size() == 1, "file loads as a single mesh" + suffix);
+    if (meshes.empty())
+        return;
+    const Mesh& mesh = meshes[0];
+
+    const std::vector<glm::vec3> positions = { { 0, 0, 0.5f }, { 1, 0, 0.5f }, { 1, 1, 0.5f }, { 0, 1, 0.5f }, { 0.25f, -1.5f, 2 } };
+    const std::vector<glm::vec3> normals = { { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 }, { 0.6f, -0.8f, 0 } };
+    check(mesh.vertices.size() == positions.size(), "all vertices are loaded" + suffix);
+    for (size_t vertexIdx = 0; vertexIdx < std::min(mesh.vertices.size(), positions.size()); vertexIdx++) {
+        check(mesh.vertices[vertexIdx].position == positions[vertexIdx], "position " + std::to_string(vertexIdx) + " matches" + suffix);
+        check(mesh.vertices[vertexIdx].normal == normals[vertexIdx], "normal " + std::to_string(vertexIdx) + " matches" + suffix);
+    }
+
+    const std::vector<glm::uvec3> triangles = { { 0, 1, 2 }, { 0, 2, 3 }, { 1, 4, 2 } };
+    check(mesh.triangles == triangles, "quad is fan-triangulated and the triangle is kept" + suffix);
+}
+
+int main()
+{
+    testQuad(FIXTURES_DIR "quad.ply");
+    testQuad(FIXTURES_DIR "quad_binary.ply");
+
+    if (g_numFailures == 0)
+        std::cout << "All checks passed" << std::endl;
+    return g_numFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}